@@ -1,6 +1,8 @@
 #include <esp_now.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
+#include <atomic>
+#include <algorithm>
 
 // --- CONFIG: ganti peer_addr sesuai MAC lawan ---
 uint8_t peer_addr[] = {0x98, 0xA3, 0x16, 0xEB, 0x65, 0x90};
@@ -13,8 +15,80 @@ const size_t MAX_V2_PAYLOAD = 1472; // upper safe limit for ESP-NOW V2
 unsigned long sendStartMicros = 0;
 size_t lastSendLen = 0;
 
+// One payload buffer for every send (esp_now_send copies it), A..Z repeated
+uint8_t txBuf[MAX_V2_PAYLOAD];
+
+// --- Benchmark ---
+// "bench" sweeps payload size x send rate x burst length. Each step sends
+// `count` packets to the peer, a burst of `burst` back-to-back every
+// burst * 1e6 / rate us (rate 0: as fast as the radio takes them, at most
+// BENCH_WINDOW waiting for their send callback). The peer (this sketch)
+// answers every packet with its 12-byte header. Per step one CSV row:
+//   - goodput: payload bytes the peer's radio acked (send callback) per
+//     second, from the first send to the last callback
+//   - loss: packets without an echo (either direction); MAC loss: send
+//     callbacks that reported failure
+//   - latency from esp_now_send() to the send callback, and the echo round
+//     trip, as p50/p99/p999/max in us
+// Rows start with "BENCH," (the first one is the header) so a capture of the
+// port can be fed to host/tools/espnow_bench_report.
+const uint8_t BENCH_MAGIC = 0xB5;
+const uint8_t BENCH_DATA = 1, BENCH_ECHO = 2;
+const uint32_t BENCH_MAX_COUNT = 2000;
+const uint32_t BENCH_DEFAULT_COUNT = 1000;
+const uint32_t BENCH_WINDOW = 8;
+const unsigned long BENCH_DRAIN_MS = 300;     // wait for the last echoes
+const unsigned long BENCH_STEP_TIMEOUT_MS = 30000;
+const uint16_t BENCH_SIZES[] = {16, 64, 128, 250, 512, 1024, 1472};
+const uint16_t BENCH_RATES[] = {0, 100, 500, 1000};  // packets/s, 0 = unpaced
+const uint8_t BENCH_BURSTS[] = {1, 4, 16};
+
+struct __attribute__((packed)) BenchHdr {
+  uint8_t magic, kind;
+  uint16_t run;
+  uint32_t seq;
+  uint32_t sentUs;  // sender's micros()
+};
+
+// benchStep() (loop()) resets the counters before a step; during it each
+// field is written from one side only.
+struct Bench {
+  volatile bool active;
+  uint16_t run;
+  // written by benchStep(): sentAt[k] before sent becomes k + 1 (release),
+  // so the send callback reads a send time only after it was stored
+  uint32_t sentAt[BENCH_WINDOW * 4];          // send times, in send order
+  std::atomic<uint32_t> sent{0};
+  // written by the send callback (Wi-Fi task)
+  std::atomic<uint32_t> callbacks{0}, cbOk{0}, cbFail{0};
+  std::atomic<uint32_t> lastCbUs{0};
+  uint32_t cbLat[BENCH_MAX_COUNT];
+  // written by the receive callback
+  std::atomic<uint32_t> echoed{0}, dupEchoes{0};
+  uint32_t rtt[BENCH_MAX_COUNT];
+  uint8_t seen[BENCH_MAX_COUNT / 8];
+  // our echoes of the peer's packets, not reported: the receive callback
+  // adds one per echo sent, the send callback takes one per status
+  std::atomic<uint32_t> echoesInFlight{0};
+};
+Bench bench;
+
 // Callback ketika data terkirim (IDF5.x signature)
 void OnDataSent(const wifi_tx_info_t *info, esp_now_send_status_t status) {
+  uint32_t e = bench.echoesInFlight.load(std::memory_order_relaxed);
+  if (e && bench.echoesInFlight.compare_exchange_strong(e, e - 1)) return;
+  if (bench.active) {
+    // callbacks come in send order
+    uint32_t now = micros();
+    uint32_t i = bench.callbacks.load(std::memory_order_relaxed);
+    if (i < bench.sent.load(std::memory_order_acquire)) {
+      if (i < BENCH_MAX_COUNT) bench.cbLat[i] = now - bench.sentAt[i % (BENCH_WINDOW * 4)];
+      (status == ESP_NOW_SEND_SUCCESS ? bench.cbOk : bench.cbFail).fetch_add(1, std::memory_order_relaxed);
+      bench.lastCbUs.store(now, std::memory_order_relaxed);
+      bench.callbacks.store(i + 1, std::memory_order_release);
+    }
+    return;
+  }
   unsigned long txLatency = micros() - sendStartMicros;
   Serial.printf("Send Status: %s | TX Latency: %lu us | Packet len: %u\n",
                 (status == ESP_NOW_SEND_SUCCESS ? "Success" : "Fail"),
@@ -25,6 +99,26 @@ void OnDataSent(const wifi_tx_info_t *info, esp_now_send_status_t status) {
 void OnDataRecv(const esp_now_recv_info *recvInfo, const uint8_t *data, int len) {
   if (!data || len <= 0) return;
 
+  // benchmark: echo data packets, time the echoes of ours
+  if ((size_t)len >= sizeof(BenchHdr) && data[0] == BENCH_MAGIC) {
+    BenchHdr h;
+    memcpy(&h, data, sizeof(h));
+    if (h.kind == BENCH_DATA) {
+      h.kind = BENCH_ECHO;
+      bench.echoesInFlight.fetch_add(1);
+      if (esp_now_send(recvInfo && recvInfo->src_addr ? recvInfo->src_addr : peer_addr, (const uint8_t *)&h, sizeof(h)) != ESP_OK)
+        bench.echoesInFlight.fetch_sub(1);
+    } else if (h.kind == BENCH_ECHO && bench.active && h.run == bench.run && h.seq < BENCH_MAX_COUNT) {
+      uint8_t bit = (uint8_t)(1 << (h.seq & 7));
+      if (bench.seen[h.seq >> 3] & bit) { bench.dupEchoes.fetch_add(1, std::memory_order_relaxed); return; }
+      bench.seen[h.seq >> 3] |= bit;
+      uint32_t n = bench.echoed.load(std::memory_order_relaxed);
+      bench.rtt[n] = (uint32_t)micros() - h.sentUs;
+      bench.echoed.store(n + 1, std::memory_order_release);
+    }
+    return;
+  }
+
   // tampilkan informasi pengirim
   if (recvInfo && recvInfo->src_addr) {
     const uint8_t *mac = recvInfo->src_addr;
@@ -67,6 +161,113 @@ void printMyMac() {
   }
 }
 
+// A..Z repeated; the benchmark overwrites the first bytes with its header
+void fillPattern(size_t n) {
+  for (size_t i = 0; i < n; ++i) txBuf[i] = 'A' + (i % 26);
+}
+
+// nearest-rank percentile (per mille) of v[0..n), sorted
+uint32_t percentile(const uint32_t *v, uint32_t n, uint32_t perMille) {
+  if (!n) return 0;
+  uint32_t k = (uint32_t)(((uint64_t)n * perMille + 999) / 1000);
+  return v[k ? k - 1 : 0];
+}
+
+void benchPrintHeader() {
+  Serial.println("BENCH,run,size,rate,burst,count,sent,refused,cb_ok,cb_fail,echoed,dup,duration_us,achieved_pps,"
+                 "goodput_kbps,loss_pct,mac_loss_pct,cb_p50_us,cb_p99_us,cb_p999_us,cb_max_us,"
+                 "rtt_p50_us,rtt_p99_us,rtt_p999_us,rtt_max_us");
+}
+
+// One step: `count` packets of `size` bytes, bursts of `burst` at `rate`
+// packets/s (0 = unpaced). Prints its CSV row.
+void benchStep(uint16_t size, uint16_t rate, uint8_t burst, uint32_t count) {
+  if (size < sizeof(BenchHdr)) size = sizeof(BenchHdr);
+  if (size > MAX_V2_PAYLOAD) size = MAX_V2_PAYLOAD;
+  if (count < 1) count = 1;
+  if (count > BENCH_MAX_COUNT) count = BENCH_MAX_COUNT;
+  if (burst < 1) burst = 1;
+  bench.active = false;
+  bench.run++;
+  bench.sent.store(0); bench.callbacks.store(0); bench.cbOk.store(0); bench.cbFail.store(0);
+  bench.echoed.store(0); bench.dupEchoes.store(0);
+  memset(bench.seen, 0, sizeof(bench.seen));
+  bench.active = true;
+
+  BenchHdr h = {BENCH_MAGIC, BENCH_DATA, bench.run, 0, 0};
+  uint32_t refused = 0, seq = 0;
+  uint32_t interval = rate ? (uint32_t)((uint64_t)burst * 1000000UL / rate) : 0;
+  uint32_t start = micros(), next = start;
+  unsigned long startMs = millis();
+  while (seq < count && millis() - startMs < BENCH_STEP_TIMEOUT_MS) {
+    if (rate && (int32_t)(micros() - next) < 0) continue;
+    for (uint8_t b = 0; b < burst && seq < count; b++) {
+      // no more than BENCH_WINDOW waiting for their send callback
+      while (bench.sent.load() - bench.callbacks.load() >= BENCH_WINDOW && millis() - startMs < BENCH_STEP_TIMEOUT_MS) {}
+      uint32_t k = bench.sent.load();
+      h.seq = seq++;
+      h.sentUs = micros();
+      memcpy(txBuf, &h, sizeof(h));
+      bench.sentAt[k % (BENCH_WINDOW * 4)] = h.sentUs;
+      bench.sent.store(k + 1, std::memory_order_release);
+      if (esp_now_send(peer_addr, txBuf, size) != ESP_OK) { bench.sent.store(k); refused++; }
+    }
+    // a rate the radio cannot keep up with is not made up for later
+    next += interval;
+    if ((int32_t)(micros() - next) > (int32_t)interval) next = micros();
+  }
+  uint32_t sendUs = micros() - start;
+  unsigned long drainFrom = millis();
+  while (millis() - drainFrom < BENCH_DRAIN_MS &&
+         (bench.callbacks.load() < bench.sent.load() || bench.echoed.load() < bench.sent.load()))
+    delay(1);
+  bench.active = false;
+
+  uint32_t sent = bench.sent.load(), cbs = bench.callbacks.load(), ok = bench.cbOk.load(), fail = bench.cbFail.load();
+  uint32_t echoed = bench.echoed.load(), dups = bench.dupEchoes.load();
+  uint32_t duration = (cbs ? bench.lastCbUs.load() : micros()) - start;
+  if (!duration) duration = 1;
+  uint32_t nLat = std::min(cbs, BENCH_MAX_COUNT);
+  std::sort(bench.cbLat, bench.cbLat + nLat);
+  std::sort(bench.rtt, bench.rtt + echoed);
+  Serial.printf("BENCH,%u,%u,%u,%u,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.1f,%.1f,%.2f,%.2f,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu\n",
+                bench.run, size, rate, burst, (unsigned long)count, (unsigned long)sent, (unsigned long)refused,
+                (unsigned long)ok, (unsigned long)fail, (unsigned long)echoed, (unsigned long)dups, (unsigned long)duration,
+                sendUs ? sent * 1e6 / sendUs : 0.0, ok * (double)size * 8000.0 / duration,
+                sent ? 100.0 * (sent - std::min(echoed, sent)) / sent : 0.0, sent ? 100.0 * fail / sent : 0.0,
+                (unsigned long)percentile(bench.cbLat, nLat, 500), (unsigned long)percentile(bench.cbLat, nLat, 990),
+                (unsigned long)percentile(bench.cbLat, nLat, 999), (unsigned long)(nLat ? bench.cbLat[nLat - 1] : 0),
+                (unsigned long)percentile(bench.rtt, echoed, 500), (unsigned long)percentile(bench.rtt, echoed, 990),
+                (unsigned long)percentile(bench.rtt, echoed, 999), (unsigned long)(echoed ? bench.rtt[echoed - 1] : 0));
+  fillPattern(sizeof(BenchHdr));
+}
+
+// Every size x rate x burst (unpaced only with bursts of 1: the window
+// paces it).
+void benchSweep(uint32_t count) {
+  benchPrintHeader();
+  for (uint16_t size : BENCH_SIZES)
+    for (uint16_t rate : BENCH_RATES)
+      for (uint8_t burst : BENCH_BURSTS) {
+        if (rate == 0 && burst > 1) continue;
+        benchStep(size, rate, burst, count);
+      }
+  Serial.println("BENCH done");
+}
+
+// Up to n integers after the command word.
+int parseArgs(const String &line, long *v, int n) {
+  int count = 0, i = line.indexOf(' ');
+  while (i >= 0 && count < n) {
+    while (i < (int)line.length() && line[i] == ' ') i++;
+    if (i >= (int)line.length()) break;
+    int j = line.indexOf(' ', i);
+    v[count++] = line.substring(i, j < 0 ? line.length() : j).toInt();
+    i = j;
+  }
+  return count;
+}
+
 bool addPeer() {
   esp_now_peer_info_t peerInfo = {};
   memcpy(peerInfo.peer_addr, peer_addr, 6);
@@ -82,6 +283,7 @@ bool addPeer() {
 void setup() {
   Serial.begin(115200);
   delay(100);
+  fillPattern(sizeof(txBuf));
 
   // WiFi start
   WiFi.mode(WIFI_STA);
@@ -107,6 +309,8 @@ void setup() {
   Serial.println("  sendword        -> send default 1024-byte word (A..Z)");
   Serial.println("  send <N>        -> send N bytes (N <= 1472)");
   Serial.println("  ping            -> RTT test (small timestamp packet)");
+  Serial.println("  bench [count]   -> sweep sizes x rates x bursts, CSV rows (count packets per step)");
+  Serial.println("  bench <size> <rate> <burst> [count] -> one step (rate in packets/s, 0 = unpaced)");
   Serial.println("  (Make sure peer_addr & myName configured)\n");
 }
 
@@ -124,18 +328,11 @@ void loop() {
   if (line.equalsIgnoreCase("sendword")) {
     size_t N = 1024;
     if (N > MAX_V2_PAYLOAD) N = MAX_V2_PAYLOAD;
-    char *buf = (char *)malloc(N);
-    if (!buf) {
-      Serial.println("Allocation failed");
-      return;
-    }
-    // fill with A..Z repeated
-    for (size_t i = 0; i < N; ++i) buf[i] = 'A' + (i % 26);
+    // txBuf holds A..Z repeated
     sendStartMicros = micros();
     lastSendLen = N;
-    esp_err_t res = esp_now_send(peer_addr, (uint8_t *)buf, N);
+    esp_err_t res = esp_now_send(peer_addr, txBuf, N);
     Serial.printf("Sent word payload (%u bytes) -> result: %d\n", (unsigned)N, res);
-    free(buf);
   }
   else if (line.startsWith("send ")) {
     // format: send <N>
@@ -151,22 +348,26 @@ void loop() {
       Serial.printf("Requested %u > MAX (%u). Limiting to MAX.\n", (unsigned)N, (unsigned)MAX_V2_PAYLOAD);
       N = MAX_V2_PAYLOAD;
     }
-    char *buf = (char *)malloc(N);
-    if (!buf) {
-      Serial.println("Allocation failed");
-      return;
-    }
-    // fill with readable pattern: line breaks every 64 chars to make it easy to inspect
-    for (size_t i = 0; i < N; ++i) {
-      buf[i] = 'A' + (i % 26);
-      // optional: create visible segmentation by inserting newline occasionally
-      // but be careful not to break binary tests; keeping plain A..Z is fine
-    }
+    // readable pattern (A..Z repeated) from txBuf
     sendStartMicros = micros();
     lastSendLen = N;
-    esp_err_t res = esp_now_send(peer_addr, (uint8_t *)buf, N);
+    esp_err_t res = esp_now_send(peer_addr, txBuf, N);
     Serial.printf("Sent payload (%u bytes) -> result: %d\n", (unsigned)N, res);
-    free(buf);
+  }
+  else if (line.equalsIgnoreCase("bench") || line.startsWith("bench ")) {
+    // bench [count] | bench <size> <rate> <burst> [count]
+    long v[4];
+    int n = parseArgs(line, v, 4);
+    if (n >= 3) {
+      if (v[0] <= 0 || v[1] < 0 || v[2] <= 0) {
+        Serial.println("Invalid bench step");
+        return;
+      }
+      benchPrintHeader();
+      benchStep((uint16_t)v[0], (uint16_t)v[1], (uint8_t)v[2], n >= 4 ? (uint32_t)v[3] : BENCH_DEFAULT_COUNT);
+    } else {
+      benchSweep(n >= 1 && v[0] > 0 ? (uint32_t)v[0] : BENCH_DEFAULT_COUNT);
+    }
   }
   else if (line.equalsIgnoreCase("ping")) {
     unsigned long t = micros();
@@ -0,0 +1,177 @@
+// async_flush.h - double-buffered display flushes from a background task
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "display_flush.h"
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+// The two displays sit on separate I2C controllers, so their transfers can
+// run at the same time. An AsyncFlush owns a back buffer for one display:
+// submit() copies the framebuffer (front) and its dirty set into the back
+// buffer and wakes a FreeRTOS task that sends it with sendRuns(). The game
+// keeps drawing into the front buffer while the pixels go out; if the
+// previous transfer is still running the frame is skipped and its dirty
+// set is kept for the next submit().
+//
+// The back buffer always holds what the panel shows once a transfer has
+// finished, which FLUSH_DIFF uses to find the changed column groups of a
+// display that is redrawn from scratch every frame (the HUD).
+//
+// Without begin() (and on the host build) submit() sends synchronously.
+// Anything that talks to the display directly (menu.h calls display())
+// must wait() first and invalidate() afterwards.
+//
+// inFlight hands the frame between loop() and the flush task: run() stores
+// false with release after its last write (back buffer state, statistics,
+// the display's counters), and loop() loads it with acquire before it reads
+// any of them, so a finished transfer is seen whole.
+
+enum FlushMode : uint8_t {
+  FLUSH_DIRTY = 0, // runs marked with markDirty()
+  FLUSH_FULL = 1,  // the whole screen
+  FLUSH_DIFF = 2   // column groups that differ from the last image sent
+};
+
+class AsyncFlush {
+public:
+  static const int MAX_BYTES = 128 * PartialSH1107::MAX_PAGES;
+
+  explicit AsyncFlush(PartialSH1107 &d) : disp(d) { }
+
+  // Start the flush task. Returns false (and stays synchronous) on failure.
+  bool begin(const char *name, int core = 0) {
+#if defined(ESP32)
+    if (task) return true;
+    return xTaskCreatePinnedToCore(taskMain, name, 3072, this, 1, &task, core) == pdPASS;
+#else
+    (void)name; (void)core;
+    return false;
+#endif
+  }
+
+  bool busy() const { return inFlight.load(std::memory_order_acquire); }
+
+  // Block until the transfer in flight (if any) has finished.
+  void wait() {
+    while (inFlight.load(std::memory_order_acquire)) {
+#if defined(ESP32)
+      vTaskDelay(1);
+#else
+      yield();
+#endif
+    }
+  }
+
+  // The panel no longer matches the back buffer: next FLUSH_DIFF sends everything.
+  void invalidate() { backValid = false; }
+
+  // Snapshot the framebuffer and start sending it. Returns false if the
+  // previous transfer is still running (frame skipped).
+  bool submit(FlushMode mode) {
+    if (inFlight.load(std::memory_order_acquire)) { skipped++; return false; }
+    const uint8_t *fb = disp.frameBuffer();
+    int w = disp.width(), pages = (disp.height() + 7) / 8;
+    size_t n = (size_t)w * pages;
+    if (!fb || n > sizeof(back) || pages > PartialSH1107::MAX_PAGES) return false;
+
+    disp.takeDirty(dirty);
+    if (mode == FLUSH_DIFF && !backValid) mode = FLUSH_FULL;
+    if (mode == FLUSH_FULL) {
+      for (int p = 0; p < PartialSH1107::MAX_PAGES; p++) dirty[p] = 0xFFFF;
+    } else if (mode == FLUSH_DIFF) {
+      for (int p = 0; p < pages; p++) {
+        uint16_t m = 0;
+        for (int g = 0; g * PartialSH1107::COL_GROUP < w; g++) {
+          size_t o = (size_t)p * w + g * PartialSH1107::COL_GROUP;
+          if (memcmp(fb + o, back + o, PartialSH1107::COL_GROUP) != 0) m |= (uint16_t)(1u << g);
+        }
+        dirty[p] = m;
+      }
+    }
+    bool any = false;
+    for (int p = 0; p < pages; p++) any |= dirty[p] != 0;
+    if (!any) return true;
+
+    memcpy(back, fb, n);
+    inFlight.store(true, std::memory_order_release);
+    jobs++;
+#if defined(ESP32)
+    if (task) { xTaskNotifyGive(task); return true; }
+#endif
+    run();
+    return true;
+  }
+
+  // statistics (durations in microseconds, written by the flush task; read
+  // them after busy() or wait() has seen the transfer finish)
+  unsigned long jobs = 0;      // transfers started
+  unsigned long completed = 0; // transfers finished
+  unsigned long skipped = 0;   // submits dropped because a transfer was running
+  unsigned long lastUs = 0, maxUs = 0, totalUs = 0;
+  unsigned long startedUs = 0, finishedUs = 0; // of the last finished transfer
+
+private:
+  void run() {
+    unsigned long t0 = micros();
+    unsigned long sent = disp.sendRuns(back, dirty);
+    unsigned long t1 = micros();
+    disp.noteFlush(sent);
+    startedUs = t0;
+    finishedUs = t1;
+    lastUs = t1 - t0;
+    if (lastUs > maxUs) maxUs = lastUs;
+    totalUs += lastUs;
+    completed++;
+    backValid = true;
+    inFlight.store(false, std::memory_order_release);
+  }
+
+#if defined(ESP32)
+  static void taskMain(void *arg) {
+    AsyncFlush *self = (AsyncFlush *)arg;
+    for (;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      self->run();
+    }
+  }
+  TaskHandle_t task = nullptr;
+#endif
+
+  PartialSH1107 &disp;
+  uint8_t back[MAX_BYTES];
+  uint16_t dirty[PartialSH1107::MAX_PAGES];
+  std::atomic<bool> inFlight{false};
+  bool backValid = false;
+};
+
+// How much two flushers' transfers overlapped in time. Sample once per
+// frame; a pair is counted (and true returned) when both have finished a
+// new transfer.
+struct FlushOverlapStats {
+  unsigned long pairs;     // pairs of transfers compared
+  unsigned long serialUs;  // sum of both durations (time if sent back to back)
+  unsigned long wallUs;    // first start to last end
+  unsigned long overlapUs; // time both buses were busy
+  unsigned long seenA, seenB;
+};
+
+inline bool flushOverlapSample(FlushOverlapStats &s, const AsyncFlush &a, const AsyncFlush &b) {
+  if (a.busy() || b.busy() || a.completed == s.seenA || b.completed == s.seenB) return false;
+  s.seenA = a.completed;
+  s.seenB = b.completed;
+  unsigned long start = ((long)(a.startedUs - b.startedUs) < 0) ? a.startedUs : b.startedUs;
+  unsigned long end = ((long)(a.finishedUs - b.finishedUs) > 0) ? a.finishedUs : b.finishedUs;
+  unsigned long lateStart = ((long)(a.startedUs - b.startedUs) > 0) ? a.startedUs : b.startedUs;
+  unsigned long earlyEnd = ((long)(a.finishedUs - b.finishedUs) < 0) ? a.finishedUs : b.finishedUs;
+  s.pairs++;
+  s.serialUs += a.lastUs + b.lastUs;
+  s.wallUs += end - start;
+  if ((long)(earlyEnd - lateStart) > 0) s.overlapUs += earlyEnd - lateStart;
+  return true;
+}
+
+// End of async_flush.h
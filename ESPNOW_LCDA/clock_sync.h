@@ -0,0 +1,267 @@
+#pragma once
+
+// clock_sync.h - a game clock both devices agree on
+//
+// Player 0's esp_timer is the game clock. Player 1 measures its own timer
+// against it NTP-style with TimeProbe (espnow_net.h): a probe gives the
+// round trip rtt = (t4 - t1) - (t3 - t2) and the offset
+// ((t2 - t1) + (t3 - t4)) / 2, which is off by at most rtt / 2 (the two
+// one-way delays need not be equal). The last CLOCK_SYNC_SAMPLES probes are
+// kept. Those whose round trip is close to the shortest are fitted with a
+// line, offset plus drift, once they span CLOCK_SYNC_FIT_US; until then the
+// offset of the shortest round trip is used. Their drift is taken only if
+// the fit pins it down to CLOCK_SYNC_DRIFT_SE, which 16 probes a second
+// apart manage on a link without jitter: a few ms of it hide 40 ppm
+// (40 us/s). So the drift also comes from a longer, thinned-out history,
+// the fastest probe of every CLOCK_SYNC_DRIFT_SLOT_US for the last
+// CLOCK_SYNC_DRIFT_SLOTS of them. Once those span CLOCK_SYNC_DRIFT_FIT_US
+// they are fitted the same way, each weighted by how close its round trip
+// came to the fastest, and held to the same CLOCK_SYNC_DRIFT_SE. Without
+// a drift taken it is 0 (or the last one). The error estimate is half the
+// shortest round trip plus the spread about the fit.
+//
+// Probes go out every CLOCK_SYNC_BURST_MS until the ring is full, then
+// every CLOCK_SYNC_PROBE_MS. A probe that cannot be reconciled with the fit
+// (player 0 restarted) starts over. Player 1 is synced after
+// CLOCK_SYNC_MIN_SAMPLES probes; player 0 always is.
+//
+// gameTimeMs() is the game clock in ms, and clock_game_stamp() the same for
+// a message (0 while not synced). clock_age_ms() is how long ago a stamp
+// from the peer was, by our clock.
+
+#include <math.h>
+#include "espnow_net.h"
+
+extern uint8_t myPlayerId;
+
+const int CLOCK_SYNC_SAMPLES = 16;
+const int CLOCK_SYNC_MIN_SAMPLES = 4;
+const unsigned long CLOCK_SYNC_BURST_MS = 100;
+const unsigned long CLOCK_SYNC_PROBE_MS = 1000;
+const int64_t CLOCK_SYNC_FIT_US = 4000000;    // fit the drift over at least 4 s
+const int CLOCK_SYNC_DRIFT_SLOTS = 32;
+const int64_t CLOCK_SYNC_DRIFT_SLOT_US = 5000000;  // one probe kept per 5 s
+const int64_t CLOCK_SYNC_DRIFT_FIT_US = 60000000;  // fit the drift over at least a minute
+const int64_t CLOCK_SYNC_MAX_RTT_US = 250000;  // slower answers are not used
+const int64_t CLOCK_SYNC_JUMP_US = 50000;
+const double CLOCK_SYNC_MAX_DRIFT = 200e-6;    // crystals are good to 20-40 ppm
+const double CLOCK_SYNC_DRIFT_SE = 5e-6;       // standard error a fitted drift must beat
+
+struct ClockSample {
+  int64_t at;      // our timer, halfway through the probe
+  int64_t offset;  // the peer's timer minus ours
+  int32_t rtt;
+};
+
+struct ClockSyncStats {
+  unsigned long probesSent;
+  unsigned long samples;   // answers used
+  unsigned long rejected;  // answers too slow, repeated or from the past
+  unsigned long restarts;  // the fit started over
+  unsigned long syncedAt;  // millis() when first synced (0 = not yet)
+};
+
+struct ClockSync {
+  ClockSample ring[CLOCK_SYNC_SAMPLES];
+  int count, head;
+  // the drift's history: the fastest probe of each slot, the newest at
+  // slotHead - 1 (still being filled)
+  ClockSample slots[CLOCK_SYNC_DRIFT_SLOTS];
+  int slotCount, slotHead;
+  int64_t slotStart;
+  bool valid;
+  int64_t base;       // the fit: offset(t) = offset + drift * (t - base)
+  int64_t offset;
+  double drift;
+  int32_t errorUs;
+  int64_t lastT1;     // newest probe answered
+  unsigned long lastProbe;
+  ClockSyncStats stats;
+};
+
+inline ClockSync &clock_sync() { static ClockSync c = {}; return c; }
+
+inline void clock_sync_reset() {
+  ClockSyncStats stats = clock_sync().stats;
+  clock_sync() = ClockSync();
+  clock_sync().stats = stats;
+}
+
+inline bool clock_is_reference() { return myPlayerId == 0; }
+
+inline bool clock_synced() { return clock_is_reference() || clock_sync().valid; }
+
+// The estimated error of gameTimeUs() in us (0 on player 0).
+inline int32_t clock_sync_error_us() { return clock_is_reference() ? 0 : clock_sync().errorUs; }
+
+inline int64_t gameTimeUs() {
+  int64_t t = esp_timer_get_time();
+  const ClockSync &c = clock_sync();
+  if (clock_is_reference() || !c.valid) return t;
+  return t + c.offset + (int64_t)(c.drift * (double)(t - c.base));
+}
+
+inline uint32_t gameTimeMs() { return (uint32_t)(gameTimeUs() / 1000); }
+
+// The game time to put in a message: 0 while it would not mean anything to
+// the peer.
+inline uint32_t clock_game_stamp() {
+  if (!clock_synced()) return 0;
+  uint32_t t = gameTimeMs();
+  return t ? t : 1;
+}
+
+// How long ago (ms, not below 0) a nonzero stamp from the peer was.
+inline unsigned long clock_age_ms(uint32_t stamp) {
+  int32_t d = (int32_t)(gameTimeMs() - stamp);
+  return d > 0 ? (unsigned long)d : 0;
+}
+
+// Keep s in the drift's history if it is the fastest of its slot.
+inline void clockSyncKeepSlot(ClockSync &c, const ClockSample &s) {
+  if (c.slotCount == 0 || s.at - c.slotStart >= CLOCK_SYNC_DRIFT_SLOT_US) {
+    c.slots[c.slotHead] = s;
+    c.slotHead = (c.slotHead + 1) % CLOCK_SYNC_DRIFT_SLOTS;
+    if (c.slotCount < CLOCK_SYNC_DRIFT_SLOTS) c.slotCount++;
+    c.slotStart = s.at;
+    return;
+  }
+  ClockSample &cur = c.slots[(c.slotHead + CLOCK_SYNC_DRIFT_SLOTS - 1) % CLOCK_SYNC_DRIFT_SLOTS];
+  if (s.rtt < cur.rtt) cur = s;
+}
+
+// The drift from the slots, if they pin it down. A probe's offset is off by
+// at most half of what its round trip took beyond the fastest one (plus a
+// timer tick), so each slot is weighted by the inverse square of that.
+inline void clockSyncFitDrift(ClockSync &c) {
+  if (c.slotCount < 3) return;
+  int32_t minRtt = INT32_MAX;
+  int64_t lo = INT64_MAX, hi = INT64_MIN;
+  for (int i = 0; i < c.slotCount; i++) {
+    minRtt = std::min(minRtt, c.slots[i].rtt);
+    lo = std::min(lo, c.slots[i].at);
+    hi = std::max(hi, c.slots[i].at);
+  }
+  if (hi - lo < CLOCK_SYNC_DRIFT_FIT_US) return;
+  // weighted least squares about the newest slot, which keeps the sums small
+  const ClockSample &b = c.slots[(c.slotHead + CLOCK_SYNC_DRIFT_SLOTS - 1) % CLOCK_SYNC_DRIFT_SLOTS];
+  double w[CLOCK_SYNC_DRIFT_SLOTS], sw = 0, sx = 0, sy = 0, sxx = 0, sxy = 0;
+  for (int i = 0; i < c.slotCount; i++) {
+    const ClockSample &p = c.slots[i];
+    double e = (double)(p.rtt - minRtt) / 2 + 500;
+    w[i] = 1 / (e * e);
+    double x = (double)(p.at - b.at), y = (double)(p.offset - b.offset);
+    sw += w[i]; sx += w[i] * x; sy += w[i] * y; sxx += w[i] * x * x; sxy += w[i] * x * y;
+  }
+  double sxxc = sxx - sx * sx / sw;
+  if (sxxc <= 0) return;
+  double slope = (sxy - sx * sy / sw) / sxxc, a = (sy - slope * sx) / sw, res = 0;
+  for (int i = 0; i < c.slotCount; i++) {
+    const ClockSample &p = c.slots[i];
+    double r = (double)(p.offset - b.offset) - a - slope * (double)(p.at - b.at);
+    res += w[i] * r * r;
+  }
+  // a drift the delay noise explains as well is not taken
+  if (sqrt(res / (c.slotCount - 2) / sxxc) < CLOCK_SYNC_DRIFT_SE)
+    c.drift = std::max(-CLOCK_SYNC_MAX_DRIFT, std::min(CLOCK_SYNC_MAX_DRIFT, slope));
+}
+
+inline void clockSyncFit(ClockSync &c) {
+  clockSyncFitDrift(c);
+  int32_t minRtt = INT32_MAX;
+  int best = 0;
+  for (int i = 0; i < c.count; i++)
+    if (c.ring[i].rtt < minRtt) { minRtt = c.ring[i].rtt; best = i; }
+  // the probes that crossed about as fast as the fastest; at least 1 ms
+  // slack for a timer read once per millisecond
+  int32_t limit = 2 * minRtt + 1000;
+  int64_t lo = INT64_MAX, hi = INT64_MIN;
+  int n = 0;
+  for (int i = 0; i < c.count; i++) {
+    if (c.ring[i].rtt > limit) continue;
+    lo = std::min(lo, c.ring[i].at);
+    hi = std::max(hi, c.ring[i].at);
+    n++;
+  }
+  const ClockSample &b = c.ring[best];
+  c.base = b.at;
+  c.offset = b.offset;
+  if (n >= 3 && hi - lo >= CLOCK_SYNC_FIT_US) {
+    // least squares about the fastest probe, which keeps the sums small
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i = 0; i < c.count; i++) {
+      if (c.ring[i].rtt > limit) continue;
+      double x = (double)(c.ring[i].at - b.at), y = (double)(c.ring[i].offset - b.offset);
+      sx += x; sy += y; sxx += x * x; sxy += x * y;
+    }
+    double sxxc = sxx - sx * sx / n;
+    if (sxxc > 0) {
+      double slope = (sxy - sx * sy / n) / sxxc, a = (sy - slope * sx) / n, res = 0;
+      for (int i = 0; i < c.count; i++) {
+        if (c.ring[i].rtt > limit) continue;
+        double r = (double)(c.ring[i].offset - b.offset) - a - slope * (double)(c.ring[i].at - b.at);
+        res += r * r;
+      }
+      // a drift the delay noise explains as well is not taken
+      if (sqrt(res / (n - 2) / sxxc) < CLOCK_SYNC_DRIFT_SE)
+        c.drift = std::max(-CLOCK_SYNC_MAX_DRIFT, std::min(CLOCK_SYNC_MAX_DRIFT, slope));
+    }
+    c.offset = b.offset + (int64_t)((sy - c.drift * sx) / n);
+  }
+  double spread = 0;
+  for (int i = 0; i < c.count; i++) {
+    if (c.ring[i].rtt > limit) continue;
+    double r = (double)(c.ring[i].offset - c.offset) - c.drift * (double)(c.ring[i].at - c.base);
+    spread += r * r;
+  }
+  c.errorUs = minRtt / 2 + (int32_t)sqrt(spread / n);
+}
+
+// An answer to one of our probes (or a request we answered, ignored).
+inline void clock_sync_on_probe(const TimeProbe *p, unsigned long now) {
+  ClockSync &c = clock_sync();
+  if (p->type != ESPNOW_PKT_TIME_RESP || clock_is_reference()) return;
+  int64_t rtt = (p->t4 - p->t1) - (p->t3 - p->t2);
+  if (rtt < 0 || rtt > CLOCK_SYNC_MAX_RTT_US || p->t1 <= c.lastT1) { c.stats.rejected++; return; }
+  c.lastT1 = p->t1;
+  ClockSample s;
+  s.at = p->t1 + (p->t4 - p->t1) / 2;
+  s.offset = ((p->t2 - p->t1) + (p->t3 - p->t4)) / 2;
+  s.rtt = (int32_t)rtt;
+  if (c.valid) {
+    // the true offset is within rtt / 2 of this one
+    int64_t expect = c.offset + (int64_t)(c.drift * (double)(s.at - c.base));
+    int64_t d = s.offset - expect;
+    if (d < 0) d = -d;
+    if (d > CLOCK_SYNC_JUMP_US + rtt / 2 + c.errorUs) {
+      int64_t lastT1 = c.lastT1;
+      clock_sync_reset();
+      c.lastT1 = lastT1;
+      c.stats.restarts++;
+    }
+  }
+  c.ring[c.head] = s;
+  c.head = (c.head + 1) % CLOCK_SYNC_SAMPLES;
+  if (c.count < CLOCK_SYNC_SAMPLES) c.count++;
+  c.stats.samples++;
+  clockSyncKeepSlot(c, s);
+  clockSyncFit(c);
+  if (c.count >= CLOCK_SYNC_MIN_SAMPLES && !c.valid) {
+    c.valid = true;
+    if (!c.stats.syncedAt) c.stats.syncedAt = now;
+  }
+}
+
+// Call once per loop(): player 1 probes the peer when one is due.
+inline void clock_sync_poll(unsigned long now) {
+  ClockSync &c = clock_sync();
+  if (clock_is_reference() || !peerMacSet()) return;
+  unsigned long every = (c.count < CLOCK_SYNC_SAMPLES) ? CLOCK_SYNC_BURST_MS : CLOCK_SYNC_PROBE_MS;
+  if (c.stats.probesSent && now - c.lastProbe < every) return;
+  TimeProbe p = {};
+  p.type = ESPNOW_PKT_TIME_REQ;
+  p.t1 = esp_timer_get_time();
+  c.lastProbe = now;
+  c.stats.probesSent++;
+  net_send(espnow_get_peer_mac(), (const uint8_t *)&p, sizeof(p));
+}
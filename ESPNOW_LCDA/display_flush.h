@@ -0,0 +1,130 @@
+// display_flush.h - SH1107 driver with partial (per page, per column run) flushes
+#pragma once
+
+#include <Adafruit_SH110X.h>
+
+// Drop-in replacement for Adafruit_SH1107 that can upload only the parts of
+// the framebuffer that changed. Callers mark rectangles they redrew with
+// markDirty(); flushDirty() then sends, for every dirty page (8 pixel rows),
+// only the runs of dirty 8-column groups, each as its own page/column
+// address command followed by the data bytes. display() still sends the
+// full dirty window as before.
+//
+// Byte counters cover what flushDirty()/display() hand to the I2C device
+// (command bytes, data bytes and the control-byte prefixes).
+//
+// sendRuns() is the transfer itself, from any page-major image and dirty set;
+// async_flush.h uses it to send a snapshot from a background task.
+class PartialSH1107 : public Adafruit_SH1107 {
+public:
+  static const int MAX_PAGES = 16;  // 128 px tall
+  static const int COL_GROUP = 8;   // columns per dirty bit (16 groups = 128 px wide)
+
+  PartialSH1107(uint16_t w, uint16_t h, TwoWire *twi = &Wire, int8_t rst_pin = -1,
+                uint32_t preclk = 400000, uint32_t postclk = 100000)
+    : Adafruit_SH1107(w, h, twi, rst_pin, preclk, postclk) { markAllDirty(); }
+
+  void markDirty(int x, int y, int w, int h) {
+    if (x < 0) { w += x; x = 0; }
+    if (y < 0) { h += y; y = 0; }
+    if (x + w > WIDTH) w = WIDTH - x;
+    if (y + h > HEIGHT) h = HEIGHT - y;
+    if (w <= 0 || h <= 0) return;
+    uint16_t groups = 0;
+    for (int g = x / COL_GROUP; g <= (x + w - 1) / COL_GROUP; g++) groups |= (uint16_t)(1u << g);
+    for (int p = y / 8; p <= (y + h - 1) / 8; p++) pageDirty[p] |= groups;
+  }
+
+  void markAllDirty() {
+    for (int p = 0; p < MAX_PAGES; p++) pageDirty[p] = 0xFFFF;
+  }
+
+  // direct access to the page-major framebuffer (WIDTH bytes per page)
+  uint8_t *frameBuffer() { return buffer; }
+
+  bool anyDirty() const {
+    for (int p = 0; p < MAX_PAGES; p++) if (pageDirty[p]) return true;
+    return false;
+  }
+
+  // Move the dirty set into out[MAX_PAGES] and clear it.
+  void takeDirty(uint16_t *out) {
+    for (int p = 0; p < MAX_PAGES; p++) { out[p] = pageDirty[p]; pageDirty[p] = 0; }
+  }
+
+  // Upload dirty column runs only. Returns the number of bytes sent.
+  unsigned long flushDirty() {
+    uint16_t dirty[MAX_PAGES];
+    takeDirty(dirty);
+    unsigned long sent = sendRuns(buffer, dirty);
+    noteFlush(sent);
+    return sent;
+  }
+
+  // Send the runs marked in dirty[MAX_PAGES] from src, an image with the
+  // framebuffer's layout. Leaves the dirty set and the counters alone.
+  unsigned long sendRuns(const uint8_t *src, const uint16_t *dirty) {
+    unsigned long sent = 0;
+    if (!src || !i2c_dev) return 0;
+    int pages = (HEIGHT + 7) / 8;
+    if (pages > MAX_PAGES) pages = MAX_PAGES;
+    uint8_t dc_byte = 0x40;
+    size_t maxbuff = i2c_dev->maxBufferSize() - 1;
+    for (int p = 0; p < pages; p++) {
+      uint16_t mask = dirty[p];
+      while (mask) {
+        int g0 = __builtin_ctz(mask);
+        int g1 = g0;
+        while (g1 + 1 < 16 && (mask & (1u << (g1 + 1)))) g1++;
+        uint16_t run = (uint16_t)(((1u << (g1 + 1)) - 1) & ~((1u << g0) - 1));
+        mask &= (uint16_t)~run;
+        int x0 = g0 * COL_GROUP;
+        int x1 = min((int)WIDTH, (g1 + 1) * COL_GROUP);
+        if (x0 >= x1) continue;
+        uint8_t col = (uint8_t)(x0 + _page_start_offset);
+        uint8_t cmd[] = {0x00, (uint8_t)(SH110X_SETPAGEADDR + p), (uint8_t)(0x10 + (col >> 4)), (uint8_t)(col & 0xF)};
+        i2c_dev->write(cmd, 4);
+        sent += 4;
+        const uint8_t *ptr = src + (size_t)p * WIDTH + x0;
+        size_t remaining = (size_t)(x1 - x0);
+        while (remaining) {
+          size_t n = min(remaining, maxbuff);
+          i2c_dev->write(ptr, n, true, &dc_byte, 1);
+          sent += n + 1;
+          ptr += n; remaining -= n;
+        }
+      }
+    }
+    return sent;
+  }
+
+  void noteFlush(unsigned long sent) {
+    lastFlushBytes = sent;
+    totalBytes += sent;
+    flushes++;
+  }
+
+  // Full-window flush (menus, countdown); also clears the partial dirty set.
+  void display() {
+    for (int p = 0; p < MAX_PAGES; p++) pageDirty[p] = 0;
+    unsigned long sent = fullWindowBytes();
+    Adafruit_SH1107::display();
+    noteFlush(sent);
+  }
+
+  unsigned long lastFlushBytes = 0; // bytes sent by the most recent flush
+  unsigned long totalBytes = 0;
+  unsigned long flushes = 0;
+
+private:
+  // estimate of what the base display() sends for the current dirty window
+  unsigned long fullWindowBytes() const {
+    if (window_x2 < window_x1 || window_y2 < window_y1) return 0;
+    unsigned long cols = (unsigned long)(window_x2 - window_x1 + 1);
+    unsigned long chunk = (unsigned long)(i2c_dev ? i2c_dev->maxBufferSize() - 1 : 31);
+    unsigned long perPage = 4 + cols + (cols + chunk - 1) / chunk;
+    return perPage * (unsigned long)(window_y2 / 8 - window_y1 / 8 + 1);
+  }
+
+  uint16_t pageDirty[MAX_PAGES];
+};
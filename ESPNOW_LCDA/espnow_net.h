@@ -3,50 +3,303 @@
 #include <esp_now.h>
 #include <WiFi.h>
 #include <esp_wifi.h>
+#include <esp_timer.h>
+#include <atomic>
+#include "rx_queue.h"
+#include "net_transport.h"
+#include "telemetry.h"
 
 // Lightweight ESP-NOW helper
 static const uint8_t ESPNOW_PKT_PING = 0xA1;
 static const uint8_t ESPNOW_PKT_PONG = 0xA2;
-static uint8_t espnow_peer_mac[6] = {0,0,0,0,0,0};
-static volatile uint32_t espnow_pending_nonce = 0;
-static volatile bool espnow_got_pong = false;
-static uint8_t espnow_last_pong_from[6] = {0};
+static const uint8_t ESPNOW_PKT_TIME_REQ = 0xA3;
+static const uint8_t ESPNOW_PKT_TIME_RESP = 0xA4;
+
+// Clock probe (clock_sync.h). Times are esp_timer_get_time() microseconds of
+// the device named. A request carries t1; the responder stamps t2 on
+// arrival and t3 just before answering with the same struct as
+// ESPNOW_PKT_TIME_RESP, and the requester stamps t4 on arrival. The arrival
+// stamps are taken in the receive callback, so they do not include the
+// wait for loop().
+struct __attribute__((packed)) TimeProbe {
+  uint8_t type;
+  int64_t t1, t2, t3, t4;
+};
+
+// Link state, shared by every translation unit that includes this header
+// (the host build links the transports separately from the game code).
+struct EspNowLink {
+  uint8_t peerMac[6];
+};
+inline EspNowLink &espnow_link() { static EspNowLink l = {}; return l; }
+
+// Peer probe: peer_probe_poll() pings the peer every PEER_PROBE_INTERVAL_MS
+// from loop() and never waits. The receive callback times the pong against
+// the send time kept in the probe's slot (nonce % PEER_PROBE_SLOTS); a ping
+// not answered within peer_probe_timeout_ms() is counted lost by the next
+// poll, and a pong after that as late. The slots are the loss window: the
+// last PEER_PROBE_SLOTS pings. Answered ones feed a smoothed RTT (RFC 6298,
+// as espnow_reliable.h). The game talks to one peer, the one set with
+// setPeerMac(); setting another starts the statistics over.
+const int PEER_PROBE_SLOTS = 16;
+const unsigned long PEER_PROBE_INTERVAL_MS = 500;
+const unsigned long PEER_PROBE_TIMEOUT_MIN_MS = 100;
+const unsigned long PEER_PROBE_TIMEOUT_MAX_MS = 800;
+const unsigned long PEER_REACHABLE_MS = 1500;  // since the last pong
+const uint32_t PEER_PROBE_PENDING = 0xFFFFFFFFu;
+const uint32_t PEER_PROBE_LOST = 0xFFFFFFFEu;
+
+struct PeerProbeSlot {
+  std::atomic<uint32_t> nonce{0};
+  std::atomic<uint32_t> rttUs{PEER_PROBE_LOST};  // PENDING until the pong or the timeout
+  uint32_t sentUs = 0;
+  unsigned long sentAt = 0;
+  bool counted = true;                           // in the totals below
+};
+
+struct PeerLinkStats {
+  unsigned long pings, pongs, lost, late;
+  float srttMs, rttvarMs;  // smoothed, from the pongs
+  float minRttMs, lastRttMs;
+  int window, windowLost;  // the last PEER_PROBE_SLOTS pings that are settled
+  unsigned long lastPongAt;
+};
+
+struct PeerProbe {
+  PeerProbeSlot slot[PEER_PROBE_SLOTS];
+  uint32_t nextNonce = 1;
+  unsigned long lastSent = 0;
+  std::atomic<uint32_t> late{0};  // written by the callback
+  PeerLinkStats stats = {};
+};
+inline PeerProbe &peer_probe() { static PeerProbe p; return p; }
 
 extern void game_packet_received(const uint8_t *src_mac, const uint8_t *data, int len) __attribute__((weak));
-inline uint8_t *espnow_get_peer_mac() { return espnow_peer_mac; }
+// Clock probes, stamped and queued by the callback, handed over in loop():
+// requests we answered (with t2) and answers to ours (with t4).
+extern void net_on_time_probe(const uint8_t *src_mac, const TimeProbe *p) __attribute__((weak));
+inline uint8_t *espnow_get_peer_mac() { return espnow_link().peerMac; }
 
-inline void espnowOnDataSent(const wifi_tx_info_t *info, esp_now_send_status_t status) { (void)info; (void)status; }
+// Game frames received by the callback, waiting for espnow_poll_rx() in loop()
+inline RxQueue &espnow_rx_queue() { static RxQueue q; return q; }
+
+// A frame from the transport: pings and clock probes are answered at once,
+// pongs are timed for peer_probe_poll(), everything else is queued for
+// espnow_poll_rx().
+inline void net_on_frame(const uint8_t *src, const uint8_t *data, int len);
+
+inline void espnowOnDataSent(const wifi_tx_info_t *info, esp_now_send_status_t status) {
+  (void)info;
+  telemetry_send_status(status == ESP_NOW_SEND_SUCCESS);
+}
 
 inline void espnowOnDataRecv(const esp_now_recv_info *recvInfo, const uint8_t *data, int len) {
   if (!recvInfo || !data || len <= 0) return;
   const uint8_t *src = recvInfo->src_addr;
   if (!src) return;
+  net_on_frame(src, data, len);
+}
+
+// ESP-NOW backend
+inline bool espnowTransportBegin() {
+  WiFi.mode(WIFI_STA);
+  esp_wifi_start();
+  if (esp_now_init() != ESP_OK) return false;
+  esp_now_register_send_cb(espnowOnDataSent);
+  esp_now_register_recv_cb(espnowOnDataRecv);
+  return true;
+}
+
+inline bool espnowTransportAddPeer(const uint8_t mac[6]) {
+  esp_now_peer_info_t peerInfo = {};
+  memcpy(peerInfo.peer_addr, mac, 6);
+  peerInfo.channel = 0; peerInfo.encrypt = false; peerInfo.ifidx = WIFI_IF_STA;
+  esp_err_t r = esp_now_add_peer(&peerInfo);
+  return (r == ESP_OK || r == ESP_ERR_ESPNOW_EXIST);
+}
+
+inline bool espnowTransportSend(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  return esp_now_send(mac, data, len) == ESP_OK;
+}
+
+inline const NetTransport *espnow_transport() {
+  static const NetTransport t = { "esp-now", espnowTransportBegin, espnowTransportAddPeer, espnowTransportSend, nullptr };
+  return &t;
+}
+
+inline const NetTransport &net_transport() {
+  const NetTransport *t = net_transport_selected();
+  return t ? *t : *espnow_transport();
+}
+
+// Every frame goes out through here (loop() and the receive callback), so
+// telemetry.h sees them all.
+inline bool net_send(const uint8_t *mac, const uint8_t *data, size_t len) {
+  bool ok = net_transport().send(mac, data, len);
+  telemetry_frame_sent(len, ok);
+  return ok;
+}
+
+inline void net_on_frame(const uint8_t *src, const uint8_t *data, int len) {
+  if (!src || !data || len <= 0) return;
+  telemetry_frame_received(len);
+  if ((data[0] == ESPNOW_PKT_TIME_REQ || data[0] == ESPNOW_PKT_TIME_RESP) && len >= (int)sizeof(TimeProbe)) {
+    int64_t at = esp_timer_get_time();
+    TimeProbe p;
+    memcpy(&p, data, sizeof(p));
+    if (p.type == ESPNOW_PKT_TIME_REQ) {
+      p.t2 = at;
+      p.type = ESPNOW_PKT_TIME_RESP;
+      p.t3 = esp_timer_get_time();
+      net_send(src, (const uint8_t *)&p, sizeof(p));
+      p.type = ESPNOW_PKT_TIME_REQ;
+    } else {
+      p.t4 = at;
+    }
+    espnow_rx_queue().push(src, (const uint8_t *)&p, sizeof(p));
+    return;
+  }
   if (len >= 5) {
     uint8_t typ = data[0]; uint32_t nonce = 0; memcpy(&nonce, data + 1, sizeof(uint32_t));
     if (typ == ESPNOW_PKT_PING) {
       uint8_t pong[5]; pong[0] = ESPNOW_PKT_PONG; memcpy(pong + 1, &nonce, 4);
-      esp_now_send((uint8_t *)src, pong, sizeof(pong)); return;
+      net_send(src, pong, sizeof(pong)); return;
     }
     if (typ == ESPNOW_PKT_PONG) {
-      if (espnow_pending_nonce != 0 && nonce == espnow_pending_nonce) {
-        espnow_got_pong = true; memcpy((void*)espnow_last_pong_from, src, 6); espnow_pending_nonce = 0;
+      uint32_t at = (uint32_t)micros();
+      PeerProbe &p = peer_probe();
+      PeerProbeSlot &sl = p.slot[nonce % PEER_PROBE_SLOTS];
+      if (nonce != 0 && sl.nonce.load(std::memory_order_acquire) == nonce) {
+        uint32_t rtt = at - sl.sentUs, pending = PEER_PROBE_PENDING;
+        if (rtt >= PEER_PROBE_LOST) rtt = PEER_PROBE_LOST - 1;
+        if (!sl.rttUs.compare_exchange_strong(pending, rtt) && pending == PEER_PROBE_LOST) p.late.fetch_add(1);
       }
+      return;
     }
   }
-  if ((void*)game_packet_received != nullptr) game_packet_received(src, data, len);
+  // game frames are handled in loop() (espnow_poll_rx()), not in the Wi-Fi task
+  espnow_rx_queue().push(src, data, len);
 }
 
-inline void initEspNow() { WiFi.mode(WIFI_STA); esp_wifi_start(); if (esp_now_init() != ESP_OK) return; esp_now_register_send_cb(espnowOnDataSent); esp_now_register_recv_cb(espnowOnDataRecv); }
-inline void setPeerMac(const uint8_t mac[6]) { if (!mac) return; memcpy(espnow_peer_mac, mac, 6); }
-inline bool addEspNowPeer() { bool allZero = true; for (int i=0;i<6;i++) if (espnow_peer_mac[i]!=0) { allZero=false; break; } if (allZero) return false; esp_now_peer_info_t peerInfo = {}; memcpy(peerInfo.peer_addr, espnow_peer_mac, 6); peerInfo.channel=0; peerInfo.encrypt=false; peerInfo.ifidx=WIFI_IF_STA; esp_err_t r = esp_now_add_peer(&peerInfo); return (r==ESP_OK||r==ESP_ERR_ESPNOW_EXIST); }
+// Hand the frames queued so far to the game, oldest first (frames arriving
+// meanwhile wait for the next call). Call once per loop() before the game
+// state is updated. Returns the number of frames handled.
+inline int espnow_poll_rx() {
+  const NetTransport &t = net_transport();
+  if (t.poll) t.poll();
+  RxQueue &q = espnow_rx_queue();
+  int budget = (int)q.depth();
+  int n = 0;
+  while (n < budget) {
+    const RxFrame *f = q.peek();
+    if (!f) break;
+    if (f->data[0] == ESPNOW_PKT_TIME_REQ || f->data[0] == ESPNOW_PKT_TIME_RESP) {
+      if ((void*)net_on_time_probe != nullptr) net_on_time_probe(f->src, (const TimeProbe *)f->data);
+    } else if ((void*)game_packet_received != nullptr) {
+      game_packet_received(f->src, f->data, f->len);
+    }
+    q.pop();
+    n++;
+  }
+  return n;
+}
+
+inline void peer_probe_reset() {
+  PeerProbe &p = peer_probe();
+  for (PeerProbeSlot &sl : p.slot) {
+    sl.nonce.store(0);
+    sl.rttUs.store(PEER_PROBE_LOST);
+    sl.counted = true;
+  }
+  p.lastSent = 0;
+  p.late.store(0);
+  p.stats = PeerLinkStats();
+}
+
+inline void initEspNow() { net_transport().begin(); }
+inline void setPeerMac(const uint8_t mac[6]) {
+  if (!mac) return;
+  if (memcmp(espnow_link().peerMac, mac, 6) != 0) peer_probe_reset();
+  memcpy(espnow_link().peerMac, mac, 6);
+}
+inline bool peerMacSet() { const uint8_t *m = espnow_link().peerMac; for (int i=0;i<6;i++) if (m[i]!=0) return true; return false; }
+inline bool addEspNowPeer() { if (!peerMacSet()) return false; return net_transport().addPeer(espnow_link().peerMac); }
+
+// How long a ping may go unanswered: srtt + 4 * rttvar of the pongs so far.
+inline unsigned long peer_probe_timeout_ms() {
+  const PeerLinkStats &st = peer_probe().stats;
+  if (!st.pongs) return PEER_PROBE_TIMEOUT_MAX_MS;
+  unsigned long t = (unsigned long)(st.srttMs + 4 * st.rttvarMs + 0.5f);
+  return t < PEER_PROBE_TIMEOUT_MIN_MS ? PEER_PROBE_TIMEOUT_MIN_MS : (t > PEER_PROBE_TIMEOUT_MAX_MS ? PEER_PROBE_TIMEOUT_MAX_MS : t);
+}
+
+// Settle the pings that were answered or timed out, then send the next one
+// when it is due. Call once per loop() in every state.
+inline void peer_probe_poll(unsigned long now) {
+  PeerProbe &p = peer_probe();
+  PeerLinkStats &st = p.stats;
+  unsigned long timeout = peer_probe_timeout_ms();
+  int window = 0, lost = 0;
+  for (PeerProbeSlot &sl : p.slot) {
+    if (sl.nonce.load() == 0) continue;
+    uint32_t r = sl.rttUs.load();
+    if (r == PEER_PROBE_PENDING) {
+      if (now - sl.sentAt < timeout) continue;
+      if (sl.rttUs.compare_exchange_strong(r, PEER_PROBE_LOST)) r = PEER_PROBE_LOST;  // else r is the pong's
+    }
+    window++;
+    if (r == PEER_PROBE_LOST) lost++;
+    if (sl.counted) continue;
+    sl.counted = true;
+    if (r == PEER_PROBE_LOST) { st.lost++; continue; }
+    float ms = r / 1000.0f;
+    if (!st.pongs) {
+      st.srttMs = ms;
+      st.rttvarMs = ms / 2;
+      st.minRttMs = ms;
+    } else {
+      float err = ms - st.srttMs;
+      st.rttvarMs += ((err < 0 ? -err : err) - st.rttvarMs) / 4;
+      st.srttMs += err / 8;
+      if (ms < st.minRttMs) st.minRttMs = ms;
+    }
+    st.lastRttMs = ms;
+    telemetry_rtt(telemetry().pingRtt, ms);
+    st.pongs++;
+    st.lastPongAt = now;
+  }
+  st.window = window;
+  st.windowLost = lost;
+  st.late = p.late.load();
+  if (!peerMacSet() || (st.pings && now - p.lastSent < PEER_PROBE_INTERVAL_MS)) return;
+
+  uint32_t nonce = p.nextNonce++;
+  if (!nonce) nonce = p.nextNonce++;
+  PeerProbeSlot &sl = p.slot[nonce % PEER_PROBE_SLOTS];
+  sl.nonce.store(0);
+  sl.rttUs.store(PEER_PROBE_PENDING);
+  sl.sentUs = (uint32_t)micros();
+  sl.sentAt = now;
+  sl.counted = false;
+  sl.nonce.store(nonce, std::memory_order_release);
+  p.lastSent = now;
+  st.pings++;
+  uint8_t pkt[5];
+  pkt[0] = ESPNOW_PKT_PING;
+  memcpy(pkt + 1, &nonce, 4);
+  net_send(espnow_link().peerMac, pkt, sizeof(pkt));
+}
+
+// Fraction of the pings in the loss window that went unanswered.
+inline float peer_probe_loss() {
+  const PeerLinkStats &st = peer_probe().stats;
+  return st.window ? (float)st.windowLost / st.window : 0.0f;
+}
 
-inline bool isPeerReachable(uint32_t timeoutMs=800) {
-  bool allZero = true; for (int i=0;i<6;i++) if (espnow_peer_mac[i]!=0) { allZero=false; break; } if (allZero) return false;
-  uint8_t pkt[5]; pkt[0]=ESPNOW_PKT_PING; uint32_t nonce=(uint32_t)micros(); if (nonce==0) nonce=1; memcpy(pkt+1,&nonce,4);
-  espnow_pending_nonce = nonce; espnow_got_pong = false;
-  esp_err_t r = esp_now_send(espnow_peer_mac, pkt, sizeof(pkt)); if (r!=ESP_OK) { espnow_pending_nonce=0; return false; }
-  unsigned long start = millis(); while (millis()-start < timeoutMs) { if (espnow_got_pong) return true; delay(5); }
-  espnow_pending_nonce = 0; return false;
+// Cached: a pong arrived within PEER_REACHABLE_MS. Needs peer_probe_poll().
+inline bool isPeerReachable() {
+  const PeerLinkStats &st = peer_probe().stats;
+  return peerMacSet() && st.pongs && millis() - st.lastPongAt < PEER_REACHABLE_MS;
 }
 
-inline bool isPlayer2Connected() { if (esp_now_init() != ESP_OK) { } return isPeerReachable(800); }
+inline bool isPlayer2Connected() { return isPeerReachable(); }
@@ -0,0 +1,272 @@
+#pragma once
+
+// espnow_reliable.h - acked delivery with retransmission for game messages
+//
+// Included from espnow_game.h after the message structs and send_raw_to_peer().
+//
+// Reliable messages (bomb place/explode, score update, player death, state
+// snapshot) take GameHdr.seq from their own counter and stay in a retransmit
+// queue until the peer acks that seq. Each queued message is resent when its
+// own timeout expires. The timeout starts at the adaptive RTO (RFC 6298:
+// srtt + 4 * rttvar, sampled only from messages acked on the first try) and
+// doubles on every retry. The receiver collects the seqs it got, new or
+// duplicate, and acks them together in one MsgAck per reliable_poll()
+// (selective ack). A window of recently seen seqs keeps duplicates from
+// being delivered twice.
+//
+// Every reliable message ends with the sender's session byte, drawn at
+// boot (reliable_send() appends it, processGamePacket() strips it). The
+// seqs of a rebooted peer start over at 1; when the session byte changes,
+// or a seq lands more than RELIABLE_RESTART_JUMP behind the window, the
+// window starts over instead of taking the new messages for old duplicates
+// (which would be acked and dropped, and never resent).
+//
+// Call reliable_poll() from loop() in every state.
+
+const int RELIABLE_QUEUE = 16;        // messages in flight
+const int RELIABLE_MAX_LEN = 48;      // larger messages are sent once, unreliably
+const int RELIABLE_MAX_TRIES = 10;    // then the message is dropped
+const int RELIABLE_ACK_BATCH = 16;    // seqs per MsgAck
+const int RELIABLE_TRAILER = 1;       // the session byte after each message
+const int RELIABLE_RESTART_JUMP = 1024;  // a seq this far back means the peer's seqs restarted
+const unsigned long RELIABLE_RTO_INIT_MS = 100;
+const unsigned long RELIABLE_RTO_MIN_MS = 20;
+const unsigned long RELIABLE_RTO_MAX_MS = 1000;
+
+struct RelEntry {
+  bool used;
+  uint8_t len;
+  uint8_t tries;
+  uint16_t seq;
+  unsigned long queuedAt;
+  unsigned long sentAt;
+  unsigned long rto;   // timeout of the current try
+  uint32_t relTime;    // send-time-relative payload field at queue time (bomb age)
+  uint8_t buf[RELIABLE_MAX_LEN + RELIABLE_TRAILER];
+};
+
+struct RelStats {
+  unsigned long sent;        // reliable messages queued
+  unsigned long retransmits;
+  unsigned long acked;
+  unsigned long dropped;     // gave up after RELIABLE_MAX_TRIES
+  unsigned long unqueued;    // sent once because the queue was full or the message too big
+  unsigned long received;    // new reliable messages delivered
+  unsigned long duplicates;  // reliable messages suppressed as already seen
+  unsigned long peerRestarts;  // the receive window started over (new session byte or seq jump)
+  unsigned long ackFrames;
+};
+
+struct ReliableState {
+  RelEntry q[RELIABLE_QUEUE];
+  uint16_t txSeq;
+  uint8_t txSession;         // never 0
+  bool haveRtt;
+  float srtt, rttvar;        // ms
+  unsigned long rto;
+  // receive window: bit i of rxSeen = seq (rxMax - i) was delivered
+  bool rxAny;
+  uint8_t rxSession;
+  uint16_t rxMax;
+  uint64_t rxSeen;
+  uint16_t ackPending[RELIABLE_ACK_BATCH];
+  int ackCount;
+  uint8_t selfId;            // fromId for our acks (set by reliable_poll())
+  RelStats stats;
+};
+
+inline ReliableState &reliable() {
+  static ReliableState s = {};
+  if (!s.rto) { s.rto = RELIABLE_RTO_INIT_MS; s.txSeq = 1; s.txSession = (uint8_t)(1 + esp_random() % 255); }
+  return s;
+}
+
+inline bool reliable_is_type(uint8_t type) {
+  return type == MSG_BOMB_PLACE || type == MSG_BOMB_EXPLODE || type == MSG_SCORE_UPDATE ||
+         type == MSG_PLAYER_DEATH || type == MSG_STATE_SNAPSHOT;
+}
+
+// Queue and send a message that starts with a GameHdr; the seq is assigned
+// here and the session byte appended (len + RELIABLE_TRAILER must fit in a
+// frame). Returns false only if the message could not be queued and its one
+// send failed.
+inline bool reliable_send(uint8_t *buf, size_t len) {
+  ReliableState &s = reliable();
+  GameHdr *h = (GameHdr *)buf;
+  h->seq = s.txSeq++;
+  RelEntry *e = nullptr;
+  if (len <= (size_t)RELIABLE_MAX_LEN) {
+    for (int i = 0; i < RELIABLE_QUEUE; i++) if (!s.q[i].used) { e = &s.q[i]; break; }
+  }
+  if (!e) {
+    s.stats.unqueued++;
+    uint8_t once[ESP_NOW_MAX_DATA_LEN];
+    if (len + RELIABLE_TRAILER > sizeof(once)) return false;
+    memcpy(once, buf, len);
+    once[len] = s.txSession;
+    return send_raw_to_peer(once, len + RELIABLE_TRAILER);
+  }
+  unsigned long now = millis();
+  e->used = true;
+  e->len = (uint8_t)(len + RELIABLE_TRAILER);
+  e->tries = 1;
+  e->seq = h->seq;
+  e->queuedAt = now;
+  e->sentAt = now;
+  e->rto = s.rto;
+  // until an ack has been timed, a link the pings show to be slow
+  // (espnow_net.h) starts with their timeout
+  const PeerLinkStats &link = peer_probe().stats;
+  if (!s.haveRtt && link.pongs) {
+    unsigned long t = (unsigned long)(link.srttMs + 4 * link.rttvarMs + 0.5f);
+    if (t > e->rto) e->rto = (t > RELIABLE_RTO_MAX_MS) ? RELIABLE_RTO_MAX_MS : t;
+  }
+  memcpy(e->buf, buf, len);
+  e->buf[len] = s.txSession;
+  e->relTime = (h->type == MSG_BOMB_PLACE) ? ((const MsgBombPlace *)buf)->placedMs : 0;
+  s.stats.sent++;
+  send_raw_to_peer(e->buf, e->len);
+  return true;
+}
+
+// Stop retransmitting the placement of bombId (it exploded; the explode
+// message now carries the bomb's fate).
+inline void reliable_cancel_bomb_place(uint16_t bombId) {
+  ReliableState &s = reliable();
+  for (int i = 0; i < RELIABLE_QUEUE; i++) {
+    RelEntry &e = s.q[i];
+    if (e.used && e.buf[0] == MSG_BOMB_PLACE && ((const MsgBombPlace *)e.buf)->bombId == bombId) e.used = false;
+  }
+}
+
+inline int reliable_in_flight() {
+  ReliableState &s = reliable();
+  int n = 0;
+  for (int i = 0; i < RELIABLE_QUEUE; i++) n += s.q[i].used ? 1 : 0;
+  return n;
+}
+
+inline void reliable_rtt_sample(ReliableState &s, float r) {
+  telemetry_rtt(telemetry().ackRtt, r);
+  if (!s.haveRtt) {
+    s.srtt = r;
+    s.rttvar = r / 2;
+    s.haveRtt = true;
+  } else {
+    float err = r - s.srtt;
+    s.rttvar += ((err < 0 ? -err : err) - s.rttvar) / 4;
+    s.srtt += err / 8;
+  }
+  unsigned long rto = (unsigned long)(s.srtt + 4 * s.rttvar + 0.5f);
+  if (rto < RELIABLE_RTO_MIN_MS) rto = RELIABLE_RTO_MIN_MS;
+  if (rto > RELIABLE_RTO_MAX_MS) rto = RELIABLE_RTO_MAX_MS;
+  s.rto = rto;
+}
+
+inline void reliable_ack_seq(ReliableState &s, uint16_t seq, unsigned long now) {
+  for (int i = 0; i < RELIABLE_QUEUE; i++) {
+    RelEntry &e = s.q[i];
+    if (!e.used || e.seq != seq) continue;
+    if (e.tries == 1) reliable_rtt_sample(s, (float)(now - e.sentAt));  // Karn: skip retransmitted ones
+    e.used = false;
+    s.stats.acked++;
+    return;
+  }
+}
+
+// MsgAck from the peer: ackSeq plus m->extra further seqs after the struct.
+inline void reliable_on_ack(const MsgAck *m, int len) {
+  ReliableState &s = reliable();
+  unsigned long now = millis();
+  reliable_ack_seq(s, m->ackSeq, now);
+  const uint8_t *more = (const uint8_t *)m + sizeof(MsgAck);
+  int n = m->extra;
+  if (n > (len - (int)sizeof(MsgAck)) / 2) n = (len - (int)sizeof(MsgAck)) / 2;
+  for (int i = 0; i < n; i++) {
+    uint16_t seq;
+    memcpy(&seq, more + 2 * i, 2);
+    reliable_ack_seq(s, seq, now);
+  }
+}
+
+inline void reliable_flush_acks(ReliableState &s, uint8_t fromId) {
+  if (s.ackCount == 0) return;
+  uint8_t pkt[sizeof(MsgAck) + 2 * (RELIABLE_ACK_BATCH - 1)];
+  MsgAck *m = (MsgAck *)pkt;
+  m->h.type = MSG_ACK; m->h.seq = next_game_seq(); m->h.fromId = fromId;
+  m->ackSeq = s.ackPending[0];
+  m->extra = (uint8_t)(s.ackCount - 1);
+  memcpy(pkt + sizeof(MsgAck), &s.ackPending[1], 2 * (s.ackCount - 1));
+  send_raw_to_peer(pkt, sizeof(MsgAck) + 2 * (s.ackCount - 1));
+  s.ackCount = 0;
+  s.stats.ackFrames++;
+}
+
+// A reliable message arrived with the sender's session byte: queue its ack
+// and report whether it is new.
+inline bool reliable_on_receive(const GameHdr *h, uint8_t session) {
+  ReliableState &s = reliable();
+  uint16_t seq = h->seq;
+  bool queued = false;
+  for (int i = 0; i < s.ackCount; i++) if (s.ackPending[i] == seq) { queued = true; break; }
+  if (!queued) {
+    if (s.ackCount == RELIABLE_ACK_BATCH) reliable_flush_acks(s, s.selfId);
+    s.ackPending[s.ackCount++] = seq;
+  }
+
+  bool isNew;
+  int16_t d = (int16_t)(seq - s.rxMax);
+  if (s.rxAny && (session != s.rxSession || d < -RELIABLE_RESTART_JUMP)) {
+    s.rxAny = false;
+    s.stats.peerRestarts++;
+  }
+  if (!s.rxAny) {
+    s.rxAny = true; s.rxSession = session; s.rxMax = seq; s.rxSeen = 1; isNew = true;
+  } else if (d > 0) {
+    s.rxSeen = (d >= 64) ? 1 : ((s.rxSeen << d) | 1);
+    s.rxMax = seq;
+    isNew = true;
+  } else if (-d >= 64) {
+    isNew = false;  // older than the window: delivered long ago
+  } else {
+    uint64_t bit = 1ULL << -d;
+    isNew = !(s.rxSeen & bit);
+    s.rxSeen |= bit;
+    if (isNew) telemetry().relOutOfOrder++;
+  }
+  if (isNew) s.stats.received++;
+  else s.stats.duplicates++;
+  return isNew;
+}
+
+// The peer (re)joined: its seqs may have restarted.
+inline void reliable_peer_reset() {
+  ReliableState &s = reliable();
+  s.rxAny = false;
+  s.ackCount = 0;
+}
+
+// Send pending acks and retransmit messages whose timeout expired.
+inline void reliable_poll(unsigned long now, uint8_t fromId) {
+  ReliableState &s = reliable();
+  s.selfId = fromId;
+  reliable_flush_acks(s, fromId);
+  for (int i = 0; i < RELIABLE_QUEUE; i++) {
+    RelEntry &e = s.q[i];
+    if (!e.used || now - e.sentAt < e.rto) continue;
+    if (e.tries >= RELIABLE_MAX_TRIES) {
+      e.used = false;
+      s.stats.dropped++;
+      continue;
+    }
+    // fields relative to the send time are brought up to date
+    if (e.buf[0] == MSG_BOMB_PLACE) ((MsgBombPlace *)e.buf)->placedMs = e.relTime + (uint32_t)(now - e.queuedAt);
+    e.tries++;
+    e.sentAt = now;
+    e.rto = (e.rto * 2 > RELIABLE_RTO_MAX_MS) ? RELIABLE_RTO_MAX_MS : e.rto * 2;
+    s.stats.retransmits++;
+    send_raw_to_peer(e.buf, e.len);
+  }
+}
+
+// End of espnow_reliable.h
@@ -4,6 +4,8 @@
 #include <Arduino.h>
 #include "sprites.h"
 #include <Adafruit_SH110X.h>
+#include "display_flush.h"
+#include "sprite_blit.h"
 // debug macros (ENABLE_DEBUG may be defined in the main sketch)
 #include "debug.h"
 
@@ -12,6 +14,8 @@
 
 // Map storage (defined in the sketch)
 extern Tile mapData[MAP_ROWS][MAP_COLS];
+// pre-rendered background of mapData (storage `mapLayer` defined in the sketch)
+#include "map_layer.h"
 
 // Bomb structure and storage (bombs[] defined in the sketch)
 // Added owner field so bombs can be attributed to a player.
@@ -22,16 +26,123 @@ struct BombGE {
   unsigned long placedAt;
   unsigned long fuseMs;
   uint8_t owner; // player id who placed the bomb (0/1), 0xFF = unknown
+  uint16_t netId; // id peers know this bomb by (MSG_BOMB_PLACE/EXPLODE bombId)
 };
 typedef BombGE Bomb;
 extern const int MAX_BOMBS;
 extern Bomb bombs[];
+const int MAX_BOMBS_LIMIT = 32;  // the sketch static_asserts MAX_BOMBS against it
 
-// Explosion cell (visual) and storage (explosions[] defined in the sketch)
-struct ExplosionCellGE { int x; int y; unsigned long endAt; };
-typedef ExplosionCellGE ExplosionCell;
-extern const int MAX_EXPLOSION_CELLS;
-extern ExplosionCell explosions[];
+// Tile -> bombs[] slot index (-1 = no active bomb) plus a bitmask of free
+// slots (bit i set = bombs[i] free, so MAX_BOMBS <= MAX_BOMBS_LIMIT). Kept in
+// sync with bombs[] by bombSpawn()/bombRelease(); storage is in the sketch.
+struct BombIndexGE {
+  int8_t at[MAP_ROWS][MAP_COLS];
+  uint32_t freeMask;
+  uint16_t lastNetId; // netId of the most recent local placement (of either player in lockstep.h)
+};
+typedef BombIndexGE BombIndex;
+extern BombIndex bombIndex;
+
+// Explosion cells (visual + hit test), indexed by tile. endAt[y][x] is the
+// time the cell stops burning (0 = not burning). `active` lists the tile
+// indices (y * MAP_COLS + x) with a non-zero endAt so rendering and pruning
+// only touch live cells. Storage (`explosions`) is defined in the sketch.
+struct ExplosionGridGE {
+  unsigned long endAt[MAP_ROWS][MAP_COLS];
+  uint16_t active[MAP_ROWS * MAP_COLS];
+  int activeCount;
+};
+typedef ExplosionGridGE ExplosionGrid;
+extern ExplosionGrid explosions;
+
+// Timer queue: a binary min-heap of due events ordered by time, ties broken
+// by insertion order, so bombs that expire in the same tick detonate in the
+// order they were scheduled. Each active bomb owns one TIMER_BOMB_FUSE entry
+// and at most one TIMER_EXPLOSION_END entry (the earliest cell expiry) is
+// pending, so the heap needs MAX_BOMBS + 1 slots. Storage (`timers` and
+// `timerHeap[MAX_BOMBS + 1]`) is defined in the sketch.
+enum TimerKind : uint8_t { TIMER_BOMB_FUSE = 0, TIMER_EXPLOSION_END = 1 };
+struct TimerEvent {
+  unsigned long at;
+  uint32_t seq;
+  uint8_t kind;
+  int8_t slot; // bombs[] index for TIMER_BOMB_FUSE
+};
+struct TimerQueueGE {
+  int count;
+  uint32_t seq;
+  bool explosionPending;
+};
+typedef TimerQueueGE TimerQueue;
+extern TimerQueue timers;
+extern TimerEvent timerHeap[];
+
+// Peer bombs keyed by (owner, netId): the bombs[] slot a live one occupies
+// here, or a record that it already went off, so resent or late place and
+// explode messages are applied once. Finished entries stay until the entry
+// is needed again (oldest first). Storage (`remoteBombs`) is defined in the
+// sketch.
+const int REMOTE_BOMB_ENTRIES = 16;
+enum RemoteBombState : uint8_t { RB_FREE = 0, RB_LIVE = 1, RB_DONE = 2 };
+enum RemoteBombResult : uint8_t {
+  RB_SPAWNED = 0,  // new bomb placed in bombs[]
+  RB_REFINED = 1,  // already live: fuse estimate updated if the new one is earlier
+  RB_IGNORED = 2,  // already exploded here
+  RB_REJECTED = 3  // tile occupied or bombs[] full
+};
+struct RemoteBombEntry {
+  uint8_t state;
+  uint8_t owner;
+  uint16_t id;
+  int8_t slot;             // bombs[] index while RB_LIVE
+  unsigned long doneAt;    // when it went off (RB_DONE)
+};
+struct RemoteBombTableGE {
+  RemoteBombEntry e[REMOTE_BOMB_ENTRIES];
+  unsigned long spawned, refined, duplicatePlaces, duplicateExplodes;
+};
+typedef RemoteBombTableGE RemoteBombTable;
+extern RemoteBombTable remoteBombs;
+
+// One blast origin in a chain: a bomb (slot >= 0) or a bare explosion point
+// (slot -1, e.g. a stale remote bomb). Ray lengths are taken from the map as
+// it was before the chain so the result does not depend on BFS order.
+struct BlastSource {
+  uint8_t x, y;
+  uint8_t owner;
+  int8_t slot;
+  uint8_t len[4];
+  bool hitBreakable[4];
+  // owner of a bomb sitting on the breakable tile that ends ray d (0xFF = none)
+  uint8_t breakOwner[4];
+};
+
+// Batched outcome of one chain, handed to on_local_blast_resolved().
+// `sources` is only valid for the duration of the hook.
+struct BlastResult {
+  int eventId;
+  const BlastSource *sources; // BFS order; sources[0] is the root
+  int sourceCount;
+  int tilesDestroyed;
+  int points; // score credited to myPlayerId by this chain
+};
+
+// Tiles whose on-screen content may have changed since the last
+// renderDirtyTiles(): map edits, bombs appearing/going away, explosion cells
+// starting/ending and player moves. One bit per tile; `count` is the number
+// of set bits. The drawn* fields remember what the last render put on screen
+// so player moves and the spawn-flash can be detected there. Storage
+// (`dirtyTiles`) is defined in the sketch.
+struct DirtyTilesGE {
+  uint8_t bits[MAP_ROWS][(MAP_COLS + 7) / 8];
+  int count;
+  int drawnOffset;              // xPixelOffset of the last render (-1 = nothing drawn)
+  int drawnPX, drawnPY;         // local player tile (-1 = hidden)
+  int drawnOX, drawnOY;         // remote player, map pixels (-1 = hidden)
+};
+typedef DirtyTilesGE DirtyTiles;
+extern DirtyTiles dirtyTiles;
 
 // Parameters
 extern const unsigned long BOMB_FUSE;
@@ -55,6 +166,16 @@ extern int explosionEventCounter;
 // per-player spawn coordinates (defined in sketch)
 extern int spawnX;
 extern int spawnY;
+// remote player as last reported by the peer (defined in sketch)
+extern int otherPlayerX, otherPlayerY;
+extern bool otherPlayerVisible;
+
+// Where the remote player is drawn, in pixels from its tile. remote_player.h
+// slides it between tiles; otherwise it stays 0.
+struct RemoteDrawGE {
+  int dx, dy;
+};
+inline RemoteDrawGE &remoteDraw() { static RemoteDrawGE d = {}; return d; }
 
 // The main sketch may define these optional globals to control map behavior:
 //   - const bool AUTO_RANDOMIZE_ON_START  : if true, randomize map at initializeGame();
@@ -76,153 +197,621 @@ extern void resetScores() __attribute__((weak));
 // bombs placed locally. Declare as extern here.
 extern uint8_t myPlayerId;
 
+// Engine time: fuses, burning cells and invulnerability are timed with
+// gameMillis(). It is millis() unless a fixed-tick simulation (lockstep.h)
+// pins it to the time of the tick being stepped, so both devices see the
+// same times. While a peer's explosion is applied `behind` ms after it
+// happened (remoteBombExplode()), the clock is set back to then.
+struct GameClockGE {
+  bool fixed;
+  unsigned long now;
+  unsigned long behind;
+};
+inline GameClockGE &gameClock() { static GameClockGE c = {}; return c; }
+inline unsigned long gameMillis() { return gameClock().fixed ? gameClock().now : millis() - gameClock().behind; }
+// While lockstep.h steps both players here, blasts score for both of them
+// and nothing is announced to the peer (it steps the same blasts).
+inline bool gameLockstep() { return gameClock().fixed; }
+
+// Map access. All tile reads/writes outside generateMap() should go through
+// these helpers so the optional bitboard backend stays in sync with mapData.
+// Define MAP_BITBOARD before including this header to keep per-row and
+// per-column masks of solid/breakable tiles; collision and blast rays then
+// use mask/shift operations instead of walking mapData cell by cell.
+// MAP_BITBOARD_WIDE switches the masks to 64 bits for arenas up to 64x64.
+#ifdef MAP_BITBOARD
+#ifdef MAP_BITBOARD_WIDE
+typedef uint64_t MapMask;
+#else
+typedef uint32_t MapMask;
+#endif
+static_assert(MAP_COLS <= 8 * sizeof(MapMask) && MAP_ROWS <= 8 * sizeof(MapMask),
+              "map wider or taller than a MapMask; define MAP_BITBOARD_WIDE");
+struct MapBits {
+  MapMask solidRows[MAP_ROWS];  // bit x set when (x, row) is solid
+  MapMask breakRows[MAP_ROWS];
+  MapMask solidCols[MAP_COLS];  // bit y set when (col, y) is solid
+  MapMask breakCols[MAP_COLS];
+};
+// single instance even if the header ends up in several translation units
+inline MapBits &mapBits() { static MapBits b; return b; }
+#endif
+inline Tile mapTileAt(int x, int y) { return mapData[y][x]; }
+void mapSetTile(int x, int y, Tile t);
+bool mapIsWalkable(int x, int y);
+void mapRebuildMasks();
+// Number of cells a blast covers from (bx,by) in direction d (0:+x 1:-x 2:+y 3:-y),
+// capped at radius. hitBreakable is set when the last covered cell is breakable.
+int blastRayLength(int bx, int by, int d, int radius, bool *hitBreakable);
+
+// Zobrist digest of the state both devices should agree on, for
+// MSG_STATE_HASH (state_sync.h). Every (tile, value) and every active bomb
+// (owner, tile) has a pseudo-random key; mapSetTile(), bombSpawn() and
+// bombReleaseSlot() XOR keys out and in as things change, so the digest
+// costs nothing per tick. The map is split into STATE_HASH_REGIONS bands of
+// rows so a mismatch names the band to resync. generateMap() rebuilds it.
+struct StateHashGE {
+  uint32_t region[STATE_HASH_REGIONS];
+  uint32_t bombs;
+};
+inline StateHashGE &stateHash() { static StateHashGE h; return h; }
+inline int stateHashRegionOf(int y) { return y * STATE_HASH_REGIONS / MAP_ROWS; }
+// murmur3 finalizer: a fixed pseudo-random key per feature, no table needed
+inline uint32_t zobristKey(uint32_t feature) {
+  uint32_t k = feature * 0x9E3779B9u + 0x7F4A7C15u;
+  k ^= k >> 16; k *= 0x85EBCA6Bu; k ^= k >> 13; k *= 0xC2B2AE35u; k ^= k >> 16;
+  return k;
+}
+inline uint32_t zobristTile(int x, int y, Tile t) { return zobristKey(((uint32_t)(y * MAP_COLS + x) << 2) | (uint32_t)t); }
+inline uint32_t zobristBomb(int x, int y, uint8_t owner) { return zobristKey(0x80000000u | ((uint32_t)owner << 16) | (uint32_t)(y * MAP_COLS + x)); }
+void stateHashRebuildMap();
+
 // Core game functions (implemented inline below)
 // forceDamage: when true, damage is applied even if player invulnerability timer active.
 // ownerId is the player id who caused the explosion (0/1) or 0xFF if unknown.
 void addExplosionCell(int x, int y, uint8_t ownerId, bool forceDamage = false, int eventId = 0);
+// Start (or extend) the burning of a cell until endAt, without damage.
+void explosionBurn(int x, int y, unsigned long endAt);
 // damagePlayerAt is implemented in the main sketch; called when an explosion cell appears
 // forceDamage: when true the damage call should bypass temporary invulnerability.
 void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage = false, int eventId = 0);
 // explodeAt now accepts an owner id so scoring can be attributed correctly.
+// Bombs caught in the blast chain-detonate (see resolveBlast()).
 void explodeAt(int bx, int by, uint8_t ownerId);
+int resolveBlast(int bx, int by, uint8_t ownerId, int rootSlot);
 void updateBombs();
-void placeBombAtPlayer();
+// returns the bombs[] slot used, or -1 if the tile is occupied or no slot is free
+int placeBombAtPlayer();
+// Bomb slot management (all O(1)). bombSpawn() returns the slot or -1.
+int bombAt(int x, int y);
+int bombSpawn(int x, int y, unsigned long placedAt, unsigned long fuseMs, uint8_t owner);
+void bombRelease(int i);
+void bombReleaseSlot(int i);
+void bombResetAll();
+int bombFreeCount();
+// Peer bombs (see RemoteBombTable). placedAt is the local estimate of the
+// placement time; remoteBombExplode() returns false for a duplicate.
+RemoteBombResult remoteBombPlace(uint8_t owner, uint16_t id, int x, int y, unsigned long placedAt, unsigned long fuseMs);
+bool remoteBombExplode(uint8_t owner, uint16_t id, int x, int y, unsigned long lateMs = 0);
+void remoteBombSlotGone(int slot);
+void remoteBombReset();
+// Timer queue (see TimerQueue). updateBombs() pops and handles due events;
+// msUntilNextTimer() is how long the caller may idle (-1 = nothing pending).
+void timerPush(unsigned long at, uint8_t kind, int slot);
+bool timerPopDue(unsigned long now, TimerEvent *out);
+void timerCancel(uint8_t kind, int slot);
+void timerReset();
+long msUntilNextTimer(unsigned long now);
 void generateMap();
-void renderBombsAndExplosions(Adafruit_SH1107 &disp, int xPixelOffset);
+void renderBombsAndExplosions(PartialSH1107 &disp, int xPixelOffset);
+// Dirty-tile tracking (see DirtyTiles)
+void markTileDirty(int x, int y);
+void markAllTilesDirty();
+// Redraw only dirty tiles of the 128px-wide window at xPixelOffset into the
+// framebuffer (no clearDisplay() needed) and mark them for flushDirty().
+void renderDirtyTiles(PartialSH1107 &disp, int xPixelOffset);
 void drawTile(Adafruit_SH1107 &disp, int px, int py, Tile t);
 
 // helpers
 void initializeGame();
 void randomizeMap();
 bool isExplosionAt(int tx, int ty);
+// drop expired cells from the explosion grid and schedule the next expiry
+// (run from updateBombs() when the TIMER_EXPLOSION_END event is due)
+void pruneExplosions(unsigned long now);
 void checkPlayerHit();
-// weak hook called when a local bomb is about to explode: implement in sketch to notify peers
-extern void on_local_bomb_exploded(int cx, int cy, int bombId) __attribute__((weak));
+// weak hook called once per chain started by a fuse expiring on this device
+// (after the chain has been applied): implement in sketch to notify peers
+extern void on_local_blast_resolved(const BlastResult &r) __attribute__((weak));
 
 // -----------------------------
 // Implementations (inline)
 // -----------------------------
 
-inline void addExplosionCell(int x, int y, uint8_t ownerId, bool forceDamage, int eventId) {
-  for (int i = 0; i < MAX_EXPLOSION_CELLS; i++) {
-    if (explosions[i].endAt == 0 || millis() > explosions[i].endAt) {
-      explosions[i].x = x;
-      explosions[i].y = y;
-      explosions[i].endAt = millis() + EXPLOSION_VIS_MS;
-      // delegate damage handling to the main sketch implementation so
-      // immunity rules (e.g., standing on own bomb) and game-over can be applied there
-      damagePlayerAt(x, y, ownerId, forceDamage, eventId);
-      return;
-    }
+#ifdef MAP_BITBOARD
+inline MapMask mapLowMask(int n) {
+  if (n <= 0) return 0;
+  if (n >= (int)(sizeof(MapMask) * 8)) return ~(MapMask)0;
+  return ((MapMask)1 << n) - 1;
+}
+inline int mapLowestBit(MapMask m) {
+  return (sizeof(MapMask) > 4) ? __builtin_ctzll((unsigned long long)m) : __builtin_ctz((unsigned)m);
+}
+inline int mapHighestBit(MapMask m) {
+  return (sizeof(MapMask) > 4) ? 63 - __builtin_clzll((unsigned long long)m) : 31 - __builtin_clz((unsigned)m);
+}
+// Ray along one mask line starting at `pos`. The line holds `len` cells;
+// `forward` walks towards higher bit indices.
+inline int mapMaskRay(MapMask solid, MapMask breakable, int pos, int len, bool forward, int radius, bool *hitBreakable) {
+  MapMask blockers = solid | breakable;
+  int avail, dist;
+  if (forward) {
+    avail = min(radius, len - 1 - pos);
+    MapMask w = (blockers >> (pos + 1)) & mapLowMask(avail);
+    if (!w) return avail;
+    dist = mapLowestBit(w) + 1;
+  } else {
+    avail = min(radius, pos);
+    MapMask w = blockers & (mapLowMask(avail) << (pos - avail));
+    if (!w) return avail;
+    dist = pos - mapHighestBit(w);
   }
+  int hit = forward ? pos + dist : pos - dist;
+  if ((breakable >> hit) & 1) { *hitBreakable = true; return dist; }
+  return dist - 1;
 }
+#endif
 
-inline void explodeAt(int bx, int by, uint8_t ownerId) {
-  // bump global event id so damage is applied only once per explosion event
-  int ev = ++explosionEventCounter;
-  DBG_PRINTF("explodeAt: bx=%d by=%d ownerId=%u\n", bx, by, ownerId);
-  // center (force damage so players standing on the exploding bomb are affected)
-  addExplosionCell(bx, by, ownerId, true, ev);
-  // apply breakable destruction at center. Attribute points to ownerId via addScore hook when available.
-  if (mapData[by][bx] == TILE_BREAKABLE) {
-    mapData[by][bx] = TILE_EMPTY;
-    // Prefer the bomb's recorded owner if available (more robust than relying solely on ownerId)
-    uint8_t ownerToCredit = ownerId;
-    int matchedIdx = -1;
-    for (int bi = 0; bi < MAX_BOMBS; bi++) {
-      if (bombs[bi].x == bx && bombs[bi].y == by && bombs[bi].owner != (uint8_t)0xFF) {
-        ownerToCredit = bombs[bi].owner;
-        matchedIdx = bi;
-        break;
-      }
+inline void mapSetTile(int x, int y, Tile t) {
+  stateHash().region[stateHashRegionOf(y)] ^= zobristTile(x, y, mapData[y][x]) ^ zobristTile(x, y, t);
+  mapData[y][x] = t;
+  mapLayerUpdateTile(x, y);
+  markTileDirty(x, y);
+#ifdef MAP_BITBOARD
+  MapBits &mb = mapBits();
+  MapMask rowBit = (MapMask)1 << x, colBit = (MapMask)1 << y;
+  mb.solidRows[y] &= ~rowBit; mb.breakRows[y] &= ~rowBit;
+  mb.solidCols[x] &= ~colBit; mb.breakCols[x] &= ~colBit;
+  if (t == TILE_SOLID) { mb.solidRows[y] |= rowBit; mb.solidCols[x] |= colBit; }
+  else if (t == TILE_BREAKABLE) { mb.breakRows[y] |= rowBit; mb.breakCols[x] |= colBit; }
+#endif
+}
+
+inline bool mapIsWalkable(int x, int y) {
+  if (x < 0 || x >= MAP_COLS || y < 0 || y >= MAP_ROWS) return false;
+#ifdef MAP_BITBOARD
+  const MapBits &mb = mapBits();
+  return !(((mb.solidRows[y] | mb.breakRows[y]) >> x) & 1);
+#else
+  return mapData[y][x] == TILE_EMPTY;
+#endif
+}
+
+inline void mapRebuildMasks() {
+#ifdef MAP_BITBOARD
+  MapBits &mb = mapBits();
+  memset(&mb, 0, sizeof(MapBits));
+  for (int r = 0; r < MAP_ROWS; r++) {
+    for (int c = 0; c < MAP_COLS; c++) {
+      Tile t = mapData[r][c];
+      if (t == TILE_SOLID) { mb.solidRows[r] |= (MapMask)1 << c; mb.solidCols[c] |= (MapMask)1 << r; }
+      else if (t == TILE_BREAKABLE) { mb.breakRows[r] |= (MapMask)1 << c; mb.breakCols[c] |= (MapMask)1 << r; }
     }
-    DBG_PRINTF("explodeAt:center destroyed (%d,%d) ownerParam=%u ownerToCredit=%u matchedIdx=%d\n", bx, by, ownerId, ownerToCredit, matchedIdx);
-    // Only the authoritative device (the one that placed the bomb) should
-    // apply and broadcast score changes. If we have a matching bomb record
-    // and it belongs to us, apply/addScore and notify peer. Otherwise do
-    // not apply locally — the authoritative device will send a score update.
-    if (matchedIdx != -1 && bombs[matchedIdx].owner == myPlayerId) {
-      if ((void*)addScore != nullptr) addScore(ownerToCredit, 10);
-      else score += 10;
-      // notify peer
-      send_score_update(ownerToCredit, (int16_t)10, myPlayerId);
+  }
+#endif
+}
+
+inline void stateHashRebuildMap() {
+  StateHashGE &h = stateHash();
+  memset(h.region, 0, sizeof(h.region));
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS; c++) h.region[stateHashRegionOf(r)] ^= zobristTile(c, r, mapData[r][c]);
+}
+
+inline int blastRayLength(int bx, int by, int d, int radius, bool *hitBreakable) {
+  *hitBreakable = false;
+#ifdef MAP_BITBOARD
+  const MapBits &mb = mapBits();
+  if (d < 2) return mapMaskRay(mb.solidRows[by], mb.breakRows[by], bx, MAP_COLS, d == 0, radius, hitBreakable);
+  return mapMaskRay(mb.solidCols[bx], mb.breakCols[bx], by, MAP_ROWS, d == 2, radius, hitBreakable);
+#else
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+  for (int r = 1; r <= radius; r++) {
+    int nx = bx + dx[d]*r;
+    int ny = by + dy[d]*r;
+    if (nx < 0 || nx >= MAP_COLS || ny < 0 || ny >= MAP_ROWS) return r - 1;
+    if (mapData[ny][nx] == TILE_SOLID) return r - 1;
+    if (mapData[ny][nx] == TILE_BREAKABLE) { *hitBreakable = true; return r; }
+  }
+  return radius;
+#endif
+}
+
+inline void explosionBurn(int x, int y, unsigned long endAt) {
+  // a cell that is already burning just gets its end time extended
+  if (explosions.endAt[y][x] == 0) {
+    explosions.active[explosions.activeCount++] = (uint16_t)(y * MAP_COLS + x);
+    markTileDirty(x, y);
+  }
+  if ((long)(endAt - explosions.endAt[y][x]) > 0 || explosions.endAt[y][x] == 0) explosions.endAt[y][x] = endAt;
+  // cells burn for EXPLOSION_VIS_MS from now, so an already pending expiry
+  // event is still the earliest (a shorter one from a snapshot or a late
+  // remote blast just burns until that event)
+  if (!timers.explosionPending) {
+    timers.explosionPending = true;
+    timerPush(endAt + 1, TIMER_EXPLOSION_END, -1);
+  }
+}
+
+inline void addExplosionCell(int x, int y, uint8_t ownerId, bool forceDamage, int eventId) {
+  explosionBurn(x, y, gameMillis() + EXPLOSION_VIS_MS);
+  // delegate damage handling to the main sketch implementation so
+  // immunity rules (e.g., standing on own bomb) and game-over can be applied there
+  damagePlayerAt(x, y, ownerId, forceDamage, eventId);
+}
+
+inline void pruneExplosions(unsigned long now) {
+  timers.explosionPending = false;
+  unsigned long next = 0;
+  int i = 0;
+  while (i < explosions.activeCount) {
+    uint16_t cell = explosions.active[i];
+    unsigned long &endAt = explosions.endAt[cell / MAP_COLS][cell % MAP_COLS];
+    if (now > endAt) {
+      endAt = 0;
+      markTileDirty(cell % MAP_COLS, cell / MAP_COLS);
+      explosions.active[i] = explosions.active[--explosions.activeCount];
+    } else {
+      if (next == 0 || endAt < next) next = endAt;
+      i++;
     }
   }
+  if (explosions.activeCount > 0) {
+    timers.explosionPending = true;
+    timerPush(next + 1, TIMER_EXPLOSION_END, -1);
+  }
+}
+
+// Resolve everything triggered by a blast at (bx,by): every bomb inside a
+// blast is detonated in the same tick (breadth-first over the bomb index),
+// then all cells, tile destruction and damage are applied under one
+// explosionEventCounter event. `rootSlot` is the bomb at the origin (already
+// released), or -1. Returns the number of sources (>= 1).
+inline int resolveBlast(int bx, int by, uint8_t ownerId, int rootSlot) {
+  BlastSource src[MAX_BOMBS_LIMIT + 1];
+  int count = 0, head = 0;
+  src[count].x = (uint8_t)bx; src[count].y = (uint8_t)by;
+  src[count].owner = ownerId; src[count].slot = (int8_t)rootSlot;
+  count++;
   const int dx[4] = {1, -1, 0, 0};
   const int dy[4] = {0, 0, 1, -1};
-  for (int d = 0; d < 4; d++) {
-    for (int r = 1; r <= EXPLOSION_RADIUS; r++) {
-      int nx = bx + dx[d]*r;
-      int ny = by + dy[d]*r;
-      if (nx < 0 || nx >= MAP_COLS || ny < 0 || ny >= MAP_ROWS) break;
-      if (mapData[ny][nx] == TILE_SOLID) break;
-      // If it's a breakable tile, destroy it and stop propagation. Do this
-      // before creating the explosion cell to avoid any race where damage
-      // handlers modify mapData during the addExplosionCell call.
-      if (mapData[ny][nx] == TILE_BREAKABLE) {
-        mapData[ny][nx] = TILE_EMPTY;
-        // Prefer a bomb owner at that tile if present
-        uint8_t ownerToCredit = ownerId;
-        int matchedIdx = -1;
-        for (int bi = 0; bi < MAX_BOMBS; bi++) {
-          if (bombs[bi].x == nx && bombs[bi].y == ny && bombs[bi].owner != (uint8_t)0xFF) {
-            ownerToCredit = bombs[bi].owner;
-            matchedIdx = bi;
-            break;
-          }
-        }
-        DBG_PRINTF("explodeAt:prop destroyed (%d,%d) ownerParam=%u ownerToCredit=%u matchedIdx=%d\n", nx, ny, ownerId, ownerToCredit, matchedIdx);
-        // create the explosion visual and apply damage at this tile
-        addExplosionCell(nx, ny, ownerId, false, ev);
-        // Only the authoritative device applies and broadcasts the score.
-        if (matchedIdx != -1 && bombs[matchedIdx].owner == myPlayerId) {
-          if ((void*)addScore != nullptr) addScore(ownerToCredit, 10);
-          else score += 10;
-          send_score_update(ownerToCredit, (int16_t)10, myPlayerId);
+  // pass 1: walk the chain. A triggered bomb is released right away so the
+  // index no longer reports it (no duplicates) and its fuse event is dropped.
+  while (head < count) {
+    BlastSource &s = src[head++];
+    for (int d = -1; d < 4; d++) {
+      int len = 0;
+      if (d >= 0) {
+        // the ray stops before a solid tile or on (and including) a breakable one
+        bool hitBreakable = false;
+        len = blastRayLength(s.x, s.y, d, EXPLOSION_RADIUS, &hitBreakable);
+        s.len[d] = (uint8_t)len;
+        s.hitBreakable[d] = hitBreakable;
+        s.breakOwner[d] = 0xFF;
+      }
+      for (int r = (d < 0) ? 0 : 1; r <= len; r++) {
+        int nx = s.x + ((d < 0) ? 0 : dx[d] * r);
+        int ny = s.y + ((d < 0) ? 0 : dy[d] * r);
+        int j = bombAt(nx, ny);
+        if (j < 0) continue;
+        if (d >= 0 && s.hitBreakable[d] && r == len) s.breakOwner[d] = bombs[j].owner;
+        bombRelease(j);
+        BlastSource &t = src[count++];
+        t.x = bombs[j].x; t.y = bombs[j].y; t.owner = bombs[j].owner; t.slot = (int8_t)j;
+      }
+    }
+  }
+  // pass 2: apply. Damage handlers see a single event id for the whole chain.
+  int ev = ++explosionEventCounter;
+  int destroyed = 0, points = 0, peerPoints = 0;
+  for (int k = 0; k < count; k++) {
+    const BlastSource &s = src[k];
+    DBG_PRINTF("resolveBlast: src %d (%d,%d) owner=%u slot=%d\n", k, s.x, s.y, s.owner, s.slot);
+    // center (force damage so players standing on the exploding bomb are affected)
+    addExplosionCell(s.x, s.y, s.owner, true, ev);
+    if (mapTileAt(s.x, s.y) == TILE_BREAKABLE) {
+      mapSetTile(s.x, s.y, TILE_EMPTY);
+      destroyed++;
+      // Only the authoritative device (the one that placed the bomb) applies
+      // and broadcasts score changes; the peer gets a score update from it.
+      // In lockstep each device scores both players itself.
+      if (s.owner != (uint8_t)0xFF && s.owner == myPlayerId) points += 10;
+      else if (s.owner != (uint8_t)0xFF && gameLockstep()) peerPoints += 10;
+    }
+    for (int d = 0; d < 4; d++) {
+      for (int r = 1; r <= s.len[d]; r++) {
+        int nx = s.x + dx[d]*r;
+        int ny = s.y + dy[d]*r;
+        // Destroy the breakable before creating the explosion cell so damage
+        // handlers never see a half-updated tile. Two sources can end on the
+        // same breakable; only the first one destroys (and scores) it.
+        if (s.hitBreakable[d] && r == s.len[d] && mapTileAt(nx, ny) == TILE_BREAKABLE) {
+          mapSetTile(nx, ny, TILE_EMPTY);
+          destroyed++;
+          if (s.breakOwner[d] != (uint8_t)0xFF && s.breakOwner[d] == myPlayerId) points += 10;
+          else if (s.breakOwner[d] != (uint8_t)0xFF && gameLockstep()) peerPoints += 10;
         }
-        break;
-      } else {
-        // empty tile or temporary explosion passage: create explosion cell
-        addExplosionCell(nx, ny, ownerId, false, ev);
+        addExplosionCell(nx, ny, s.owner, false, ev);
       }
     }
   }
+  if (points != 0) {
+    if ((void*)addScore != nullptr) addScore(myPlayerId, points);
+    else score += points;
+    // notify peer once for the whole chain
+    if (!gameLockstep()) send_score_update(myPlayerId, (int16_t)points, myPlayerId);
+  }
+  if (peerPoints != 0 && (void*)addScore != nullptr) addScore(myPlayerId ? 0 : 1, peerPoints);
+  if ((void*)on_local_blast_resolved != nullptr && rootSlot >= 0) {
+    BlastResult r = { ev, src, count, destroyed, points };
+    on_local_blast_resolved(r);
+  }
+  return count;
+}
+
+inline void explodeAt(int bx, int by, uint8_t ownerId) {
+  DBG_PRINTF("explodeAt: bx=%d by=%d ownerId=%u\n", bx, by, ownerId);
+  resolveBlast(bx, by, ownerId, -1);
 }
 
 inline void updateBombs() {
-  unsigned long now = millis();
-  for (int i = 0; i < MAX_BOMBS; i++) {
-    if (!bombs[i].active) continue;
-    if (now - bombs[i].placedAt >= bombs[i].fuseMs) {
-      // mark the bomb inactive before exploding so any damage handlers
-      // don't see the bomb as still 'present' on that tile
-      bombs[i].active = false;
-      bombs[i].placedAt = 0;
-      // notify sketch (weak hook) that a local bomb exploded so it can send network messages
-      if ((void*)on_local_bomb_exploded != nullptr) on_local_bomb_exploded(bombs[i].x, bombs[i].y, i);
-      // pass owner so scoring can be attributed correctly
-      explodeAt(bombs[i].x, bombs[i].y, bombs[i].owner);
+  unsigned long now = gameMillis();
+  TimerEvent ev;
+  while (timerPopDue(now, &ev)) {
+    if (ev.kind == TIMER_EXPLOSION_END) {
+      pruneExplosions(now);
+      continue;
     }
+    int i = ev.slot;
+    // mark the bomb inactive before exploding so the chain resolver and any
+    // damage handlers don't see it as still 'present' on that tile (its fuse
+    // event is already off the heap, so only the slot is freed)
+    bombReleaseSlot(i);
+    resolveBlast(bombs[i].x, bombs[i].y, bombs[i].owner, i);
   }
 }
 
-inline void placeBombAtPlayer() {
-  for (int i = 0; i < MAX_BOMBS; i++) {
-    if (bombs[i].active && bombs[i].x == playerX && bombs[i].y == playerY) return;
+// a fires before b: earlier time first (wrap-safe), then insertion order
+inline bool timerBefore(const TimerEvent &a, const TimerEvent &b) {
+  long d = (long)(a.at - b.at);
+  return d < 0 || (d == 0 && (int32_t)(a.seq - b.seq) < 0);
+}
+
+inline void timerSiftUp(int i) {
+  TimerEvent e = timerHeap[i];
+  while (i > 0) {
+    int parent = (i - 1) / 2;
+    if (!timerBefore(e, timerHeap[parent])) break;
+    timerHeap[i] = timerHeap[parent];
+    i = parent;
   }
+  timerHeap[i] = e;
+}
+
+inline void timerSiftDown(int i) {
+  TimerEvent e = timerHeap[i];
+  for (;;) {
+    int child = 2 * i + 1;
+    if (child >= timers.count) break;
+    if (child + 1 < timers.count && timerBefore(timerHeap[child + 1], timerHeap[child])) child++;
+    if (!timerBefore(timerHeap[child], e)) break;
+    timerHeap[i] = timerHeap[child];
+    i = child;
+  }
+  timerHeap[i] = e;
+}
+
+inline void timerPush(unsigned long at, uint8_t kind, int slot) {
+  if (timers.count >= MAX_BOMBS + 1) return; // cannot happen with one event per bomb + one expiry
+  TimerEvent &e = timerHeap[timers.count];
+  e.at = at;
+  e.seq = timers.seq++;
+  e.kind = kind;
+  e.slot = (int8_t)slot;
+  timerSiftUp(timers.count++);
+}
+
+inline void timerRemoveAt(int i) {
+  timers.count--;
+  if (i == timers.count) return;
+  timerHeap[i] = timerHeap[timers.count];
+  timerSiftUp(i);
+  timerSiftDown(i);
+}
+
+inline bool timerPopDue(unsigned long now, TimerEvent *out) {
+  if (timers.count == 0 || (long)(now - timerHeap[0].at) < 0) return false;
+  *out = timerHeap[0];
+  timerRemoveAt(0);
+  return true;
+}
+
+// Only used when a bomb is removed before its fuse runs out; the heap is
+// at most MAX_BOMBS + 1 entries so a linear search is fine.
+inline void timerCancel(uint8_t kind, int slot) {
+  for (int i = 0; i < timers.count; i++) {
+    if (timerHeap[i].kind == kind && timerHeap[i].slot == slot) { timerRemoveAt(i); return; }
+  }
+}
+
+inline void timerReset() {
+  timers.count = 0;
+  timers.seq = 0;
+  timers.explosionPending = false;
+}
+
+inline long msUntilNextTimer(unsigned long now) {
+  if (timers.count == 0) return -1;
+  long d = (long)(timerHeap[0].at - now);
+  return d > 0 ? d : 0;
+}
+
+inline int bombAt(int x, int y) {
+  if (x < 0 || x >= MAP_COLS || y < 0 || y >= MAP_ROWS) return -1;
+  return bombIndex.at[y][x];
+}
+
+inline int bombSpawn(int x, int y, unsigned long placedAt, unsigned long fuseMs, uint8_t owner) {
+  if (x < 0 || x >= MAP_COLS || y < 0 || y >= MAP_ROWS) return -1;
+  if (bombIndex.at[y][x] != -1 || bombIndex.freeMask == 0) return -1;
+  // lowest free slot first, same order as the old linear scan
+  int i = __builtin_ctz(bombIndex.freeMask);
+  bombIndex.freeMask &= ~(1UL << i);
+  bombs[i].active = true;
+  bombs[i].x = x;
+  bombs[i].y = y;
+  bombs[i].placedAt = placedAt;
+  bombs[i].fuseMs = fuseMs;
+  bombs[i].owner = owner;
+  stateHash().bombs ^= zobristBomb(x, y, owner);
+  bombIndex.at[y][x] = (int8_t)i;
+  markTileDirty(x, y);
+  timerPush(placedAt + fuseMs, TIMER_BOMB_FUSE, i);
+  return i;
+}
+
+// Frees the slot without touching the timer queue (the fuse event has
+// already been popped); x/y/owner are kept so callers can still read them.
+inline void bombReleaseSlot(int i) {
+  if (!bombs[i].active) return;
+  bombs[i].active = false;
+  bombs[i].placedAt = 0;
+  stateHash().bombs ^= zobristBomb(bombs[i].x, bombs[i].y, bombs[i].owner);
+  if (bombIndex.at[bombs[i].y][bombs[i].x] == i) bombIndex.at[bombs[i].y][bombs[i].x] = -1;
+  markTileDirty(bombs[i].x, bombs[i].y);
+  bombIndex.freeMask |= (1UL << i);
+  remoteBombSlotGone(i);
+}
+
+// Removes a bomb before its fuse runs out.
+inline void bombRelease(int i) {
+  if (!bombs[i].active) return;
+  timerCancel(TIMER_BOMB_FUSE, i);
+  bombReleaseSlot(i);
+}
+
+inline void bombResetAll() {
+  memset(bombIndex.at, -1, sizeof(bombIndex.at));
+  bombIndex.freeMask = (MAX_BOMBS >= MAX_BOMBS_LIMIT) ? 0xFFFFFFFFUL : ((1UL << MAX_BOMBS) - 1);
   for (int i = 0; i < MAX_BOMBS; i++) {
-    if (!bombs[i].active) {
-      bombs[i].active = true;
-      bombs[i].x = playerX;
-      bombs[i].y = playerY;
-      bombs[i].placedAt = millis();
-      bombs[i].fuseMs = BOMB_FUSE;
-      // attribute this bomb to the local player if available
-      bombs[i].owner = (uint8_t)0xFF;
-      if ((void*)&myPlayerId != nullptr) bombs[i].owner = myPlayerId;
-      return;
+    bombs[i].active = false;
+    bombs[i].placedAt = 0;
+    bombs[i].x = 0; bombs[i].y = 0; bombs[i].fuseMs = 0;
+    bombs[i].owner = 0xFF;
+    bombs[i].netId = 0;
+  }
+  stateHash().bombs = 0;
+  remoteBombReset();
+}
+
+inline int bombFreeCount() { return __builtin_popcount(bombIndex.freeMask); }
+
+inline int placeBombAtPlayer() {
+  // attribute this bomb to the local player
+  int i = bombSpawn(playerX, playerY, gameMillis(), BOMB_FUSE, myPlayerId);
+  if (i >= 0) bombs[i].netId = ++bombIndex.lastNetId;
+  return i;
+}
+
+inline int remoteBombFind(uint8_t owner, uint16_t id) {
+  for (int i = 0; i < REMOTE_BOMB_ENTRIES; i++) {
+    const RemoteBombEntry &e = remoteBombs.e[i];
+    if (e.state != RB_FREE && e.owner == owner && e.id == id) return i;
+  }
+  return -1;
+}
+
+// A free entry, else the finished one that went off longest ago.
+inline int remoteBombAlloc(uint8_t owner, uint16_t id) {
+  int pick = -1;
+  for (int i = 0; i < REMOTE_BOMB_ENTRIES; i++) {
+    const RemoteBombEntry &e = remoteBombs.e[i];
+    if (e.state == RB_FREE) { pick = i; break; }
+    if (e.state == RB_DONE && (pick < 0 || (long)(e.doneAt - remoteBombs.e[pick].doneAt) < 0)) pick = i;
+  }
+  if (pick < 0) return -1;
+  RemoteBombEntry &e = remoteBombs.e[pick];
+  e.owner = owner;
+  e.id = id;
+  e.slot = -1;
+  return pick;
+}
+
+inline void remoteBombMarkDone(int i) {
+  remoteBombs.e[i].state = RB_DONE;
+  remoteBombs.e[i].slot = -1;
+  remoteBombs.e[i].doneAt = gameMillis();
+}
+
+inline RemoteBombResult remoteBombPlace(uint8_t owner, uint16_t id, int x, int y, unsigned long placedAt, unsigned long fuseMs) {
+  int k = remoteBombFind(owner, id);
+  if (k >= 0 && remoteBombs.e[k].state == RB_DONE) { remoteBombs.duplicatePlaces++; return RB_IGNORED; }
+  if (k >= 0) {
+    // every copy's estimate is late by its own transit time: keep the earliest
+    int slot = remoteBombs.e[k].slot;
+    remoteBombs.duplicatePlaces++;
+    if ((long)(placedAt - bombs[slot].placedAt) < 0) {
+      bombs[slot].placedAt = placedAt;
+      timerCancel(TIMER_BOMB_FUSE, slot);
+      timerPush(placedAt + bombs[slot].fuseMs, TIMER_BOMB_FUSE, slot);
+      remoteBombs.refined++;
     }
+    return RB_REFINED;
+  }
+  int slot = bombSpawn(x, y, placedAt, fuseMs, owner);
+  if (slot < 0) return RB_REJECTED;
+  bombs[slot].netId = id;
+  k = remoteBombAlloc(owner, id);
+  if (k >= 0) {
+    remoteBombs.e[k].state = RB_LIVE;
+    remoteBombs.e[k].slot = (int8_t)slot;
+  }
+  remoteBombs.spawned++;
+  return RB_SPAWNED;
+}
+
+// `lateMs`: the bomb went off that long ago on the owner's side (known with
+// a shared clock, clock_sync.h). The cells burn until they do there, at most
+// EXPLOSION_VIS_MS back.
+inline bool remoteBombExplode(uint8_t owner, uint16_t id, int x, int y, unsigned long lateMs) {
+  int k = remoteBombFind(owner, id);
+  if (k >= 0 && remoteBombs.e[k].state == RB_DONE) { remoteBombs.duplicateExplodes++; return false; }
+  if (!gameClock().fixed) gameClock().behind = lateMs < EXPLOSION_VIS_MS ? lateMs : EXPLOSION_VIS_MS;
+  if (k >= 0) {
+    // detonate our copy (and anything it chains into); the release marks it done
+    int slot = remoteBombs.e[k].slot;
+    bombRelease(slot);
+    resolveBlast(bombs[slot].x, bombs[slot].y, bombs[slot].owner, -1);
+  } else {
+    // the placement never arrived: blast the location and remember it
+    k = remoteBombAlloc(owner, id);
+    if (k >= 0) remoteBombMarkDone(k);
+    explodeAt(x, y, owner);
   }
+  gameClock().behind = 0;
+  return true;
+}
+
+// bombs[slot] went away (fuse, chain or explode message).
+inline void remoteBombSlotGone(int slot) {
+  for (int i = 0; i < REMOTE_BOMB_ENTRIES; i++) {
+    if (remoteBombs.e[i].state == RB_LIVE && remoteBombs.e[i].slot == slot) { remoteBombMarkDone(i); return; }
+  }
+}
+
+inline void remoteBombReset() {
+  memset(remoteBombs.e, 0, sizeof(remoteBombs.e));
 }
 
 inline void generateMap() {
@@ -250,33 +839,124 @@ inline void generateMap() {
   clearIfInBounds(MAP_ROWS-2,1); clearIfInBounds(MAP_ROWS-2,2); clearIfInBounds(MAP_ROWS-3,1); clearIfInBounds(MAP_ROWS-3,2);
   // bottom-right
   clearIfInBounds(MAP_ROWS-2, MAP_COLS-2); clearIfInBounds(MAP_ROWS-2, MAP_COLS-3); clearIfInBounds(MAP_ROWS-3, MAP_COLS-2); clearIfInBounds(MAP_ROWS-3, MAP_COLS-3);
+  // mapData was written directly above; bring the bitboard masks up to date
+  mapRebuildMasks();
+  stateHashRebuildMap();
+  mapLayerRebuild();
+  markAllTilesDirty();
 }
 
-inline void renderBombsAndExplosions(Adafruit_SH1107 &disp, int xPixelOffset) {
+inline void renderBombsAndExplosions(PartialSH1107 &disp, int xPixelOffset) {
+  const SpriteSet &spr = pageSprites();
+  uint8_t *fb = disp.frameBuffer();
+  int fbW = disp.width(), fbH = disp.height();
   for (int i = 0; i < MAX_BOMBS; i++) {
     if (!bombs[i].active) continue;
-  int bombPixelX = bombs[i].x * TILE_SIZE;
-  int bombPixelY = bombs[i].y * TILE_SIZE + HUD_HEIGHT;
+    int bombPixelX = bombs[i].x * TILE_SIZE;
+    int bombPixelY = bombs[i].y * TILE_SIZE + HUD_HEIGHT;
     if (bombPixelX >= xPixelOffset && bombPixelX < xPixelOffset + 128) {
-      int px = bombPixelX - xPixelOffset + 1;
-      int py = bombPixelY + 1;
-      disp.drawBitmap(px, py, SPRITE_BOMB_6x6, 6, 6, 1);
+      blitSprite(fb, fbW, fbH, spr.bomb, bombPixelX - xPixelOffset + 1, bombPixelY + 1);
     }
   }
-  unsigned long now = millis();
-  for (int i = 0; i < MAX_EXPLOSION_CELLS; i++) {
-    if (explosions[i].endAt == 0) continue;
-    if (now > explosions[i].endAt) continue;
-  int ex = explosions[i].x * TILE_SIZE;
-  int ey = explosions[i].y * TILE_SIZE + HUD_HEIGHT;
+  unsigned long now = gameMillis();
+  for (int i = 0; i < explosions.activeCount; i++) {
+    int cell = explosions.active[i];
+    int cx = cell % MAP_COLS, cy = cell / MAP_COLS;
+    if (now > explosions.endAt[cy][cx]) continue;
+    int ex = cx * TILE_SIZE;
+    int ey = cy * TILE_SIZE + HUD_HEIGHT;
     if (ex >= xPixelOffset && ex < xPixelOffset + 128) {
-      int px = ex - xPixelOffset;
-      int py = ey;
-      disp.drawBitmap(px, py, SPRITE_EXPLODE_8x8, 8, 8, 1);
+      blitSprite(fb, fbW, fbH, spr.explode, ex - xPixelOffset, ey);
     }
   }
 }
 
+inline void markTileDirty(int x, int y) {
+  if (x < 0 || x >= MAP_COLS || y < 0 || y >= MAP_ROWS) return;
+  uint8_t &b = dirtyTiles.bits[y][x >> 3];
+  uint8_t bit = (uint8_t)(1 << (x & 7));
+  if (!(b & bit)) { b |= bit; dirtyTiles.count++; }
+}
+
+inline void markAllTilesDirty() {
+  memset(dirtyTiles.bits, 0, sizeof(dirtyTiles.bits));
+  for (int r = 0; r < MAP_ROWS; r++) for (int c = 0; c < MAP_COLS; c++) dirtyTiles.bits[r][c >> 3] |= (uint8_t)(1 << (c & 7));
+  dirtyTiles.count = MAP_ROWS * MAP_COLS;
+  // the framebuffer holds something else (menu, countdown): repaint everything
+  dirtyTiles.drawnOffset = -1;
+}
+
+// Tiles covered by a player sprite drawn at map pixel (x, y).
+inline int spriteTileLo(int p) { return (p + 1) / TILE_SIZE; }
+inline int spriteTileHi(int p) { return (p + TILE_SIZE - 2) / TILE_SIZE; }
+
+inline void markSpriteDirty(int x, int y) {
+  if (x < 0 || y < 0) return;
+  for (int r = spriteTileLo(y); r <= spriteTileHi(y); r++)
+    for (int c = spriteTileLo(x); c <= spriteTileHi(x); c++) markTileDirty(c, r);
+}
+
+inline void renderDirtyTiles(PartialSH1107 &disp, int xPixelOffset) {
+  // Players are plain globals moved all over the sketch, so their changes
+  // are picked up here by comparing with what was drawn last time.
+  unsigned long now = gameMillis();
+  bool spawnInvul = (now < spawnInvulEnd);
+  bool showLocal = !spawnInvul || ((now / 200) % 2 == 0); // flash while invulnerable
+  int px = showLocal ? playerX : -1, py = showLocal ? playerY : -1;
+  // the remote player may be between tiles (remote_player.h)
+  int ox = -1, oy = -1;
+  if (otherPlayerVisible) {
+    ox = otherPlayerX * TILE_SIZE + remoteDraw().dx;
+    oy = otherPlayerY * TILE_SIZE + remoteDraw().dy;
+  }
+  uint8_t *fb = disp.frameBuffer();
+  int fbWidth = disp.width(), fbHeight = disp.height();
+  bool full = (xPixelOffset != dirtyTiles.drawnOffset);
+  if (full) {
+    // new viewport or the framebuffer was used for something else
+    markAllTilesDirty();
+    disp.markAllDirty();
+    if (fb) mapLayerBlitView(fb, fbWidth, fbHeight, xPixelOffset);
+  }
+  if (px != dirtyTiles.drawnPX || py != dirtyTiles.drawnPY) {
+    markTileDirty(dirtyTiles.drawnPX, dirtyTiles.drawnPY);
+    markTileDirty(px, py);
+  }
+  if (ox != dirtyTiles.drawnOX || oy != dirtyTiles.drawnOY) {
+    markSpriteDirty(dirtyTiles.drawnOX, dirtyTiles.drawnOY);
+    markSpriteDirty(ox, oy);
+  }
+  dirtyTiles.drawnOffset = xPixelOffset;
+  dirtyTiles.drawnPX = px; dirtyTiles.drawnPY = py;
+  dirtyTiles.drawnOX = ox; dirtyTiles.drawnOY = oy;
+  if (dirtyTiles.count == 0) return;
+
+  if (!fb) return;
+  const SpriteSet &spr = pageSprites();
+  int leftTile = xPixelOffset / TILE_SIZE;
+  int xWithin = xPixelOffset % TILE_SIZE;
+  int tilesWide = 128 / TILE_SIZE + 1; // include partial tile
+  for (int ry = 0; ry < MAP_ROWS; ry++) {
+    for (int tx = 0; tx < tilesWide; tx++) {
+      int c = leftTile + tx;
+      if (c < 0 || c >= MAP_COLS) continue;
+      if (!(dirtyTiles.bits[ry][c >> 3] & (1 << (c & 7)))) continue;
+      int sx = tx * TILE_SIZE - xWithin;
+      int sy = ry * TILE_SIZE + HUD_HEIGHT;
+      // same layering as a full redraw: map background, players, bomb, explosion
+      if (!full) mapLayerBlitTile(fb, fbWidth, fbHeight, c, ry, sx, sy);
+      if (c == px && ry == py) blitSprite(fb, fbWidth, fbHeight, spr.player, sx + 1, sy + 1);
+      if (ox >= 0 && c >= spriteTileLo(ox) && c <= spriteTileHi(ox) && ry >= spriteTileLo(oy) && ry <= spriteTileHi(oy))
+        blitSprite(fb, fbWidth, fbHeight, spr.player, sx + ox - c * TILE_SIZE + 1, sy + oy - ry * TILE_SIZE + 1);
+      if (bombAt(c, ry) >= 0) blitSprite(fb, fbWidth, fbHeight, spr.bomb, sx + 1, sy + 1);
+      if (isExplosionAt(c, ry)) blitSprite(fb, fbWidth, fbHeight, spr.explode, sx, sy);
+      disp.markDirty(sx, sy, TILE_SIZE, TILE_SIZE);
+    }
+  }
+  memset(dirtyTiles.bits, 0, sizeof(dirtyTiles.bits));
+  dirtyTiles.count = 0;
+}
+
 inline void drawTile(Adafruit_SH1107 &disp, int px, int py, Tile t) {
   switch (t) {
     case TILE_EMPTY: break;
@@ -308,16 +988,10 @@ inline void initializeGame() {
   playerX = 1; playerY = 1; playerHealth = 1;
   // Clear any leftover bombs/explosions from previous rounds or menu actions so
   // a stale bomb does not immediately explode when the game starts.
-  for (int i = 0; i < MAX_BOMBS; i++) {
-    bombs[i].active = false;
-    bombs[i].placedAt = 0;
-    bombs[i].x = 0; bombs[i].y = 0; bombs[i].fuseMs = 0;
-    bombs[i].owner = 0xFF;
-  }
-  for (int i = 0; i < MAX_EXPLOSION_CELLS; i++) {
-    explosions[i].endAt = 0;
-    explosions[i].x = 0; explosions[i].y = 0;
-  }
+  timerReset();
+  bombResetAll();
+  memset(explosions.endAt, 0, sizeof(explosions.endAt));
+  explosions.activeCount = 0;
   // reset explosion event counter so event ids start fresh for this round
   explosionEventCounter = 0;
   // reset score and lives for a new game
@@ -331,17 +1005,13 @@ inline void initializeGame() {
 inline void randomizeMap() { randomSeed(analogRead(A0) ^ millis()); generateMap(); }
 
 inline bool isExplosionAt(int tx, int ty) {
-  unsigned long now = millis();
-  for (int i = 0; i < MAX_EXPLOSION_CELLS; i++) {
-    if (explosions[i].endAt == 0) continue;
-    if (now > explosions[i].endAt) continue;
-    if (explosions[i].x == tx && explosions[i].y == ty) return true;
-  }
-  return false;
+  if (tx < 0 || tx >= MAP_COLS || ty < 0 || ty >= MAP_ROWS) return false;
+  unsigned long endAt = explosions.endAt[ty][tx];
+  return endAt != 0 && gameMillis() <= endAt;
 }
 
 inline void checkPlayerHit() {
-  unsigned long now = millis();
+  unsigned long now = gameMillis();
   // legacy per-hit invul check (kept but non-essential)
   if (now - lastPlayerHitAt < PLAYER_INVUL_MS) return;
   if (isExplosionAt(playerX, playerY)) {
@@ -351,7 +1021,7 @@ inline void checkPlayerHit() {
     if (lives > 0) {
       playerHealth = 1;
       playerX = spawnX; playerY = spawnY;
-      spawnInvulEnd = millis() + SPAWN_INVUL_MS;
+      spawnInvulEnd = now + SPAWN_INVUL_MS;
     } else {
       // out of lives -> game over
       // set player to spawn and leave game over handling to main loop
@@ -0,0 +1,406 @@
+#pragma once
+
+// lockstep.h - fixed-tick deterministic simulation of both players
+//
+// Include after game_engine.h. In this mode both devices step the same
+// engine at LOCKSTEP_HZ from the inputs of both players. Normally each
+// device runs its own player on millis() and mirrors the peer from MSG_POS,
+// MSG_BOMB_PLACE and MSG_BOMB_EXPLODE. Call lockstep_begin() when a round
+// starts, lockstep_set_input() with the buttons as they are polled, and
+// lockstep_poll() from loop() in place of updateBombs(). Hand MSG_INPUT to
+// lockstep_on_input() and blast cells to lockstep_on_blast_cell(), and end
+// the round when lockstep_round_result() says so.
+//
+// Tick T:
+//   - before it is stepped, our buttons are sampled as our input for tick
+//     T + LOCKSTEP_INPUT_DELAY and sent in MSG_INPUT (clientTick = that tick)
+//   - it is stepped once the peer's input for T is in, with gameMillis()
+//     pinned to the tick's time
+//   - a step applies player 0's input, then player 1's: a move when the
+//     flags change and every LOCKSTEP_MOVE_REPEAT_TICKS while held, a bomb
+//     on a press. Then it runs updateBombs().
+// Both sides then place the same bombs at the same engine time and blast
+// the same cells, so fuses need no age field and there are no stale
+// placements. Blasts score for both players and both sides apply both
+// players' hits and deaths, so no score, death or GAME_END message is sent.
+//
+// MSG_INPUT is unreliable, so each one repeats our inputs from the oldest
+// tick the peer may still be missing: the peer acks the tick before which
+// it holds all of ours. A tick whose peer input is missing waits (a stall).
+// After LOCKSTEP_PEER_TIMEOUT_MS without input the round goes on alone.
+//
+// With rollback (lockstep_begin(..., true)) our input applies to the very
+// next tick, and a tick whose peer input is missing is stepped on a guess:
+// the peer still holds the buttons of its last input. The state before
+// each guessed tick is saved (rollback.h). When the real input comes in
+// and differs from the guess, the save before that tick is restored and
+// the ticks up to the current one are stepped again. At most
+// ROLLBACK_MAX_TICKS ticks run ahead of the peer's last input; past that
+// the next tick waits as above. The round ends only once the tick that
+// decided it can no longer be rolled back.
+// A device that rejoins a running round is not caught up in this mode.
+//
+// Only the ticks change the round. The two sides step their ticks at
+// different times, so state_sync.h's digests would differ on nothing but
+// timing. The sketch sends and compares none while lockstep is active, asks
+// for no catch-up snapshot (state_snapshot.h), and drops the band and score
+// resyncs and snapshot fragments lockstep_drops_snapshot() names. Applied
+// outside a tick, and outside the saved frames of rollback.h, they would
+// make a real desync.
+
+#include "espnow_game.h"
+#include "rollback.h"
+#include "state_sync.h"
+#include "state_snapshot.h"
+
+extern int lastDamageEvent;
+extern long score_local;
+extern long score_remote;
+
+const unsigned long LOCKSTEP_HZ = 60;
+const uint32_t LOCKSTEP_INPUT_DELAY = 3;          // ticks (50 ms), without rollback
+const int LOCKSTEP_WINDOW = 64;                   // inputs kept per player
+const uint32_t LOCKSTEP_MAX_HISTORY = 32;         // earlier inputs per MSG_INPUT
+const uint32_t LOCKSTEP_MOVE_REPEAT_TICKS = 9;    // 150 ms, the sketch's MOVE_REPEAT_MS
+const int LOCKSTEP_MAX_CATCHUP = 4;               // ticks stepped per poll when behind
+const unsigned long LOCKSTEP_PEER_TIMEOUT_MS = 3000;
+const uint32_t ROLLBACK_MAX_TICKS = 12;           // guessed ticks ahead of the peer (200 ms)
+const int ROLLBACK_FRAMES = 16;                   // saves kept (> ROLLBACK_MAX_TICKS)
+
+struct LockstepStats {
+  unsigned long ticks;          // stepped (not counting steps again after a rollback)
+  unsigned long stalls;         // times the next tick waited for the peer's input
+  unsigned long stallMs;        // time spent waiting
+  unsigned long maxBehind;      // most ticks the simulation was behind the clock
+  unsigned long inputsSent;     // MSG_INPUT messages
+  unsigned long inputBytes;     // input bytes in them (newest + history)
+  unsigned long inputsReceived;
+  unsigned long peerHits;       // blasts that hit the peer's player
+  unsigned long peerLost;       // rounds that went on alone
+  unsigned long guessed;        // ticks stepped on a guessed peer input
+  unsigned long rollbacks;      // wrong guesses rolled back
+  unsigned long resimTicks;     // ticks stepped again after them
+  unsigned long maxRollback;    // most ticks rolled back at once
+};
+
+// What a step changes besides the engine's state; saved along with it.
+struct LockstepSim {
+  uint8_t prevFlags[2];
+  uint32_t lastMoveTick[2];
+  unsigned long peerInvulEnd;   // the peer's spawnInvulEnd / lastDamageEvent / lives
+  int peerLastEvent;
+  int8_t peerLives;
+  uint8_t outMask;              // bit p: player p has no lives left
+  int outEvent;                 // the explosion event that did it
+  uint32_t outTick;
+};
+
+struct LockstepFrame {
+  uint32_t tick;                // the state before stepping this tick
+  bool ok;
+  LockstepSim sim;
+  RollbackState engine;
+};
+
+struct Lockstep {
+  bool active;
+  bool solo;                    // no peer: only our player is stepped
+  bool stalled;
+  bool rollback;
+  uint8_t myId;
+  uint32_t delay;               // ticks from sampling our buttons to stepping them
+  unsigned long startedAt;      // millis() at tick 0
+  unsigned long lastPollAt, lastSentAt, lastRemoteAt;
+  uint32_t tick;                // next tick to step
+  uint32_t localNext;           // first tick without our input
+  uint32_t peerHas;             // the peer holds our inputs for the ticks before this
+  uint32_t remoteNext;          // we hold the peer's inputs for the ticks before this
+  uint32_t verified;            // ticks before this were stepped on the peer's real input
+  uint8_t sampled;              // buttons as last polled
+  uint8_t local[LOCKSTEP_WINDOW];
+  uint8_t remote[LOCKSTEP_WINDOW];
+  uint32_t remoteTag[LOCKSTEP_WINDOW];  // tick + 1 whose input remote[] holds (0 = none)
+  uint8_t stepped[LOCKSTEP_WINDOW];     // the peer input each tick was stepped on
+  LockstepSim sim;
+  LockstepStats stats;
+};
+
+inline Lockstep &lockstep() { static Lockstep s = {}; return s; }
+// kept apart so Lockstep stays cheap to reset
+inline LockstepFrame *lockstep_frames() { static LockstepFrame f[ROLLBACK_FRAMES]; return f; }
+
+// engine time of tick t (never 0, the engine's "not set" value)
+inline unsigned long lockstep_tick_ms(uint32_t t) { return 1 + (unsigned long)((uint64_t)t * 1000 / LOCKSTEP_HZ); }
+
+inline void lockstep_peer_spawn(uint8_t peerId, int &x, int &y) {
+  if (peerId == 0) { x = 1; y = 1; }
+  else { x = MAP_COLS - 2; y = MAP_ROWS - 2; }
+}
+
+// Start of a round (counters are kept). The players are in their corners.
+// Rollback needs MAX_BOMBS <= ROLLBACK_MAX_BOMBS.
+inline void lockstep_begin(unsigned long now, uint8_t myId, bool solo, bool rollback = false) {
+  Lockstep &s = lockstep();
+  LockstepStats stats = s.stats;
+  s = Lockstep();
+  s.stats = stats;
+  s.active = true;
+  s.solo = solo;
+  s.rollback = rollback && MAX_BOMBS <= ROLLBACK_MAX_BOMBS;
+  s.delay = s.rollback ? 0 : LOCKSTEP_INPUT_DELAY;
+  s.myId = myId;
+  s.startedAt = now;
+  s.lastPollAt = s.lastSentAt = s.lastRemoteAt = now;
+  gameClock().fixed = true;
+  gameClock().now = lockstep_tick_ms(0);
+  // spawn protection in engine time, the same on both sides
+  spawnInvulEnd = gameClock().now + SPAWN_INVUL_MS;
+  lastDamageEvent = 0;
+  // bomb ids count from the same place on both sides
+  bombIndex.lastNetId = 0;
+  s.sim.peerInvulEnd = spawnInvulEnd;
+  s.sim.peerLives = (int8_t)lives;
+  if (!solo) {
+    lockstep_peer_spawn(myId ? 0 : 1, otherPlayerX, otherPlayerY);
+    otherPlayerVisible = true;
+  }
+}
+
+inline void lockstep_end() {
+  lockstep().active = false;
+  gameClock().fixed = false;
+}
+
+// bit0 up, bit1 down, bit2 left, bit3 right, bit4 bomb
+inline void lockstep_set_input(uint8_t flags) { lockstep().sampled = flags & 0x1F; }
+
+// MSG_STATE_SNAPSHOT payloads that must not touch a lockstep round.
+inline bool lockstep_drops_snapshot(const uint8_t *data, int len) {
+  if (!lockstep().active || len < 1) return false;
+  return data[0] == SNAPSHOT_MAP_BAND || data[0] == SNAPSHOT_SCORES || data[0] == SNAPSHOT_FRAGMENT;
+}
+
+// MSG_INPUT while a lockstep round runs; returns false otherwise.
+inline bool lockstep_on_input(const MsgInput *m) {
+  Lockstep &s = lockstep();
+  if (!s.active) return false;
+  s.stats.inputsReceived++;
+  s.lastRemoteAt = millis();
+  // the parser has checked that the history bytes and the ack are there
+  const uint8_t *older = (const uint8_t *)(m + 1);
+  int history = input_history(m);
+  if (m->history & INPUT_HAS_ACK) {
+    uint32_t ack;
+    memcpy(&ack, older + history, 4);
+    if (ack > s.peerHas) s.peerHas = ack;
+  }
+  // ring slots from the oldest input a step or a rollback may still read
+  uint32_t keep = s.verified < s.remoteNext ? s.verified : s.remoteNext;
+  if (keep > 0) keep--;
+  for (uint32_t k = 0; k <= (uint32_t)history && k <= m->clientTick; k++) {
+    uint32_t t = m->clientTick - k;
+    if (t < s.remoteNext || t >= keep + LOCKSTEP_WINDOW) continue;
+    s.remote[t % LOCKSTEP_WINDOW] = k ? older[k - 1] : m->inputFlags;
+    s.remoteTag[t % LOCKSTEP_WINDOW] = t + 1;
+  }
+  while (s.remoteTag[s.remoteNext % LOCKSTEP_WINDOW] == s.remoteNext + 1) s.remoteNext++;
+  return true;
+}
+
+// Our inputs from the first one the peer lacks up to the newest.
+inline void lockstep_send(unsigned long now) {
+  Lockstep &s = lockstep();
+  if (s.localNext == 0) return;
+  uint32_t newest = s.localNext - 1, oldest = s.peerHas;
+  if (oldest > newest) oldest = newest;
+  if (newest - oldest > LOCKSTEP_MAX_HISTORY) oldest = newest - LOCKSTEP_MAX_HISTORY;
+  uint8_t flags[LOCKSTEP_MAX_HISTORY + 1];
+  int n = 0;
+  for (uint32_t t = newest; ; t--) {
+    flags[n++] = s.local[t % LOCKSTEP_WINDOW];
+    if (t == oldest) break;
+  }
+  send_input_window(s.myId, newest, flags, (uint8_t)(n - 1), s.remoteNext);
+  s.lastSentAt = now;
+  s.stats.inputsSent++;
+  s.stats.inputBytes += n;
+}
+
+inline void lockstep_apply_input(uint8_t p, uint8_t f, uint32_t t) {
+  Lockstep &s = lockstep();
+  int &x = (p == s.myId) ? playerX : otherPlayerX;
+  int &y = (p == s.myId) ? playerY : otherPlayerY;
+  uint8_t prev = s.sim.prevFlags[p];
+  s.sim.prevFlags[p] = f;
+  if (f != prev || ((f & 0x0F) && t - s.sim.lastMoveTick[p] >= LOCKSTEP_MOVE_REPEAT_TICKS)) {
+    int nx = x, ny = y;
+    if (f & 0x01) ny--;
+    if (f & 0x02) ny++;
+    if (f & 0x04) nx--;
+    if (f & 0x08) nx++;
+    if (mapIsWalkable(nx, ny)) { x = nx; y = ny; }
+    s.sim.lastMoveTick[p] = t;
+  }
+  if ((f & 0x10) && !(prev & 0x10)) {
+    // ids come from one counter that both sides advance in the same order
+    int i = bombSpawn(x, y, gameMillis(), BOMB_FUSE, p);
+    if (i >= 0) bombs[i].netId = ++bombIndex.lastNetId;
+  }
+}
+
+inline bool lockstep_have_remote(uint32_t t) { return lockstep().remoteTag[t % LOCKSTEP_WINDOW] == t + 1; }
+
+inline void lockstep_step() {
+  Lockstep &s = lockstep();
+  uint32_t t = s.tick;
+  gameClock().now = lockstep_tick_ms(t);
+  if (!s.solo) {
+    // the guess: the buttons of the peer's last input are still held
+    uint8_t f = lockstep_have_remote(t) ? s.remote[t % LOCKSTEP_WINDOW]
+              : (s.remoteNext ? s.remote[(s.remoteNext - 1) % LOCKSTEP_WINDOW] : 0);
+    s.stepped[t % LOCKSTEP_WINDOW] = f;
+  }
+  for (uint8_t p = 0; p < 2; p++) {
+    if (p == s.myId) lockstep_apply_input(p, s.local[t % LOCKSTEP_WINDOW], t);
+    else if (!s.solo) lockstep_apply_input(p, s.stepped[t % LOCKSTEP_WINDOW], t);
+  }
+  updateBombs();
+  s.tick++;
+}
+
+// Save the state before the next tick; false when it does not fit.
+inline bool lockstep_save_frame() {
+  Lockstep &s = lockstep();
+  LockstepFrame &f = lockstep_frames()[s.tick % ROLLBACK_FRAMES];
+  const LockstepFrame &prev = lockstep_frames()[(s.tick + ROLLBACK_FRAMES - 1) % ROLLBACK_FRAMES];
+  bool prevOk = s.tick > 0 && prev.ok && prev.tick == s.tick - 1;
+  f.tick = s.tick;
+  f.sim = s.sim;
+  f.ok = rollback_save(f.engine, prevOk ? &prev.engine : nullptr);
+  return f.ok;
+}
+
+// Back to the state before tick t, if it is still saved.
+inline bool lockstep_load_frame(uint32_t t) {
+  Lockstep &s = lockstep();
+  const LockstepFrame &f = lockstep_frames()[t % ROLLBACK_FRAMES];
+  if (!f.ok || f.tick != t) return false;
+  rollback_restore(f.engine);
+  s.sim = f.sim;
+  s.tick = t;
+  return true;
+}
+
+// Compare the guessed ticks whose real input is in now. From the first
+// wrong guess, restore and step again up to the current tick.
+inline void lockstep_reconcile() {
+  Lockstep &s = lockstep();
+  uint32_t upto = s.remoteNext < s.tick ? s.remoteNext : s.tick;
+  uint32_t t = s.verified;
+  while (t < upto && s.stepped[t % LOCKSTEP_WINDOW] == s.remote[t % LOCKSTEP_WINDOW]) t++;
+  // every guessed tick was saved before it was stepped
+  uint32_t to = s.tick;
+  if (t < upto && lockstep_load_frame(t)) {
+    s.stats.rollbacks++;
+    if (to - t > s.stats.maxRollback) s.stats.maxRollback = to - t;
+    while (s.tick < to) {
+      if (!lockstep_have_remote(s.tick) && !lockstep_save_frame()) break;
+      lockstep_step();
+      s.stats.resimTicks++;
+    }
+  }
+  s.verified = s.remoteNext < s.tick ? s.remoteNext : s.tick;
+}
+
+// Step every tick that is due and has both inputs (or, with rollback, a
+// guess for the peer's); send ours.
+inline void lockstep_poll(unsigned long now) {
+  Lockstep &s = lockstep();
+  if (!s.active) return;
+  if (s.rollback && !s.solo) lockstep_reconcile();
+  uint32_t due = (uint32_t)((uint64_t)(now - s.startedAt) * LOCKSTEP_HZ / 1000) + 1;
+  bool fresh = false, waiting = false;
+  for (int steps = 0; s.tick < due && steps < LOCKSTEP_MAX_CATCHUP; steps++) {
+    while (s.localNext <= s.tick + s.delay) {
+      s.local[s.localNext % LOCKSTEP_WINDOW] = s.sampled;
+      s.localNext++;
+      fresh = true;
+    }
+    if (!s.solo && !lockstep_have_remote(s.tick)) {
+      if (!s.rollback || s.tick - s.remoteNext >= ROLLBACK_MAX_TICKS || !lockstep_save_frame()) { waiting = true; break; }
+      s.stats.guessed++;
+    }
+    lockstep_step();
+    s.stats.ticks++;
+  }
+  s.verified = (s.solo || s.remoteNext > s.tick) ? s.tick : s.remoteNext;
+  if (due > s.tick && due - s.tick > s.stats.maxBehind) s.stats.maxBehind = due - s.tick;
+  if (waiting) {
+    if (!s.stalled) s.stats.stalls++;
+    s.stats.stallMs += now - s.lastPollAt;
+    if (now - s.lastRemoteAt > LOCKSTEP_PEER_TIMEOUT_MS) {
+      s.solo = true;
+      s.stats.peerLost++;
+    }
+  }
+  s.stalled = waiting;
+  s.lastPollAt = now;
+  // while stalled, repeat our inputs every tick in case the peer waits for them
+  if (!s.solo && (fresh || (waiting && now - s.lastSentAt >= 1000 / LOCKSTEP_HZ))) lockstep_send(now);
+}
+
+// The sketch's death scoring: the killer gains 20, the victim loses 20.
+inline void lockstep_death_scores(uint8_t victim, uint8_t killer) {
+  Lockstep &s = lockstep();
+  if (killer == s.myId) score_local += 20; else score_remote += 20;
+  if (victim == s.myId) score_local -= 20; else score_remote -= 20;
+  score = score_local;
+}
+
+// A player ran out of lives in explosion event `eventId`.
+inline void lockstep_player_out(uint8_t p, int eventId) {
+  Lockstep &s = lockstep();
+  if (!s.sim.outMask) { s.sim.outEvent = eventId; s.sim.outTick = s.tick; }
+  s.sim.outMask |= (uint8_t)(1u << p);
+}
+
+// True once a player is out and the blast is not the one that did it:
+// nobody is hit after that. Both sides apply hits in their own order, so a
+// player caught in the same blast still counts.
+inline bool lockstep_round_decided(int eventId) {
+  const Lockstep &s = lockstep();
+  return s.active && s.sim.outMask && eventId != s.sim.outEvent;
+}
+
+// True when the round is over for good; winner is the player left, or -1
+// when both went out in the same blast.
+inline bool lockstep_round_result(int *winner) {
+  const Lockstep &s = lockstep();
+  if (!s.active || !s.sim.outMask) return false;
+  if (!s.solo && s.sim.outTick >= s.verified) return false;
+  *winner = (s.sim.outMask == 3) ? -1 : ((s.sim.outMask & 1) ? 1 : 0);
+  return true;
+}
+
+// A blast cell at (x, y): the sketch's damagePlayerAt() rules for the
+// peer's player (spawn invulnerability, one hit per explosion event): it
+// goes back to its corner, or on its last life is out and the killer scores.
+inline void lockstep_on_blast_cell(int x, int y, uint8_t ownerId, int eventId) {
+  Lockstep &s = lockstep();
+  if (!s.active || s.solo || otherPlayerX != x || otherPlayerY != y) return;
+  if (lockstep_round_decided(eventId)) return;
+  unsigned long now = gameMillis();
+  if (now < s.sim.peerInvulEnd) return;
+  if (eventId != 0 && eventId == s.sim.peerLastEvent) return;
+  if (eventId != 0) s.sim.peerLastEvent = eventId;
+  s.stats.peerHits++;
+  uint8_t peerId = s.myId ? 0 : 1;
+  if (s.sim.peerLives > 0) s.sim.peerLives--;
+  if (s.sim.peerLives > 0) {
+    lockstep_peer_spawn(peerId, otherPlayerX, otherPlayerY);
+    s.sim.peerInvulEnd = now + SPAWN_INVUL_MS;
+    return;
+  }
+  if (ownerId != (uint8_t)0xFF) lockstep_death_scores(peerId, ownerId);
+  lockstep_player_out(peerId, eventId);
+}
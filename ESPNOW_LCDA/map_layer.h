@@ -0,0 +1,80 @@
+// map_layer.h - pre-rendered static map layer (solid/breakable tiles)
+#pragma once
+
+// Included from game_engine.h after mapData is declared.
+//
+// The layer holds the whole map already rendered in the SH1107 framebuffer
+// layout: page-major, one byte per pixel column, bit n = row n of the page.
+// With 8px tiles and a page-aligned HUD every tile row is exactly one page,
+// so a tile is 8 consecutive bytes and a 128px window of a tile row is one
+// memcpy. The layer is rebuilt per tile from mapSetTile() and in full by
+// generateMap(); rendering copies it into the framebuffer and only draws the
+// dynamic sprites (players, bombs, explosions) on top.
+//
+// Storage (`mapLayer`) is defined in the sketch: MAP_ROWS * MAP_COLS * 8 bytes.
+
+static_assert(TILE_SIZE == 8, "map_layer.h assumes 8px tiles (one SH1107 page per tile row)");
+static_assert(HUD_HEIGHT % 8 == 0, "map_layer.h assumes a page-aligned HUD");
+
+struct MapLayerGE {
+  uint8_t pages[MAP_ROWS][MAP_COLS * 8];
+};
+typedef MapLayerGE MapLayer;
+extern MapLayer mapLayer;
+
+// Column-major (page) form of an 8x8 row-major, MSB-first sprite.
+inline void mapLayerTransposeTile(const uint8_t *rows, uint8_t *cols) {
+  for (int c = 0; c < 8; c++) {
+    uint8_t v = 0;
+    for (int r = 0; r < 8; r++) if (pgm_read_byte(&rows[r]) & (0x80 >> c)) v |= (uint8_t)(1 << r);
+    cols[c] = v;
+  }
+}
+
+// Page-form tile images, indexed by Tile; built once on first use.
+inline const uint8_t *mapLayerTileColumns(Tile t) {
+  static uint8_t cols[3][8];
+  static bool built = false;
+  if (!built) {
+    memset(cols[TILE_EMPTY], 0, 8);
+    mapLayerTransposeTile(SPRITE_SOLID_8x8, cols[TILE_SOLID]);
+    mapLayerTransposeTile(SPRITE_BREAK_8x8, cols[TILE_BREAKABLE]);
+    built = true;
+  }
+  return cols[(t <= TILE_BREAKABLE) ? t : TILE_EMPTY];
+}
+
+inline void mapLayerUpdateTile(int x, int y) {
+  memcpy(&mapLayer.pages[y][x * 8], mapLayerTileColumns(mapData[y][x]), 8);
+}
+
+inline void mapLayerRebuild() {
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS; c++) mapLayerUpdateTile(c, r);
+}
+
+// Copy the map background of one tile to screen position (sx, sy) of a
+// width x height framebuffer; sy must be page aligned. Clipped to the buffer.
+inline void mapLayerBlitTile(uint8_t *fb, int width, int height, int x, int y, int sx, int sy) {
+  if (sy < 0 || sy + 8 > height) return;
+  int c0 = 0, n = 8;
+  if (sx < 0) { c0 = -sx; n -= c0; sx = 0; }
+  if (sx + n > width) n = width - sx;
+  if (n <= 0) return;
+  memcpy(fb + (size_t)(sy / 8) * width + sx, &mapLayer.pages[y][x * 8 + c0], (size_t)n);
+}
+
+// Copy the window starting at map pixel column xPixelOffset into the whole
+// framebuffer: one memcpy per page, anything past the map edge is cleared.
+inline void mapLayerBlitView(uint8_t *fb, int width, int height, int xPixelOffset) {
+  int n = MAP_COLS * 8 - xPixelOffset;
+  if (n < 0) n = 0;
+  if (n > width) n = width;
+  for (int p = 0; p < height / 8; p++) {
+    uint8_t *dst = fb + (size_t)p * width;
+    int r = p - HUD_HEIGHT / 8;
+    int copied = (r >= 0 && r < MAP_ROWS) ? n : 0;
+    if (copied > 0) memcpy(dst, &mapLayer.pages[r][xPixelOffset], (size_t)copied);
+    if (copied < width) memset(dst + copied, 0, (size_t)(width - copied));
+  }
+}
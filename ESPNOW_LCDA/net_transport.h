@@ -0,0 +1,31 @@
+#pragma once
+
+// net_transport.h - the link that carries the game's frames
+//
+// espnow_net.h and espnow_game.h never call a radio API directly; they send
+// through the transport selected with net_set_transport(). Without one the
+// ESP-NOW backend (espnow_transport() in espnow_net.h) is used. The host
+// build adds UDP and in-process backends (host/sim/host_transport.h), so two
+// instances of the game logic can play each other on one Linux machine.
+//
+// A backend hands every received frame, with the sender's 6-byte address,
+// to net_on_frame() in espnow_net.h. Backends with a receive callback (ESP-NOW)
+// do that from the callback; the others do it from poll(), which only
+// espnow_poll_rx() calls, once per loop().
+
+#include <Arduino.h>
+
+struct NetTransport {
+  const char *name;
+  bool (*begin)();                                                  // bring the link up
+  bool (*addPeer)(const uint8_t mac[6]);
+  bool (*send)(const uint8_t mac[6], const uint8_t *data, size_t len);
+  void (*poll)();                                                   // nullptr if frames arrive by callback
+};
+
+inline const NetTransport *&net_transport_selected() { static const NetTransport *t = nullptr; return t; }
+
+// Use t for all traffic from now on (nullptr = ESP-NOW). Select before initEspNow().
+inline void net_set_transport(const NetTransport *t) { net_transport_selected() = t; }
+
+// End of net_transport.h
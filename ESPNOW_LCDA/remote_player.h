@@ -0,0 +1,193 @@
+#pragma once
+
+// remote_player.h - the peer's player between position updates
+//
+// Include after game_engine.h. Outside lockstep each side reports its tile
+// and the direction it walks in MSG_POS (vx, vy: -1, 0 or 1 tile per step)
+// when that direction changes (and once more REMOTE_STEP_MS later, as a lost
+// stop or turn costs the most), when its tile is not where the last report
+// would put it (a respawn, a wall the peer's map does not have), and every
+// REMOTE_POS_REFRESH_MS while walking (REMOTE_POS_IDLE_MS standing). A walk
+// report is sent right after a step, so its arrival marks the step's phase.
+//
+// remote_player_update() walks the peer on from the last report every
+// REMOTE_STEP_MS (the sketch's MOVE_REPEAT_MS) by the rule the sketch moves
+// its own player by, for at most REMOTE_MAX_STEPS steps, and keeps
+// otherPlayerX/Y on that tile. The drawn position (remoteDraw()) slides
+// from the previous tile to the current one over a step. When a report
+// puts the peer somewhere the drawing did not expect, the difference is
+// blended away over REMOTE_BLEND_MS. More than REMOTE_SNAP_TILES away, the
+// drawing snaps.
+//
+// MSG_POS is unreliable, so a report can arrive late or twice. Only one
+// newer (by GameHdr.seq) than the last applied moves the peer; an older
+// one would put it back on a tile it has left. The peer's seqs start over
+// when it rejoins (remote_player_on_join()), or when one lands more than
+// TELEM_SEQ_RESTART behind (a reboot whose JOIN was lost).
+//
+// remote_pos_poll() is the sending side. It follows our own player from
+// our last report the way the peer does and sends MSG_POS when the peer's
+// picture would be wrong, or is due a refresh.
+
+#include "espnow_game.h"
+
+const unsigned long REMOTE_STEP_MS = 150;          // the sketch's MOVE_REPEAT_MS
+const unsigned long REMOTE_POS_REFRESH_MS = 300;   // every other step while walking
+const unsigned long REMOTE_POS_IDLE_MS = 1000;
+const uint8_t REMOTE_MAX_STEPS = 4;                // 600 ms past the last report
+const unsigned long REMOTE_BLEND_MS = 100;
+const int REMOTE_SNAP_TILES = 2;
+
+struct RemotePlayerStats {
+  unsigned long updates;       // MSG_POS applied
+  unsigned long corrections;   // ... that moved the peer off the walked tile
+  unsigned long snaps;         // ... too far from the drawing to blend
+  unsigned long stale;         // MSG_POS ignored: not newer than the last applied
+  unsigned long extrapolated;  // steps walked without a report
+  unsigned long posSent;       // our own MSG_POS
+};
+
+struct RemotePlayer {
+  bool known;
+  bool posAny;             // posSeq is the seq of the last MSG_POS applied
+  uint16_t posSeq;
+  int x, y;                // tile now
+  int fromX, fromY;        // tile before the last step
+  int8_t vx, vy;
+  unsigned long stepAt;    // time of the last step, reported or walked
+  uint8_t steps;           // walked since the last report
+  int errX, errY;          // drawing minus model in pixels at errAt, blended away
+  unsigned long errAt;
+  // our own player as the peer sees it from our last report
+  bool sent;
+  int sentX, sentY;        // where that report walks us
+  int8_t sentVx, sentVy;
+  uint8_t sentSteps;
+  bool sentTurn;           // the last report changed direction: repeat it
+  unsigned long sentAt;
+  RemotePlayerStats stats;
+};
+
+inline RemotePlayer &remote_player() { static RemotePlayer r = {}; return r; }
+
+inline int remoteClamp(int v, int lo, int hi) { return v < lo ? lo : (v > hi ? hi : v); }
+
+// One step from (x, y): the rule the sketch moves its player by.
+inline void remoteStep(int &x, int &y, int vx, int vy) {
+  if (mapIsWalkable(x + vx, y + vy)) { x += vx; y += vy; }
+}
+
+// Map pixel of the drawn sprite, kept on the map.
+inline void remoteDrawAt(const RemotePlayer &r, unsigned long now, int *px, int *py) {
+  unsigned long t = now - r.stepAt;
+  if (t > REMOTE_STEP_MS) t = REMOTE_STEP_MS;
+  int x = r.fromX * TILE_SIZE + (int)((r.x - r.fromX) * TILE_SIZE * (long)t / (long)REMOTE_STEP_MS);
+  int y = r.fromY * TILE_SIZE + (int)((r.y - r.fromY) * TILE_SIZE * (long)t / (long)REMOTE_STEP_MS);
+  unsigned long e = now - r.errAt;
+  if (e < REMOTE_BLEND_MS) {
+    x += (int)(r.errX * (long)(REMOTE_BLEND_MS - e) / (long)REMOTE_BLEND_MS);
+    y += (int)(r.errY * (long)(REMOTE_BLEND_MS - e) / (long)REMOTE_BLEND_MS);
+  }
+  *px = remoteClamp(x, 0, (MAP_COLS - 1) * TILE_SIZE);
+  *py = remoteClamp(y, 0, (MAP_ROWS - 1) * TILE_SIZE);
+}
+
+inline void remote_player_reset() {
+  RemotePlayerStats stats = remote_player().stats;
+  remote_player() = RemotePlayer();
+  remote_player().stats = stats;
+  remoteDraw() = RemoteDrawGE();
+}
+
+// Put the peer on (x, y) walking (vx, vy) as of `now`.
+inline void remoteMoveTo(RemotePlayer &r, int x, int y, int8_t vx, int8_t vy, unsigned long now) {
+  int drawX = 0, drawY = 0;
+  if (r.known) remoteDrawAt(r, now, &drawX, &drawY);
+  if (!r.known || x != r.x || y != r.y) {
+    // slide in from where we had it when that is next door
+    bool adjacent = r.known && abs(x - r.x) <= 1 && abs(y - r.y) <= 1;
+    r.fromX = adjacent ? r.x : x;
+    r.fromY = adjacent ? r.y : y;
+    r.x = x; r.y = y;
+    r.stepAt = now;
+  }
+  r.vx = vx; r.vy = vy;
+  r.steps = 0;
+  r.errX = r.errY = 0;
+  if (r.known) {
+    int toX, toY;
+    remoteDrawAt(r, now, &toX, &toY);
+    if (abs(drawX - toX) > REMOTE_SNAP_TILES * TILE_SIZE || abs(drawY - toY) > REMOTE_SNAP_TILES * TILE_SIZE) {
+      r.stats.snaps++;
+    } else {
+      r.errX = drawX - toX; r.errY = drawY - toY;
+      r.errAt = now;
+    }
+  }
+  r.known = true;
+}
+
+// Walk the peer on to `now`; call once per loop before rendering.
+inline void remote_player_update(unsigned long now) {
+  RemotePlayer &r = remote_player();
+  if (!otherPlayerVisible) { r.known = false; remoteDraw() = RemoteDrawGE(); return; }
+  // placed elsewhere (JOIN, a snapshot): standing there
+  if (!r.known || otherPlayerX != r.x || otherPlayerY != r.y) remoteMoveTo(r, otherPlayerX, otherPlayerY, 0, 0, now);
+  while ((r.vx || r.vy) && r.steps < REMOTE_MAX_STEPS && now - r.stepAt >= REMOTE_STEP_MS) {
+    r.fromX = r.x; r.fromY = r.y;
+    remoteStep(r.x, r.y, r.vx, r.vy);
+    r.stepAt += REMOTE_STEP_MS;
+    r.steps++;
+    r.stats.extrapolated++;
+  }
+  otherPlayerX = r.x; otherPlayerY = r.y;
+  int px, py;
+  remoteDrawAt(r, now, &px, &py);
+  remoteDraw().dx = px - r.x * TILE_SIZE;
+  remoteDraw().dy = py - r.y * TILE_SIZE;
+}
+
+// The peer (re)joined: its seqs may have restarted.
+inline void remote_player_on_join() { remote_player().posAny = false; }
+
+// MSG_POS from the peer.
+inline void remote_player_on_pos(const MsgPos *m, unsigned long now) {
+  RemotePlayer &r = remote_player();
+  int16_t d = (int16_t)(m->h.seq - r.posSeq);
+  if (r.posAny && d <= 0 && d >= -TELEM_SEQ_RESTART) { r.stats.stale++; return; }
+  r.posAny = true;
+  r.posSeq = m->h.seq;
+  if (r.known) remote_player_update(now);
+  r.stats.updates++;
+  if (r.known && (m->px != r.x || m->py != r.y)) r.stats.corrections++;
+  remoteMoveTo(r, m->px, m->py, (int8_t)remoteClamp(m->vx, -1, 1), (int8_t)remoteClamp(m->vy, -1, 1), now);
+  otherPlayerX = r.x; otherPlayerY = r.y;
+  otherPlayerVisible = true;
+}
+
+// Direction buttons (input flags bits 0-3) as a step.
+inline int8_t input_vx(uint8_t flags) { return (int8_t)(((flags & 0x08) ? 1 : 0) - ((flags & 0x04) ? 1 : 0)); }
+inline int8_t input_vy(uint8_t flags) { return (int8_t)(((flags & 0x02) ? 1 : 0) - ((flags & 0x01) ? 1 : 0)); }
+
+// Our player is on (x, y) walking with the direction buttons `flags`;
+// `stepped` if it took a step this loop. Sends MSG_POS when it is due.
+inline bool remote_pos_poll(uint8_t fromId, int x, int y, uint8_t flags, bool stepped, unsigned long now) {
+  RemotePlayer &r = remote_player();
+  int8_t vx = input_vx(flags), vy = input_vy(flags);
+  if (r.sent && stepped && r.sentSteps < REMOTE_MAX_STEPS) {
+    remoteStep(r.sentX, r.sentY, r.sentVx, r.sentVy);
+    r.sentSteps++;
+  }
+  bool turn = !r.sent || vx != r.sentVx || vy != r.sentVy;
+  bool due = turn || x != r.sentX || y != r.sentY || (r.sentTurn && now - r.sentAt >= REMOTE_STEP_MS) ||
+             (stepped && now - r.sentAt >= REMOTE_POS_REFRESH_MS) || now - r.sentAt >= REMOTE_POS_IDLE_MS;
+  if (!due) return false;
+  r.sent = true;
+  r.sentTurn = turn;
+  r.sentX = x; r.sentY = y;
+  r.sentVx = vx; r.sentVy = vy;
+  r.sentSteps = 0;
+  r.sentAt = now;
+  r.stats.posSent++;
+  return send_pos(fromId, (uint8_t)x, (uint8_t)y, (uint8_t)(flags & 0x0F), vx, vy);
+}
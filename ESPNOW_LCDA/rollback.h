@@ -0,0 +1,186 @@
+#pragma once
+
+// rollback.h - compact saves of the round state, for rolling a fixed-tick
+// simulation back
+//
+// Include after game_engine.h. rollback_save() copies what stepping a tick
+// can change into a RollbackState. rollback_restore() puts it back. It only
+// touches what differs, and it does so through mapSetTile(), bombIndex and
+// markTileDirty(), so the digest, the bitboard masks and the dirty tiles
+// stay right. A map band whose digest already matches is not compared.
+// Saved:
+//   map       2 bits per tile, and the digest of each band
+//   bombs     the active slots {x, y, owner, netId, placedAt, fuseMs}
+//   timers    the heap as it is, so equal times fire in the same order
+//   burning   {cell, endAt} in explosions.active order
+//   players   both positions, our lives, spawnInvulEnd, lastDamageEvent
+//   scores    score_local, score_remote, explosionEventCounter
+// The peer bomb table is left alone: lockstep.h, the only user, does not
+// fill it, and drops the snapshots of state_snapshot.h (the other writer
+// of that table, the map, the scores and the peer's position) while it
+// runs. A save fails (returns false) when more than ROLLBACK_MAX_BOMBS
+// slots or ROLLBACK_MAX_BURNING cells would have to fit.
+
+#include "espnow_game.h"
+
+extern int lastDamageEvent;
+extern long score_local;
+extern long score_remote;
+
+const int ROLLBACK_MAX_BOMBS = 8;
+const int ROLLBACK_MAX_BURNING = 64;
+const int ROLLBACK_MAP_BYTES = (MAP_ROWS * MAP_COLS + 3) / 4;
+
+struct RollbackBomb {
+  uint8_t slot, x, y, owner;
+  uint16_t netId;
+  uint32_t placedAt;
+  uint32_t fuseMs;
+};
+
+struct RollbackState {
+  uint32_t region[STATE_HASH_REGIONS];
+  uint8_t map[ROLLBACK_MAP_BYTES];
+  uint8_t bombCount, timerCount;
+  uint16_t lastNetId;
+  uint32_t timerSeq;
+  bool explosionPending;
+  RollbackBomb bombs[ROLLBACK_MAX_BOMBS];
+  TimerEvent heap[ROLLBACK_MAX_BOMBS + 1];
+  uint16_t burningCount;
+  uint16_t burning[ROLLBACK_MAX_BURNING];
+  uint32_t burnEnd[ROLLBACK_MAX_BURNING];
+  int16_t playerX, playerY, otherX, otherY;
+  int8_t lives;
+  uint32_t spawnInvulEnd;
+  int lastDamageEvent, explosionEventCounter;
+  int32_t scoreLocal, scoreRemote;
+};
+
+// Tiles [from, to) of the row-major map, four a byte.
+inline void rollbackPackTiles(uint8_t *map, int from, int to) {
+  const uint8_t *tiles = (const uint8_t *)mapData;
+  int n = from;
+  for (; n < to && (n % 4 || n + 4 > to); n++)
+    map[n / 4] = (uint8_t)((map[n / 4] & ~(3u << ((n % 4) * 2))) | ((tiles[n] & 3u) << ((n % 4) * 2)));
+  for (; n + 4 <= to; n += 4)
+    map[n / 4] = (uint8_t)((tiles[n] & 3) | (tiles[n + 1] & 3) << 2 | (tiles[n + 2] & 3) << 4 | (tiles[n + 3] & 3) << 6);
+  for (; n < to; n++)
+    map[n / 4] = (uint8_t)((map[n / 4] & ~(3u << ((n % 4) * 2))) | ((tiles[n] & 3u) << ((n % 4) * 2)));
+}
+
+// `prev`, if given, is an earlier save: map bands whose digest has not
+// changed since are copied from it instead of packed again.
+inline bool rollback_save(RollbackState &st, const RollbackState *prev = nullptr) {
+  if (MAX_BOMBS > ROLLBACK_MAX_BOMBS || explosions.activeCount > ROLLBACK_MAX_BURNING) return false;
+  const StateHashGE &h = stateHash();
+  for (int r = 0; r < MAP_ROWS; ) {
+    int band = stateHashRegionOf(r), end = r;
+    while (end < MAP_ROWS && stateHashRegionOf(end) == band) end++;
+    int from = r * MAP_COLS, to = end * MAP_COLS;
+    if (prev && from % 4 == 0 && to % 4 == 0 && prev->region[band] == h.region[band])
+      memcpy(st.map + from / 4, prev->map + from / 4, (to - from) / 4);
+    else
+      rollbackPackTiles(st.map, from, to);
+    r = end;
+  }
+  memcpy(st.region, h.region, sizeof(st.region));
+  st.bombCount = 0;
+  for (int i = 0; i < MAX_BOMBS; i++) {
+    if (!bombs[i].active) continue;
+    RollbackBomb &b = st.bombs[st.bombCount++];
+    b.slot = (uint8_t)i; b.x = (uint8_t)bombs[i].x; b.y = (uint8_t)bombs[i].y; b.owner = bombs[i].owner;
+    b.netId = bombs[i].netId;
+    b.placedAt = (uint32_t)bombs[i].placedAt;
+    b.fuseMs = (uint32_t)bombs[i].fuseMs;
+  }
+  st.lastNetId = bombIndex.lastNetId;
+  st.timerCount = (uint8_t)timers.count;
+  st.timerSeq = timers.seq;
+  st.explosionPending = timers.explosionPending;
+  memcpy(st.heap, timerHeap, sizeof(TimerEvent) * timers.count);
+  st.burningCount = (uint16_t)explosions.activeCount;
+  for (int i = 0; i < explosions.activeCount; i++) {
+    uint16_t cell = explosions.active[i];
+    st.burning[i] = cell;
+    st.burnEnd[i] = (uint32_t)explosions.endAt[cell / MAP_COLS][cell % MAP_COLS];
+  }
+  st.playerX = (int16_t)playerX; st.playerY = (int16_t)playerY;
+  st.otherX = (int16_t)otherPlayerX; st.otherY = (int16_t)otherPlayerY;
+  st.lives = (int8_t)lives;
+  st.spawnInvulEnd = (uint32_t)spawnInvulEnd;
+  st.lastDamageEvent = lastDamageEvent;
+  st.explosionEventCounter = explosionEventCounter;
+  st.scoreLocal = (int32_t)score_local;
+  st.scoreRemote = (int32_t)score_remote;
+  return true;
+}
+
+inline void rollback_restore(const RollbackState &st) {
+  // map: a band with the saved digest holds the saved tiles
+  for (int band = 0; band < STATE_HASH_REGIONS; band++) {
+    if (stateHash().region[band] == st.region[band]) continue;
+    for (int r = 0; r < MAP_ROWS; r++) {
+      if (stateHashRegionOf(r) != band) continue;
+      for (int c = 0; c < MAP_COLS; c++) {
+        int n = r * MAP_COLS + c;
+        Tile t = (Tile)((st.map[n / 4] >> ((n % 4) * 2)) & 3);
+        if (mapData[r][c] != t) mapSetTile(c, r, t);
+      }
+    }
+  }
+  // bombs: a slot that differs is emptied, then refilled from the save
+  int k = 0;
+  for (int i = 0; i < MAX_BOMBS; i++) {
+    const RollbackBomb *b = (k < st.bombCount && st.bombs[k].slot == i) ? &st.bombs[k++] : nullptr;
+    Bomb &cur = bombs[i];
+    if (b && cur.active && cur.x == b->x && cur.y == b->y && cur.owner == b->owner && cur.netId == b->netId &&
+        (uint32_t)cur.placedAt == b->placedAt && (uint32_t)cur.fuseMs == b->fuseMs) continue;
+    if (!b && !cur.active) continue;
+    if (cur.active) {
+      stateHash().bombs ^= zobristBomb(cur.x, cur.y, cur.owner);
+      if (bombIndex.at[cur.y][cur.x] == i) bombIndex.at[cur.y][cur.x] = -1;
+      markTileDirty(cur.x, cur.y);
+      cur.active = false;
+      cur.placedAt = 0;
+      bombIndex.freeMask |= (1UL << i);
+    }
+    if (b) {
+      cur.active = true;
+      cur.x = b->x; cur.y = b->y; cur.owner = b->owner; cur.netId = b->netId;
+      cur.placedAt = b->placedAt;
+      cur.fuseMs = b->fuseMs;
+      stateHash().bombs ^= zobristBomb(cur.x, cur.y, cur.owner);
+      bombIndex.at[cur.y][cur.x] = (int8_t)i;
+      markTileDirty(cur.x, cur.y);
+      bombIndex.freeMask &= ~(1UL << i);
+    }
+  }
+  bombIndex.lastNetId = st.lastNetId;
+  timers.count = st.timerCount;
+  timers.seq = st.timerSeq;
+  timers.explosionPending = st.explosionPending;
+  memcpy(timerHeap, st.heap, sizeof(TimerEvent) * st.timerCount);
+  // burning cells: put out the current ones, light the saved ones
+  for (int i = 0; i < explosions.activeCount; i++) {
+    uint16_t cell = explosions.active[i];
+    explosions.endAt[cell / MAP_COLS][cell % MAP_COLS] = 0;
+    markTileDirty(cell % MAP_COLS, cell / MAP_COLS);
+  }
+  explosions.activeCount = st.burningCount;
+  for (int i = 0; i < st.burningCount; i++) {
+    uint16_t cell = st.burning[i];
+    explosions.active[i] = cell;
+    explosions.endAt[cell / MAP_COLS][cell % MAP_COLS] = st.burnEnd[i];
+    markTileDirty(cell % MAP_COLS, cell / MAP_COLS);
+  }
+  playerX = st.playerX; playerY = st.playerY;
+  otherPlayerX = st.otherX; otherPlayerY = st.otherY;
+  lives = st.lives;
+  spawnInvulEnd = st.spawnInvulEnd;
+  lastDamageEvent = st.lastDamageEvent;
+  explosionEventCounter = st.explosionEventCounter;
+  score_local = st.scoreLocal;
+  score_remote = st.scoreRemote;
+  score = score_local;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+// rx_queue.h - lock-free single-producer/single-consumer queue of received frames
+//
+// The ESP-NOW receive callback runs in the Wi-Fi task, while the game state
+// (bombs[], mapData, scores, gameState) belongs to loop(). The callback only
+// copies each frame into a preallocated slot and publishes it by advancing
+// `head` (release store). loop() reads the slots up to `head` (acquire load)
+// and frees them by advancing `tail`. Each index is written by one side
+// only, so neither side takes a lock and the callback never blocks. When the
+// queue is full the new frame is dropped and counted.
+
+#include <Arduino.h>
+#include <atomic>
+
+const int RX_FRAME_MAX = 250;        // ESP-NOW v1 payload limit
+const uint32_t RX_QUEUE_SLOTS = 16;  // power of two
+
+struct RxFrame {
+  uint8_t src[6];
+  uint8_t len;
+  uint8_t data[RX_FRAME_MAX];
+};
+
+class RxQueue {
+public:
+  // Producer side (receive callback). False if the frame was dropped.
+  bool push(const uint8_t *src, const uint8_t *data, int len) {
+    if (len <= 0 || len > RX_FRAME_MAX) { oversize.fetch_add(1, std::memory_order_relaxed); return false; }
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t depth = h - tail.load(std::memory_order_acquire);
+    if (depth >= RX_QUEUE_SLOTS) { dropped.fetch_add(1, std::memory_order_relaxed); return false; }
+    RxFrame &f = slots[h & (RX_QUEUE_SLOTS - 1)];
+    memcpy(f.src, src, 6);
+    f.len = (uint8_t)len;
+    memcpy(f.data, data, (size_t)len);
+    head.store(h + 1, std::memory_order_release);
+    pushed.fetch_add(1, std::memory_order_relaxed);
+    if (depth + 1 > highWater.load(std::memory_order_relaxed)) highWater.store(depth + 1, std::memory_order_relaxed);
+    return true;
+  }
+
+  // Consumer side (loop()): the oldest frame, or nullptr. Valid until pop().
+  const RxFrame *peek() const {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) return nullptr;
+    return &slots[t & (RX_QUEUE_SLOTS - 1)];
+  }
+
+  void pop() {
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  uint32_t depth() const {
+    return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+  }
+
+  // statistics (written by the producer)
+  std::atomic<uint32_t> pushed{0};
+  std::atomic<uint32_t> dropped{0};   // queue full
+  std::atomic<uint32_t> oversize{0};  // longer than RX_FRAME_MAX
+  std::atomic<uint32_t> highWater{0}; // deepest the queue has been
+
+private:
+  std::atomic<uint32_t> head{0};  // next slot the producer writes
+  std::atomic<uint32_t> tail{0};  // next slot the consumer reads
+  RxFrame slots[RX_QUEUE_SLOTS];
+};
+
+// End of rx_queue.h
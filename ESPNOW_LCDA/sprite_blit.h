@@ -0,0 +1,107 @@
+// sprite_blit.h - byte-aligned sprite blitter for the SH1107 page-major framebuffer
+#pragma once
+
+#include <Arduino.h>
+#include "sprites.h"
+
+// The sprites in sprites.h are row-major, MSB-first bitmaps (the format
+// drawBitmap() takes). drawBitmap() walks them one pixel at a time through
+// drawPixel(). A PageSprite is the same image converted once into the
+// display's layout: one byte per column, bit n = row n of a page. It is
+// pre-shifted for all 8 vertical offsets, so a blit at any y is one or two
+// whole-byte OR/AND operations per column, with no per-pixel work and no
+// PROGMEM reads.
+//
+// Sprites up to 16x8 pixels are supported, including nearest-neighbour
+// pre-scaled copies (pageSpriteBuild() with a destination size). Larger
+// sizes return false from pageSpriteBuild() and callers fall back to GFX.
+
+enum BlitMode : uint8_t {
+  BLIT_OR = 0,     // set the sprite's pixels
+  BLIT_CLEAR = 1,  // clear the sprite's pixels (AND with the inverse)
+  BLIT_OPAQUE = 2  // clear the sprite's w x h box, then set its pixels
+};
+
+struct PageSprite {
+  uint8_t w, h;
+  // [y & 7][column]: low byte goes to the page containing y, high byte to the next page
+  uint16_t shifted[8][16];
+  uint16_t box[8];  // the w x h box, pre-shifted the same way (for BLIT_OPAQUE)
+};
+
+// Convert a bw x bh row-major sprite to a dw x dh PageSprite, sampling like
+// the sketches' drawSpriteScaled() (nearest neighbour). dw/dh = bw/bh for 1:1.
+inline bool pageSpriteBuild(PageSprite &s, const uint8_t *bmp, int bw, int bh, int dw, int dh) {
+  if (!bmp || bw <= 0 || bh <= 0 || dw <= 0 || dh <= 0 || dw > 16 || dh > 8) return false;
+  int byteWidth = (bw + 7) / 8;
+  uint8_t cols[16];
+  for (int dx = 0; dx < dw; dx++) {
+    int sx = (dx * bw) / dw;
+    uint8_t v = 0;
+    for (int dy = 0; dy < dh; dy++) {
+      int sy = (dy * bh) / dh;
+      if (pgm_read_byte(&bmp[sy * byteWidth + sx / 8]) & (0x80 >> (sx & 7))) v |= (uint8_t)(1 << dy);
+    }
+    cols[dx] = v;
+  }
+  s.w = (uint8_t)dw;
+  s.h = (uint8_t)dh;
+  for (int sh = 0; sh < 8; sh++) {
+    for (int c = 0; c < 16; c++) s.shifted[sh][c] = (c < dw) ? (uint16_t)(cols[c] << sh) : 0;
+    s.box[sh] = (uint16_t)(((1u << dh) - 1) << sh);
+  }
+  return true;
+}
+
+// Blit into a page-major framebuffer of fbW x fbH pixels (fbW bytes per page).
+inline void blitSprite(uint8_t *fb, int fbW, int fbH, const PageSprite &s, int x, int y, BlitMode mode = BLIT_OR) {
+  if (!fb || x >= fbW || y >= fbH || x + s.w <= 0 || y + s.h <= 0) return;
+  int page = (y >= 0) ? (y >> 3) : -((7 - y) >> 3);
+  int sh = y - page * 8;
+  int pages = fbH / 8;
+  bool lo = page >= 0 && page < pages;
+  bool hi = page + 1 >= 0 && page + 1 < pages && sh + s.h > 8;
+  int c0 = (x < 0) ? -x : 0;
+  int c1 = (x + s.w > fbW) ? fbW - x : s.w;
+  uint8_t *p0 = fb + (size_t)page * fbW + x;
+  uint8_t *p1 = p0 + fbW;
+  const uint16_t *src = s.shifted[sh];
+  uint16_t box = s.box[sh];
+  for (int c = c0; c < c1; c++) {
+    uint16_t v = src[c];
+    switch (mode) {
+      case BLIT_OR:
+        if (lo) p0[c] |= (uint8_t)v;
+        if (hi) p1[c] |= (uint8_t)(v >> 8);
+        break;
+      case BLIT_CLEAR:
+        if (lo) p0[c] &= (uint8_t)~v;
+        if (hi) p1[c] &= (uint8_t)~(v >> 8);
+        break;
+      case BLIT_OPAQUE:
+        if (lo) p0[c] = (uint8_t)((p0[c] & ~box) | v);
+        if (hi) p1[c] = (uint8_t)((p1[c] & ~(box >> 8)) | (v >> 8));
+        break;
+    }
+  }
+}
+
+// Native-size PageSprites for everything in sprites.h, built on first use.
+struct SpriteSet {
+  PageSprite solid, breakable, player, bomb, explode, life;
+};
+
+inline const SpriteSet &pageSprites() {
+  static SpriteSet set;
+  static bool built = false;
+  if (!built) {
+    pageSpriteBuild(set.solid, SPRITE_SOLID_8x8, 8, 8, 8, 8);
+    pageSpriteBuild(set.breakable, SPRITE_BREAK_8x8, 8, 8, 8, 8);
+    pageSpriteBuild(set.player, SPRITE_PLAYER_6x6, 6, 6, 6, 6);
+    pageSpriteBuild(set.bomb, SPRITE_BOMB_6x6, 6, 6, 6, 6);
+    pageSpriteBuild(set.explode, SPRITE_EXPLODE_8x8, 8, 8, 8, 8);
+    pageSpriteBuild(set.life, SPRITE_LIFE_8x6, 8, 6, 8, 6);
+    built = true;
+  }
+  return set;
+}
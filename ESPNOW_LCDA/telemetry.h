@@ -0,0 +1,101 @@
+#pragma once
+
+// telemetry.h - link and protocol counters
+//
+// Cheap enough to leave on: every count is one add. What the Wi-Fi task
+// touches (frames sent and received, the send callback's status) are
+// relaxed atomics; the per-type and sequence counts belong to loop(). The
+// statistics the stack keeps anyway (RelStats, PeerLinkStats, the receive
+// queue's drops, StateSyncStats) are not counted twice: telemetry_dump.h
+// reads them when it writes a record.
+//
+// Sequence numbers: unreliable messages, acks and batch headers take
+// GameHdr.seq from one counter per device (next_game_seq()), so the peer's
+// stream of them shows what went missing. A seq more than one above the
+// highest seen adds the skipped ones to seqGaps; one below it counts as
+// late (it was counted in a gap before), equal as a duplicate. Messages
+// lost for good are about seqGaps - seqLate. A MSG_JOIN starts the count
+// over (the peer may have rebooted); a jump of more than TELEM_SEQ_RESTART
+// does too and is counted in seqRestarts. Reliable messages have their own
+// seqs; relOutOfOrder counts the new ones that arrive below the highest
+// seen.
+
+#include <Arduino.h>
+#include <atomic>
+
+const int TELEM_TYPES = 15;        // MsgType 1..13 as is, MSG_ACK (200) in 14, anything else in 0
+const int TELEM_TYPE_ACK = 14;
+const int TELEM_RTT_BUCKETS = 12;  // < 1 ms, then [2^(i-1), 2^i) ms; the last is 1024 ms and up
+const int TELEM_SEQ_RESTART = 1024;  // a jump this far means the peer's counter restarted
+
+struct Telemetry {
+  // frames handed to the transport and received from it, every kind
+  std::atomic<uint32_t> txFrames{0}, txBytes{0};
+  std::atomic<uint32_t> txFail{0};    // the transport refused the frame (driver queue full)
+  std::atomic<uint32_t> txOk{0};      // send callback: the peer's radio acked it
+  std::atomic<uint32_t> txNoAck{0};   // send callback: no ack after the radio's retries
+  std::atomic<uint32_t> rxFrames{0}, rxBytes{0};
+  // game messages, batches unpacked (loop())
+  uint32_t txMsgs[TELEM_TYPES] = {};  // retransmits included
+  uint32_t rxMsgs[TELEM_TYPES] = {};
+  uint32_t seqGaps = 0, seqLate = 0, seqDups = 0, seqRestarts = 0;
+  uint32_t relOutOfOrder = 0;
+  bool seqAny = false;
+  uint16_t seqMax = 0;
+  // round trips: reliable messages acked on the first try, and pings
+  uint32_t ackRtt[TELEM_RTT_BUCKETS] = {};
+  uint32_t pingRtt[TELEM_RTT_BUCKETS] = {};
+};
+inline Telemetry &telemetry() { static Telemetry t; return t; }
+
+inline int telemetry_type_slot(uint8_t type) {
+  if (type > 0 && type < TELEM_TYPE_ACK) return type;
+  return type == 200 ? TELEM_TYPE_ACK : 0;
+}
+
+inline void telemetry_count_tx(uint8_t type) { telemetry().txMsgs[telemetry_type_slot(type)]++; }
+inline void telemetry_count_rx(uint8_t type) { telemetry().rxMsgs[telemetry_type_slot(type)]++; }
+
+inline void telemetry_frame_sent(size_t len, bool ok) {
+  Telemetry &t = telemetry();
+  if (!ok) { t.txFail.fetch_add(1, std::memory_order_relaxed); return; }
+  t.txFrames.fetch_add(1, std::memory_order_relaxed);
+  t.txBytes.fetch_add((uint32_t)len, std::memory_order_relaxed);
+}
+
+inline void telemetry_frame_received(int len) {
+  Telemetry &t = telemetry();
+  t.rxFrames.fetch_add(1, std::memory_order_relaxed);
+  t.rxBytes.fetch_add((uint32_t)len, std::memory_order_relaxed);
+}
+
+inline void telemetry_send_status(bool acked) {
+  (acked ? telemetry().txOk : telemetry().txNoAck).fetch_add(1, std::memory_order_relaxed);
+}
+
+// The peer's seqs may start over (MSG_JOIN).
+inline void telemetry_seq_restart() { telemetry().seqAny = false; }
+
+// An unreliable message, ack or batch header from the peer.
+inline void telemetry_rx_seq(uint16_t seq) {
+  Telemetry &t = telemetry();
+  int16_t d = (int16_t)(seq - t.seqMax);
+  if (t.seqAny && (d > TELEM_SEQ_RESTART || d < -TELEM_SEQ_RESTART)) { t.seqRestarts++; t.seqAny = false; }
+  if (!t.seqAny) { t.seqAny = true; t.seqMax = seq; return; }
+  if (d > 0) { t.seqGaps += (uint32_t)(d - 1); t.seqMax = seq; }
+  else if (d < 0) t.seqLate++;
+  else t.seqDups++;
+}
+
+inline void telemetry_rtt(uint32_t hist[TELEM_RTT_BUCKETS], float ms) {
+  int b = 0;
+  for (float lim = 1.0f; b < TELEM_RTT_BUCKETS - 1 && ms >= lim; lim *= 2) b++;
+  hist[b]++;
+}
+
+inline const char *telemetry_type_name(int slot) {
+  static const char *const names[TELEM_TYPES] = {
+    "other", "JOIN", "JOIN_ACK", "HEARTBEAT", "INPUT", "POS", "BOMB_PLACE", "BOMB_EXPLODE",
+    "MAP_SYNC", "STATE_SNAPSHOT", "SCORE_UPDATE", "PLAYER_DEATH", "BATCH", "STATE_HASH", "ACK"};
+  return (slot >= 0 && slot < TELEM_TYPES) ? names[slot] : "?";
+}
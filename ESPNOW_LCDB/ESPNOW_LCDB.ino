@@ -4,6 +4,8 @@
 #include <Wire.h>
 #include <Adafruit_GFX.h>
 #include <Adafruit_SH110X.h>
+#include "display_flush.h"
+#include "async_flush.h"
 #include "sprites.h"
 #include "espnow_net.h"
 #include "espnow_game.h"
@@ -19,28 +21,58 @@
 // I2C Display Configuration
 TwoWire I2C_1 = TwoWire(0);
 TwoWire I2C_2 = TwoWire(1);
-Adafruit_SH1107 display1(128, 128, &I2C_1);
-Adafruit_SH1107 display2(128, 128, &I2C_2);
+PartialSH1107 display1(128, 128, &I2C_1); // gameplay view: partial page flushes
+PartialSH1107 display2(128, 128, &I2C_2);  // HUD: redrawn each frame, changed columns flushed
+// one background flush task per bus, so both displays are sent in parallel
+AsyncFlush flush1(display1);
+AsyncFlush flush2(display2);
+FlushOverlapStats flushOverlap = {};
 
 // Display throttling to reduce I2C blocking during gameplay
 const unsigned long DISPLAY_REFRESH_MS = 33; // ~30 FPS
 unsigned long lastDisplay1FlushMs = 0;
 unsigned long lastDisplay2FlushMs = 0;
 
+// Both flushes only hand a snapshot to the flush tasks (async_flush.h) and
+// return; a frame is skipped if that display's previous one is still going out.
+// force = full screen (menus, countdown), waiting for a running transfer;
+// otherwise only the regions marked by renderDirtyTiles() are sent, at most
+// every DISPLAY_REFRESH_MS.
 void flushDisplay1(bool force = false) {
   unsigned long now = millis();
-  if (force || now - lastDisplay1FlushMs >= DISPLAY_REFRESH_MS) {
-    display1.display();
+  if (force) {
+    flush1.wait();
+    flush1.submit(FLUSH_FULL);
     lastDisplay1FlushMs = now;
+  } else if (now - lastDisplay1FlushMs >= DISPLAY_REFRESH_MS && display1.anyDirty()) {
+    if (!flush1.submit(FLUSH_DIRTY)) return;
+    lastDisplay1FlushMs = now;
+    if (flush1.jobs % 100 == 0 && display1.flushes)
+      DBG_PRINTF("display1 flush: %lu bytes (avg %lu), %lu us (max %lu), %lu skipped\n", display1.lastFlushBytes,
+                 display1.totalBytes / display1.flushes, flush1.lastUs, flush1.maxUs, flush1.skipped);
   }
 }
 
+// The HUD is redrawn from scratch each frame, so only the column groups that
+// differ from what the panel shows are sent.
 void flushDisplay2(bool force = false) {
   unsigned long now = millis();
-  if (force || now - lastDisplay2FlushMs >= DISPLAY_REFRESH_MS) {
-    display2.display();
+  if (force) {
+    flush2.wait();
+    flush2.submit(FLUSH_FULL);
     lastDisplay2FlushMs = now;
+  } else if (now - lastDisplay2FlushMs >= DISPLAY_REFRESH_MS) {
+    if (flush2.submit(FLUSH_DIFF)) lastDisplay2FlushMs = now;
   }
+  if (flushOverlapSample(flushOverlap, flush1, flush2) && flushOverlap.pairs % 100 == 0)
+    DBG_PRINTF("display flush overlap: %lu us of %lu us serial (%lu us wall) over %lu pairs\n",
+               flushOverlap.overlapUs, flushOverlap.serialUs, flushOverlap.wallUs, flushOverlap.pairs);
+}
+
+// Wait for both flush tasks, e.g. before drawing code that calls display().
+void waitDisplaysIdle() {
+  flush1.wait();
+  flush2.wait();
 }
 
 // Timing / counters
@@ -58,30 +90,50 @@ const uint8_t MAP_ROWS = 16;  // make square 16x16 map to use full 128px height
 
 enum Tile : uint8_t { TILE_EMPTY = 0, TILE_SOLID = 1, TILE_BREAKABLE = 2 };
 
+// Optional map backend: per-row/column bitmasks for collision and blast rays
+// (see game_engine.h). Add MAP_BITBOARD_WIDE for arenas wider than 32 tiles.
+// #define MAP_BITBOARD
+
 // Game state (storage)
 #include "game_engine.h"
+#include "state_sync.h"
+#include "state_snapshot.h"
+#include "lockstep.h"
+#include "remote_player.h"
+#include "clock_sync.h"
+#include "telemetry_dump.h"
+#include "game_handlers.h"
 
 Tile mapData[MAP_ROWS][MAP_COLS];
+MapLayer mapLayer;
 int playerX = 1, playerY = 1, playerHealth = 1;
 int otherPlayerX = -1, otherPlayerY = -1; bool otherPlayerVisible = false;
 int spawnX = 1, spawnY = 1;
 const int MAX_BOMBS = 6;
-const int MAX_EXPLOSION_CELLS = 128;
+static_assert(MAX_BOMBS <= MAX_BOMBS_LIMIT, "bombIndex.freeMask, resolveBlast() and snapshots hold MAX_BOMBS_LIMIT bombs");
+static_assert(MAX_BOMBS < REMOTE_BOMB_ENTRIES, "remoteBombs must hold all of the peer's bombs");
 
-// concrete storage for bombs/explosions (types Bomb/ExplosionCell are defined in game_engine.h)
+// concrete storage for bombs/explosions/timers (types are defined in game_engine.h)
 Bomb bombs[MAX_BOMBS];
-ExplosionCell explosions[MAX_EXPLOSION_CELLS];
+DirtyTiles dirtyTiles;
+BombIndex bombIndex;
+RemoteBombTable remoteBombs;
+ExplosionGrid explosions;
+TimerQueue timers;
+TimerEvent timerHeap[MAX_BOMBS + 1];
 
 // Gameplay parameters
 const unsigned long BOMB_FUSE = 2000;
 const unsigned long EXPLOSION_VIS_MS = 300;
 const int EXPLOSION_RADIUS = 2;
 
-// Reliable placement helpers: retransmit interval and stale thresholds
-const unsigned long BOMB_PLACE_RESEND_MS = 250; // resend bomb_place while bomb active
-const unsigned long BOMB_MIN_REMAIN_MS = 150;   // when a remote place is slightly expired, leave a small remainder
-const unsigned long BOMB_STALE_THRESHOLD_MS = 1000; // if placement is older than this, treat as exploded
-unsigned long lastBombPlaceSent[MAX_BOMBS] = {0};
+// Step both players at a fixed tick from exchanged inputs (lockstep.h)
+// instead of mirroring the peer from its position and bomb messages.
+// Both devices must use the same setting.
+const bool LOCKSTEP_ENABLED = false;
+// With LOCKSTEP_ENABLED: apply our buttons to the very next tick and step
+// the peer on a guess, rolling back when its real input differs.
+const bool LOCKSTEP_ROLLBACK = false;
 
 // HUD / scoring
 int lives = 3;
@@ -119,8 +171,11 @@ const int BTN_BOMB_PIN = 15; // combined Start/Bomb
 // Input timing (tuned for low latency while maintaining debounce)
 const unsigned long DEBOUNCE_MS = 12;
 const unsigned long POLL_MS = 10;
+// Longest idle at the end of a round's loop() (gameIdleMs()), so frames
+// from the peer wait at most this long in the receive queue.
+const unsigned long GAME_IDLE_MAX_MS = 2;
 // Movement repeat when holding a direction (ms between repeated moves)
-const unsigned long MOVE_REPEAT_MS = 150;
+const unsigned long MOVE_REPEAT_MS = 150;  // REMOTE_STEP_MS in remote_player.h
 
 // mapping: bit0=UP, bit1=DOWN, bit2=LEFT, bit3=RIGHT, bit4=BOMB
 uint8_t lastStableFlags = 0;
@@ -156,6 +211,8 @@ void enterGame() {
   spawnInvulEnd = millis() + SPAWN_INVUL_MS;
   // re-init game state when entering game
   initializeGame();
+  state_sync_reset(millis());
+  snapshot_round_start(millis());
   // Position player according to assigned player id.
   // Convention: myPlayerId == 0 -> Player 1 (top-left). Any other id -> Player 2 (bottom-right).
   // store spawn coordinates so respawn returns to this location
@@ -165,7 +222,10 @@ void enterGame() {
     spawnX = MAP_COLS - 2; spawnY = MAP_ROWS - 2;
   }
   playerX = spawnX; playerY = spawnY;
-  // spawnInvulEnd already set before initializeGame
+  // spawnInvulEnd already set before initializeGame (lockstep restates it in game time)
+  if (LOCKSTEP_ENABLED) lockstep_begin(millis(), myPlayerId, !peerReady, LOCKSTEP_ROLLBACK);
+  else lockstep_end();
+  remote_player_reset();
   // Announce ourselves to peer: send JOIN and current position so peer can show us immediately
   send_join(myPlayerId);
   send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
@@ -174,10 +234,14 @@ void enterGame() {
 void enterMenu() {
   gameState = STATE_MENU;
   DBG_PRINTLN("STATE: enter MENU");
+  lockstep_end();
   // optional: show the startup menu if implemented
   // showStartupMenu(display1, display2);
   // Use centralized menu implementation from menu.h
+  waitDisplaysIdle();
   showStartupMenu(display1, display2);
+  flush1.invalidate();
+  flush2.invalidate();
   // Ensure menu buttons are configured (we use combined START/BOMB pin)
   setMenuButtonPins(BTN_BOMB_PIN, -1, -1);
   configureMenuButtons();
@@ -255,7 +319,8 @@ void pollButtonsAndSend(bool menuActive=false) {
     if (menuSel == 1) display1.print("> Settings"); else display1.print("  Settings");
     flushDisplay1(true);
 
-    // periodic background connection check and update right display
+    // periodic update of the right display from the cached link status
+    // (peer_probe_poll() pings in the background)
     if (millis() - lastMenuCheck > 700) {
   lastMenuCheck = millis();
   bool connected = isPlayer2Connected();
@@ -266,6 +331,11 @@ void pollButtonsAndSend(bool menuActive=false) {
       display2.setCursor(4, 20);
       if (connected) display2.print("Player 1: Connected   ");
       else display2.print("Connecting to peers...");
+      if (connected) {
+        display2.setCursor(4, 32);
+        display2.print("RTT "); display2.print(peer_probe().stats.srttMs, 1);
+        display2.print(" ms loss "); display2.print((int)(peer_probe_loss() * 100 + 0.5f)); display2.print("%");
+      }
       flushDisplay2(true);
     }
 
@@ -299,35 +369,37 @@ void pollButtonsAndSend(bool menuActive=false) {
     lastEndFlags = anyNow;
     return;
   }
-  static uint8_t lastSentFlags = 0;
+  // lockstep: the buttons are our input for the next tick, lockstep_poll() moves us
+  if (lockstep().active) {
+    lockstep_set_input(flags);
+    return;
+  }
+  static uint8_t lastFlags = 0;
   static unsigned long lastMoveAt = 0;
   uint8_t inputFlags = flags & 0x1F;
   unsigned long now = millis();
-  bool shouldSend = false;
+  bool stepped = false;
 
   // Immediate response to changes (edge) ------------------------------------------------
-  if (inputFlags != lastSentFlags) {
+  if (inputFlags != lastFlags) {
     int nx = playerX;
     int ny = playerY;
     if (inputFlags & 0x01) ny--;
     if (inputFlags & 0x02) ny++;
     if (inputFlags & 0x04) nx--;
     if (inputFlags & 0x08) nx++;
-    if (nx >= 0 && nx < MAP_COLS && ny >= 0 && ny < MAP_ROWS) {
-      if (mapData[ny][nx] == TILE_EMPTY) { playerX = nx; playerY = ny; }
-    }
-    if ((inputFlags & 0x10) && !(lastSentFlags & 0x10)) {
-      placeBombAtPlayer();
-      for (int i = 0; i < MAX_BOMBS; i++) if (bombs[i].active && bombs[i].placedAt + 5 > now) {
+    if (mapIsWalkable(nx, ny)) { playerX = nx; playerY = ny; }
+    if ((inputFlags & 0x10) && !(lastFlags & 0x10)) {
+      int i = placeBombAtPlayer();
+      if (i >= 0) {
         // send elapsed (age) instead of absolute millis() so peer can
-        // compute remaining fuse using its own clock.
+        // compute remaining fuse using its own clock, and the game time
+        // (clock_sync.h), which also covers the time in flight.
         uint32_t age = (uint32_t)(now - bombs[i].placedAt);
-        send_bomb_place(myPlayerId, i, bombs[i].x, bombs[i].y, age, bombs[i].fuseMs);
-        lastBombPlaceSent[i] = millis();
-        break;
+        send_bomb_place(myPlayerId, bombs[i].netId, bombs[i].x, bombs[i].y, age, bombs[i].fuseMs, clock_game_stamp());
       }
     }
-    shouldSend = true;
+    stepped = true;
     lastMoveAt = now;
   } else {
     if ((inputFlags & 0x0F) != 0 && now - lastMoveAt >= MOVE_REPEAT_MS) {
@@ -337,19 +409,16 @@ void pollButtonsAndSend(bool menuActive=false) {
       if (inputFlags & 0x02) ny++;
       if (inputFlags & 0x04) nx--;
       if (inputFlags & 0x08) nx++;
-      if (nx >= 0 && nx < MAP_COLS && ny >= 0 && ny < MAP_ROWS) {
-        if (mapData[ny][nx] == TILE_EMPTY) { playerX = nx; playerY = ny; }
-      }
-      shouldSend = true;
+      if (mapIsWalkable(nx, ny)) { playerX = nx; playerY = ny; }
+      stepped = true;
       lastMoveAt = now;
     }
   }
 
-  if (shouldSend) {
-    send_input(myPlayerId, millis(), inputFlags);
-    send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
-    lastSentFlags = inputFlags;
-  }
+  if (stepped) lastFlags = inputFlags;
+  // the peer walks us on between reports (remote_player.h), so MSG_POS only
+  // goes out when its picture would be wrong or is due a refresh
+  remote_pos_poll(myPlayerId, playerX, playerY, inputFlags, stepped, now);
 }
 
 
@@ -357,7 +426,11 @@ void pollButtonsAndSend(bool menuActive=false) {
 // This centralizes damage rules. It intentionally ignores bombs present
 // on the tile so standing on your own bomb does NOT grant immunity.
 void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage, int eventId) {
-  unsigned long now = millis();
+  // in lockstep the peer's player is hit here too, by the same rules, and
+  // once a blast has put a player out nobody is hit by later ones
+  if (lockstep_round_decided(eventId)) return;
+  lockstep_on_blast_cell(x, y, ownerId, eventId);
+  unsigned long now = gameMillis();
   if (DEBUG_HITS) {
     DBG_PRINT("DEBUG: damagePlayerAt called force="); DBG_PRINT(forceDamage ? "yes" : "no");
     DBG_PRINT(" now="); DBG_PRINT(now);
@@ -379,7 +452,7 @@ void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage, int eventId
     DBG_PRINT(" player at "); DBG_PRINT(playerX); DBG_PRINT(','); DBG_PRINTLN(playerY);
     // check if a bomb is present on that tile
     bool bombOnTile = false;
-    for (int i = 0; i < MAX_BOMBS; i++) if (bombs[i].active && bombs[i].x == x && bombs[i].y == y) bombOnTile = true;
+    if (bombAt(x, y) >= 0) bombOnTile = true;
     DBG_PRINT("DEBUG: bombOnTile="); DBG_PRINTLN(bombOnTile ? "yes" : "no");
   }
   if (playerX == x && playerY == y) {
@@ -392,7 +465,7 @@ void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage, int eventId
     if (lives > 0) {
       playerHealth = 1; // 1 HP per life
       playerX = spawnX; playerY = spawnY;
-      spawnInvulEnd = millis() + SPAWN_INVUL_MS;
+      spawnInvulEnd = now + SPAWN_INVUL_MS;
     } else {
       // local player has no lives left -> apply death scoring and announce end
       // ownerId is the killer; credit killer +20 and penalize victim -20 locally
@@ -409,8 +482,13 @@ void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage, int eventId
         if (myPlayerId == 0) { score_local = s0; score_remote = s1; }
         else { score_local = s1; score_remote = s0; }
         DBG_PRINTF("PLAYER DIED locally: victim=%u killer=%u (scores now s0=%ld s1=%ld)\n", myPlayerId, ownerId, (long)s0, (long)s1);
-        // send authoritative snapshot to peer
-        send_player_death((uint8_t)myPlayerId, ownerId, s0, s1, myPlayerId);
+        // send authoritative snapshot to peer (a lockstep peer scores it itself)
+        if (!lockstep().active) send_player_death((uint8_t)myPlayerId, ownerId, s0, s1, myPlayerId);
+      }
+      // in lockstep loop() ends the round once this tick can't be rolled back
+      if (lockstep().active) {
+        lockstep_player_out(myPlayerId, eventId);
+        return;
       }
       int winnerId = (myPlayerId == 0) ? 1 : 0;
       uint8_t payload[2];
@@ -424,27 +502,6 @@ void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage, int eventId
   }
 }
 
-// State snapshot from peer (used to announce game end)
-void game_on_state_snapshot(const uint8_t *src_mac, const uint8_t *data, int len) {
-  (void)src_mac;
-  if (!data || len < 2) return;
-  uint8_t code = data[0];
-  if (code == 0x01) {
-    uint8_t winnerId = data[1];
-    finalWinnerId = (int)winnerId;
-    gameOver = true;
-    gameState = STATE_ENDING;
-    DBG_PRINT("RX STATE SNAPSHOT: winner="); DBG_PRINTLN(finalWinnerId);
-  }
-  // MAP sync: payload = [0x02][4 bytes seed LE]
-  else if (code == 0x02 && len >= 5) {
-    unsigned long seed = 0;
-    memcpy(&seed, data + 1, 4);
-    pending_map_seed = seed;
-    DBG_PRINT("RX MAP_SYNC seed="); DBG_PRINTLN(seed);
-  }
-}
-
 //-----------------------------------------------------------------------------
 // Display & UI Functions
 //-----------------------------------------------------------------------------
@@ -520,54 +577,8 @@ void drawFillRectU8(Adafruit_SH1107 &disp, int x, int y, int w, int h) { disp.fi
 
 // Tile drawing and game helpers are provided by game_engine.h
 
-// Render a 128×128 window of the tilemap to the provided display.
-// xPixelOffset = left column (in pixels) of the full map that maps to display x=0.
-void renderMapToDisplay(Adafruit_SH1107 &disp, int xPixelOffset) {
-  int leftTile = xPixelOffset / TILE_SIZE;
-  int xWithin = xPixelOffset % TILE_SIZE;
-  int tilesWide = 128 / TILE_SIZE + 1; // include partial tile
-
-  for (int ry = 0; ry < MAP_ROWS; ry++) {
-    for (int tx = 0; tx < tilesWide; tx++) {
-      int mapCol = leftTile + tx;
-      if (mapCol < 0 || mapCol >= MAP_COLS) continue;
-      int px = tx * TILE_SIZE - xWithin;
-      int py = ry * TILE_SIZE + HUD_HEIGHT;
-      drawTile(disp, px, py, mapData[ry][mapCol]);
-    }
-  }
-
-  // Draw player sprite if visible in this window
-  int playerPixelX = playerX * TILE_SIZE;
-  if (playerPixelX >= xPixelOffset && playerPixelX < xPixelOffset + 128) {
-    int px = playerPixelX - xPixelOffset;
-    int py = playerY * TILE_SIZE + HUD_HEIGHT;
-    const int pw = 6, ph = 6;
-    int pxoff = px + (TILE_SIZE - pw) / 2;
-    int pyoff = py + (TILE_SIZE - ph) / 2;
-    // If spawn invulnerability active, flash the player sprite (toggle every 200ms)
-    unsigned long now = millis();
-    bool spawnInvul = (now < spawnInvulEnd);
-    if (!spawnInvul || ((now / 200) % 2 == 0)) {
-      disp.drawBitmap(pxoff, pyoff, SPRITE_PLAYER_6x6, pw, ph, 1);
-    }
-  }
-  // Draw remote player (if known)
-  if (otherPlayerVisible) {
-    int otherPixelX = otherPlayerX * TILE_SIZE;
-    if (otherPixelX >= xPixelOffset && otherPixelX < xPixelOffset + 128) {
-      int px = otherPixelX - xPixelOffset;
-      int py = otherPlayerY * TILE_SIZE + HUD_HEIGHT;
-      const int pw = 6, ph = 6;
-      int pxoff = px + (TILE_SIZE - pw) / 2;
-      int pyoff = py + (TILE_SIZE - ph) / 2;
-      disp.drawBitmap(pxoff, pyoff, SPRITE_PLAYER_6x6, pw, ph, 1);
-    }
-  }
-}
-
 // HUD rendering - left display (Lives & Title)
-void drawHUDLeft(Adafruit_SH1107 &disp) {
+void drawHUDLeft(PartialSH1107 &disp) {
   disp.setTextSize(1);
   disp.setTextColor(1);
   // Show lives on top-left as small boxes (no text label to save space)
@@ -575,10 +586,11 @@ void drawHUDLeft(Adafruit_SH1107 &disp) {
   int startY = 6;
   for (int i = 0; i < lives; i++) {
     int lx = startX + i * 12;
-    disp.drawBitmap(lx, startY, SPRITE_LIFE_8x6, 8, 6, 1);
+    blitSprite(disp.frameBuffer(), disp.width(), disp.height(), pageSprites().life, lx, startY);
   }
-  // spawn invulnerability indicator (blinks while active)
-  unsigned long now = millis();
+  // spawn invulnerability indicator (blinks while active); spawnInvulEnd is
+  // game time, as in damagePlayerAt()
+  unsigned long now = gameMillis();
   if (now < spawnInvulEnd) {
     if ((now / 300) % 2 == 0) {
       disp.fillRect(4 + lives * 12, startY, 8, 6, 1);
@@ -598,7 +610,7 @@ void drawHUDLeft(Adafruit_SH1107 &disp) {
 }
 
 // HUD rendering - right display (Score & Bombs)
-void drawHUDRight(Adafruit_SH1107 &disp) {
+void drawHUDRight(PartialSH1107 &disp) {
   // Dedicated HUD for second display: Title + Hearts + YOU/THEM scores
   disp.setTextSize(2);
   disp.setTextColor(1);
@@ -613,7 +625,7 @@ void drawHUDRight(Adafruit_SH1107 &disp) {
   int heartY = 28;
   for (int i = 0; i < lives; i++) {
     int hx = 12 + i * 16;
-    disp.drawBitmap(hx, heartY, SPRITE_LIFE_8x6, 8, 6, 1);
+    blitSprite(disp.frameBuffer(), disp.width(), disp.height(), pageSprites().life, hx, heartY);
   }
 
   // Scores
@@ -624,8 +636,7 @@ void drawHUDRight(Adafruit_SH1107 &disp) {
   disp.print("THEM:"); disp.print(score_remote);
 
   // Bombs available small indicator at top-right
-  int freeBombs = 0;
-  for (int i = 0; i < MAX_BOMBS; i++) if (!bombs[i].active) freeBombs++;
+  int freeBombs = bombFreeCount();
   disp.setCursor(90, 56);
   disp.print("B:"); disp.print(freeBombs);
 }
@@ -638,6 +649,9 @@ void setup() {
   // Initialize displays
   display1.begin(0x3C); // typical SH110x address; adjust if different
   display2.begin(0x3C);
+  // flush tasks on core 0, next to WiFi; the game loop keeps core 1
+  flush1.begin("flush1", 0);
+  flush2.begin("flush2", 0);
   display1.clearDisplay();
   display2.clearDisplay();
 
@@ -695,9 +709,8 @@ void addScore(uint8_t owner, int points) {
   // debug: print attribution info
   DBG_PRINTF("addScore: owner=%u myPlayerId=%u points=%d\n", owner, myPlayerId, points);
   if (owner == myPlayerId) {
+    // resolveBlast() sends the peer the score update for the chain
     score_local += points;
-    // send score update to peer so both devices display the same scores
-    send_score_update(owner, (int16_t)points, myPlayerId);
   } else {
     score_remote += points;
   }
@@ -712,151 +725,56 @@ void resetScores() {
   score = score_local;
 }
 
-// -- Game packet handlers (called from espnow_game parser)
-void game_on_input(const uint8_t *src_mac, const MsgInput *m) {
-  if (!m) return;
-  uint8_t f = m->inputFlags;
-  if (!otherPlayerVisible) {
-    if (m->h.fromId == 0) { otherPlayerX = 1; otherPlayerY = 1; }
-    else { otherPlayerX = MAP_COLS - 2; otherPlayerY = MAP_ROWS - 2; }
-    otherPlayerVisible = true;
-  }
-  int nx = otherPlayerX;
-  int ny = otherPlayerY;
-  if (f & 0x01) ny--;
-  if (f & 0x02) ny++;
-  if (f & 0x04) nx--;
-  if (f & 0x08) nx++;
-  if (nx >= 0 && nx < MAP_COLS && ny >= 0 && ny < MAP_ROWS) {
-    if (mapData[ny][nx] == TILE_EMPTY) { otherPlayerX = nx; otherPlayerY = ny; }
-  }
-  // remote bomb visual (authoritative bomb should arrive via MSG_BOMB_PLACE)
-  DBG_PRINT("RX INPUT flags="); DBG_PRINTLN(f);
-}
+// -- Game packet handlers (called from espnow_game parser) are in
+// game_handlers.h; this is the sketch's side of them
+bool game_waiting_for_peer() { return gameState == STATE_WAITING; }
 
-void game_on_pos(const uint8_t *src_mac, const MsgPos *m) {
-  if (!m) return;
-  otherPlayerX = m->px;
-  otherPlayerY = m->py;
-  otherPlayerVisible = true;
-}
+bool game_round_running() { return gameState == STATE_GAME && !gameOver; }
 
-void game_on_bomb_place(const uint8_t *src_mac, const MsgBombPlace *m) {
-  if (!m) return;
-  // The sender transmits the age (ms since placement) instead of its
-  // absolute millis() to avoid requiring synchronized clocks. Interpret
-  // m->placedMs as "age" here.
-  unsigned long age = (unsigned long)m->placedMs;
-  if (age >= (unsigned long)m->fuseMs) {
-    unsigned long delta = age - (unsigned long)m->fuseMs;
-    if (delta <= BOMB_STALE_THRESHOLD_MS) {
-      unsigned long placedAt = millis() - (m->fuseMs - BOMB_MIN_REMAIN_MS);
-      for (int i = 0; i < MAX_BOMBS; i++) {
-        if (!bombs[i].active) {
-          bombs[i].active = true;
-          bombs[i].x = m->x;
-          bombs[i].y = m->y;
-          bombs[i].fuseMs = m->fuseMs;
-          bombs[i].placedAt = placedAt;
-          bombs[i].owner = m->h.fromId;
-          DBG_PRINT("RX BOMB PLACE (slightly expired, scheduling) id="); DBG_PRINTLN(m->bombId);
-          return;
-        }
-      }
-      return;
-    } else {
-      DBG_PRINT("RX BOMB PLACE (stale) id="); DBG_PRINTLN(m->bombId);
-      explodeAt(m->x, m->y, m->h.fromId);
-      return;
-    }
-  }
-  for (int i = 0; i < MAX_BOMBS; i++) {
-    if (!bombs[i].active) {
-      bombs[i].active = true;
-      bombs[i].x = m->x;
-      bombs[i].y = m->y;
-      bombs[i].fuseMs = m->fuseMs;
-      bombs[i].placedAt = millis() - age;
-      // attribute this remote bomb to the sender
-      bombs[i].owner = m->h.fromId;
-      DBG_PRINT("RX BOMB PLACE id="); DBG_PRINT(m->bombId);
-      DBG_PRINT(" age="); DBG_PRINT(age);
-      DBG_PRINT(" fuse="); DBG_PRINTLN(m->fuseMs);
-      return;
-    }
-  }
-}
-
-void game_on_bomb_explode(const uint8_t *src_mac, const MsgBombExplode *m) {
-  if (!m) return;
-  DBG_PRINT("RX BOMB EXPLODE id="); DBG_PRINTLN(m->bombId);
-  explodeAt(m->cx, m->cy, m->h.fromId);
-}
-
-// Score update received from peer
-void game_on_score_update(const uint8_t *src_mac, const MsgScoreUpdate *m) {
-  if (!m) return;
-  DBG_PRINTF("RX SCORE UPDATE owner=%u delta=%d from=%u\n", m->owner, m->delta, m->h.fromId);
-  if (m->owner == myPlayerId) score_local += m->delta;
-  else score_remote += m->delta;
-  score = score_local;
-  DBG_PRINTF("scores after RX: local=%ld remote=%ld\n", score_local, score_remote);
-}
-
-// Player death reported by peer (or by local device as broadcast)
-void game_on_player_death(const uint8_t *src_mac, const MsgPlayerDeath *m) {
-  if (!m) return;
-  DBG_PRINTF("RX PLAYER DEATH victim=%u killer=%u from=%u s0=%ld s1=%ld\n", m->victimId, m->killerId, m->h.fromId, (long)m->score0, (long)m->score1);
-  // Apply authoritative snapshot from the sender. Map score0/score1 into local
-  // score_local/score_remote depending on our myPlayerId.
-  if (myPlayerId == 0) {
-    score_local = m->score0;
-    score_remote = m->score1;
-  } else {
-    score_local = m->score1;
-    score_remote = m->score0;
-  }
-  score = score_local;
-  DBG_PRINTF("scores after DEATH snapshot applied: local=%ld remote=%ld\n", score_local, score_remote);
+void game_ended_by_peer(int winnerId) {
+  finalWinnerId = winnerId;
+  gameOver = true;
+  gameState = STATE_ENDING;
 }
 
 // Called by game_engine when a local bomb is about to explode (weak hook implementation)
-void on_local_bomb_exploded(int cx, int cy, int bombId) {
-  send_bomb_explode(myPlayerId, (uint16_t)bombId, (uint8_t)cx, (uint8_t)cy, (uint32_t)millis());
+void on_local_blast_resolved(const BlastResult &r) {
+  // Notify peer once per chain: it holds the same bombs, so detonating its
+  // copy of the root bomb reproduces the whole cascade there. A chain rooted
+  // at the peer's bomb is the peer's to announce; its id is only unique per
+  // owner and would name one of our own bombs on the other side.
+  // In lockstep the peer steps the same fuse itself.
+  const BlastSource &root = r.sources[0];
+  if (lockstep().active || bombs[root.slot].owner != myPlayerId) return;
+  send_bomb_explode(myPlayerId, bombs[root.slot].netId, root.x, root.y, clock_game_stamp());
 }
 
 
-void game_on_join(const uint8_t *src_mac, const GameHdr *h, const uint8_t *payload, int payloadLen) {
-  (void)payload; (void)payloadLen;
-  if (h->fromId == 0) { otherPlayerX = 1; otherPlayerY = 1; }
-  else { otherPlayerX = MAP_COLS - 2; otherPlayerY = MAP_ROWS - 2; }
-  otherPlayerVisible = true;
-  send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
-}
-
-void game_on_heartbeat(const uint8_t *src_mac, const GameHdr *h) {
-  (void)src_mac;
-  // mark peer presence only if we're in the waiting state
-  if (gameState == STATE_WAITING) {
-    // if this is the first time we see their ready since entering waiting, reply once
-    if (!peerReady) {
-      peerReady = true;
-      peerReadyAt = millis();
-      // reply so the sender knows we saw them (quick two-way handshake)
-      send_ready(myPlayerId);
-      DBG_PRINT("RX READY (first) from "); DBG_PRINTLN(h->fromId);
-    } else {
-      // already marked ready; refresh timestamp only
-      peerReadyAt = millis();
-      DBG_PRINT("RX READY (refresh) from "); DBG_PRINTLN(h->fromId);
-    }
-  } else {
-    DBG_PRINT("RX READY (ignored, not waiting) from "); DBG_PRINTLN(h->fromId);
-  }
+// How long loop() may idle during a round: until the next bomb timer is
+// due (msUntilNextTimer()) or the next button poll, at most GAME_IDLE_MAX_MS.
+unsigned long gameIdleMs(unsigned long now) {
+  unsigned long idle = GAME_IDLE_MAX_MS;
+  unsigned long sincePoll = now - lastPollMs;
+  if (sincePoll >= POLL_MS) return 0;
+  if (POLL_MS - sincePoll < idle) idle = POLL_MS - sincePoll;
+  long untilTimer = msUntilNextTimer(gameMillis());
+  if (untilTimer >= 0 && (unsigned long)untilTimer < idle) idle = (unsigned long)untilTimer;
+  return idle;
 }
 
 void loop() {
   unsigned long now = millis();
+  // everything sent during this iteration leaves as one frame (per 250 bytes)
+  NetBatchScope batch;
+
+  // apply what the peer sent since the last iteration (queued by the
+  // ESP-NOW callback), then ack it and retransmit what is still unacked
+  espnow_poll_rx();
+  reliable_poll(now, myPlayerId);
+  peer_probe_poll(now);
+  clock_sync_poll(now);
+  // a 'T' on Serial dumps the link counters (telemetry_dump.h)
+  telemetry_serial_poll(now, myPlayerId);
 
   // poll buttons (menuActive depends on gameState)
   pollButtonsAndSend(gameState == STATE_MENU);
@@ -871,18 +789,21 @@ void loop() {
       delay(100); // quicker update when game over (more responsive)
       return;
     }
-    updateBombs();
-
-    // Retransmit active local bomb placements periodically so peers stay in sync
-    for (int i = 0; i < MAX_BOMBS; i++) {
-      if (!bombs[i].active) continue;
-      if (bombs[i].owner != myPlayerId) continue;
-      unsigned long nowSend = millis();
-      if (nowSend - lastBombPlaceSent[i] >= BOMB_PLACE_RESEND_MS) {
-        uint32_t age = (uint32_t)(millis() - bombs[i].placedAt);
-        send_bomb_place(myPlayerId, i, bombs[i].x, bombs[i].y, age, bombs[i].fuseMs);
-        lastBombPlaceSent[i] = nowSend;
+    // send our state digest every STATE_SYNC_INTERVAL_MS once the peer is in the round
+    if (otherPlayerVisible && !lockstep().active) state_sync_poll(now, myPlayerId);
+    snapshot_poll(now, myPlayerId);
+    // lockstep steps the engine (updateBombs() included) tick by tick
+    if (lockstep().active) {
+      lockstep_poll(now);
+      int winnerId;
+      if (lockstep_round_result(&winnerId)) {
+        finalWinnerId = winnerId;
+        gameOver = true;
+        gameState = STATE_ENDING;
       }
+    } else {
+      updateBombs();
+      remote_player_update(now);
     }
 
   // Render gameplay view to the first display (centered on player)
@@ -894,16 +815,22 @@ void loop() {
   if (maxOffset < 0) maxOffset = 0;
   if (xOffset > maxOffset) xOffset = maxOffset;
 
-  // Draw native-size viewport (no sprite stretching) centered on player
-  display1.clearDisplay();
-  renderMapToDisplay(display1, xOffset);
-  renderBombsAndExplosions(display1, xOffset);
+  // Draw native-size viewport (no sprite stretching) centered on player.
+  // Only tiles that changed are redrawn, and only their pages/columns are sent.
+  renderDirtyTiles(display1, xOffset);
   flushDisplay1();
 
   // Render dedicated HUD to the second display (title, hearts, scores)
   display2.clearDisplay();
   drawHUDRight(display2);
   flushDisplay2();
+
+  // nothing to do before the next timer or button poll; lockstep keeps its
+  // own tick schedule
+  if (!lockstep().active) {
+    unsigned long idle = gameIdleMs(millis());
+    if (idle > 0) delay(idle);
+  }
   } else if (gameState == STATE_ENDING) {
     showGameOver();
     drawReturnToMenuPrompt();
@@ -999,14 +926,15 @@ void enterWaiting() {
   display2.setCursor(4, 20); display2.print("Ready sent..."); flushDisplay2(true);
 }
 
-// helper: draw a bitmap from PROGMEM scaled to destination rect using nearest-neighbor
+// helper: draw a bitmap from PROGMEM scaled to destination rect using nearest-neighbor.
+// Only used when the scaled size is too big for a PageSprite (see renderFullMapView()).
 static void drawSpriteScaled(Adafruit_SH1107 &disp, const uint8_t *bmp, int bw, int bh, int destX, int destY, int destW, int destH) {
   if (!bmp || bw <= 0 || bh <= 0 || destW <= 0 || destH <= 0) return;
   for (int dy = 0; dy < destH; dy++) {
     int sy = (dy * bh) / destH;
+    uint8_t row = pgm_read_byte(&bmp[sy]);
     for (int dx = 0; dx < destW; dx++) {
       int sx = (dx * bw) / destW;
-      uint8_t row = pgm_read_byte(&bmp[sy]);
       int bitIndex = 7 - sx; if (bitIndex < 0) bitIndex = 0;
       bool on = (row >> bitIndex) & 0x01;
       if (on) disp.drawPixel(destX + dx, destY + dy, 1);
@@ -1016,7 +944,7 @@ static void drawSpriteScaled(Adafruit_SH1107 &disp, const uint8_t *bmp, int bw,
 
 // Render the entire map scaled to exactly fill the 128x128 display (non-uniform integer scaling)
 // This makes the arena occupy the full LCD area. Tiles may be stretched if MAP_ROWS != MAP_COLS.
-void renderFullMapView(Adafruit_SH1107 &disp) {
+void renderFullMapView(PartialSH1107 &disp) {
   int scaleX = max(1, 128 / MAP_COLS); // horizontal pixels per tile
   int scaleY = max(1, 128 / MAP_ROWS); // vertical pixels per tile
   int mapW = MAP_COLS * scaleX;
@@ -1024,6 +952,20 @@ void renderFullMapView(Adafruit_SH1107 &disp) {
   int x0 = (128 - mapW) / 2; if (x0 < 0) x0 = 0;
   int y0 = (128 - mapH) / 2; if (y0 < 0) y0 = 0;
 
+  // Sprites pre-scaled to one tile, built on first use. If a tile is larger
+  // than a PageSprite can hold, fall back to per-pixel drawSpriteScaled().
+  static SpriteSet scaled;
+  static int scaledOk = -1;
+  if (scaledOk < 0) {
+    scaledOk = pageSpriteBuild(scaled.solid, SPRITE_SOLID_8x8, 8, 8, scaleX, scaleY) &&
+               pageSpriteBuild(scaled.breakable, SPRITE_BREAK_8x8, 8, 8, scaleX, scaleY) &&
+               pageSpriteBuild(scaled.bomb, SPRITE_BOMB_6x6, 6, 6, scaleX, scaleY) &&
+               pageSpriteBuild(scaled.explode, SPRITE_EXPLODE_8x8, 8, 8, scaleX, scaleY) &&
+               pageSpriteBuild(scaled.player, SPRITE_PLAYER_6x6, 6, 6, scaleX, scaleY);
+  }
+  uint8_t *fb = scaledOk ? disp.frameBuffer() : nullptr;
+  int fbW = disp.width(), fbH = disp.height();
+
   // tiles (use 8x8 sprites stretched to tile rect)
   for (int ry = 0; ry < MAP_ROWS; ry++) {
     for (int cx = 0; cx < MAP_COLS; cx++) {
@@ -1032,9 +974,11 @@ void renderFullMapView(Adafruit_SH1107 &disp) {
       Tile t = mapData[ry][cx];
       if (t == TILE_EMPTY) continue;
       if (t == TILE_SOLID) {
-        drawSpriteScaled(disp, SPRITE_SOLID_8x8, 8, 8, tx, ty, scaleX, scaleY);
+        if (fb) blitSprite(fb, fbW, fbH, scaled.solid, tx, ty);
+        else drawSpriteScaled(disp, SPRITE_SOLID_8x8, 8, 8, tx, ty, scaleX, scaleY);
       } else if (t == TILE_BREAKABLE) {
-        drawSpriteScaled(disp, SPRITE_BREAK_8x8, 8, 8, tx, ty, scaleX, scaleY);
+        if (fb) blitSprite(fb, fbW, fbH, scaled.breakable, tx, ty);
+        else drawSpriteScaled(disp, SPRITE_BREAK_8x8, 8, 8, tx, ty, scaleX, scaleY);
       }
     }
   }
@@ -1044,29 +988,34 @@ void renderFullMapView(Adafruit_SH1107 &disp) {
     if (!bombs[i].active) continue;
     int bx = x0 + bombs[i].x * scaleX;
     int by = y0 + bombs[i].y * scaleY;
-    drawSpriteScaled(disp, SPRITE_BOMB_6x6, 6, 6, bx, by, scaleX, scaleY);
+    if (fb) blitSprite(fb, fbW, fbH, scaled.bomb, bx, by);
+    else drawSpriteScaled(disp, SPRITE_BOMB_6x6, 6, 6, bx, by, scaleX, scaleY);
   }
 
   // explosions
   unsigned long now = millis();
-  for (int i = 0; i < MAX_EXPLOSION_CELLS; i++) {
-    if (explosions[i].endAt == 0) continue;
-    if (now > explosions[i].endAt) continue;
-    int ex = x0 + explosions[i].x * scaleX;
-    int ey = y0 + explosions[i].y * scaleY;
-    drawSpriteScaled(disp, SPRITE_EXPLODE_8x8, 8, 8, ex, ey, scaleX, scaleY);
+  for (int i = 0; i < explosions.activeCount; i++) {
+    int cell = explosions.active[i];
+    int cx = cell % MAP_COLS, cy = cell / MAP_COLS;
+    if (now > explosions.endAt[cy][cx]) continue;
+    int ex = x0 + cx * scaleX;
+    int ey = y0 + cy * scaleY;
+    if (fb) blitSprite(fb, fbW, fbH, scaled.explode, ex, ey);
+    else drawSpriteScaled(disp, SPRITE_EXPLODE_8x8, 8, 8, ex, ey, scaleX, scaleY);
   }
 
   // local player
   int ppx = x0 + playerX * scaleX;
   int ppy = y0 + playerY * scaleY;
-  drawSpriteScaled(disp, SPRITE_PLAYER_6x6, 6, 6, ppx, ppy, scaleX, scaleY);
+  if (fb) blitSprite(fb, fbW, fbH, scaled.player, ppx, ppy);
+  else drawSpriteScaled(disp, SPRITE_PLAYER_6x6, 6, 6, ppx, ppy, scaleX, scaleY);
 
   // remote player
   if (otherPlayerVisible) {
     int opx = x0 + otherPlayerX * scaleX;
     int opy = y0 + otherPlayerY * scaleY;
-    drawSpriteScaled(disp, SPRITE_PLAYER_6x6, 6, 6, opx, opy, scaleX, scaleY);
+    if (fb) blitSprite(fb, fbW, fbH, scaled.player, opx, opy);
+    else drawSpriteScaled(disp, SPRITE_PLAYER_6x6, 6, 6, opx, opy, scaleX, scaleY);
     // outline remote player box for contrast
     disp.drawRect(opx, opy, scaleX, scaleY, 1);
   }
@@ -5,6 +5,10 @@
 #include <Arduino.h>
 #include <esp_now.h>
 #include "espnow_net.h"
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
 
 // Message types
 enum MsgType : uint8_t {
@@ -19,22 +23,35 @@ enum MsgType : uint8_t {
   MSG_STATE_SNAPSHOT = 9,
   MSG_SCORE_UPDATE = 10,
   MSG_PLAYER_DEATH = 11,
+  MSG_BATCH = 12,
+  MSG_STATE_HASH = 13,
   MSG_ACK = 200
 };
 
 // Packet header
 struct __attribute__((packed)) GameHdr { uint8_t type; uint16_t seq; uint8_t fromId; };
 
-// Player input
-struct __attribute__((packed)) MsgInput { GameHdr h; uint32_t clientTick; uint8_t inputFlags; uint8_t reserved; };
+// Player input for tick clientTick. The low 7 bits of `history` count the
+// input bytes that follow the struct, for clientTick - 1, clientTick - 2, ...
+// (resent by lockstep.h in case earlier messages were lost). With
+// INPUT_HAS_ACK set they are followed by a uint32_t tick: the sender holds
+// our inputs for every tick before it.
+struct __attribute__((packed)) MsgInput { GameHdr h; uint32_t clientTick; uint8_t inputFlags; uint8_t history; };
+const uint8_t INPUT_HISTORY_MASK = 0x7F;
+const uint8_t INPUT_HAS_ACK = 0x80;
+inline int input_history(const MsgInput *m) { return m->history & INPUT_HISTORY_MASK; }
+inline int input_trailer_len(const MsgInput *m) { return input_history(m) + ((m->history & INPUT_HAS_ACK) ? 4 : 0); }
 
 // Position update (unreliable)
 struct __attribute__((packed)) MsgPos { GameHdr h; uint8_t px; uint8_t py; uint8_t dir; int8_t vx; int8_t vy; };
 
-// Bomb placement (reliable)
-struct __attribute__((packed)) MsgBombPlace { GameHdr h; uint16_t bombId; uint8_t x, y; uint32_t placedMs; uint16_t fuseMs; };
+// Bomb placement (reliable). placedMs is the bomb's age when sent (kept up
+// to date on retransmits); placedGameMs the game time it was placed at
+// (clock_sync.h), 0 if the sender has none.
+struct __attribute__((packed)) MsgBombPlace { GameHdr h; uint16_t bombId; uint8_t x, y; uint32_t placedMs; uint16_t fuseMs; uint32_t placedGameMs; };
 
-// Bomb explosion (reliable)
+// Bomb explosion (reliable). explodeMs is the game time of the blast, 0 if
+// the sender has none.
 struct __attribute__((packed)) MsgBombExplode { GameHdr h; uint16_t bombId; uint8_t cx, cy; uint32_t explodeMs; };
 
 // Score update (delta applied to the owner)
@@ -45,12 +62,25 @@ struct __attribute__((packed)) MsgScoreUpdate { GameHdr h; uint8_t owner; int16_
 // the updated absolute scores for player0 and player1 so peers can sync.
 struct __attribute__((packed)) MsgPlayerDeath { GameHdr h; uint8_t victimId; uint8_t killerId; int32_t score0; int32_t score1; };
 
-// ACK for reliable messages
-struct __attribute__((packed)) MsgAck { GameHdr h; uint16_t ackSeq; uint8_t reserved; };
+// ACK for reliable messages: acks ackSeq and `extra` more seqs, sent as
+// uint16_t values right after the struct (selective ack, see espnow_reliable.h)
+struct __attribute__((packed)) MsgAck { GameHdr h; uint16_t ackSeq; uint8_t extra; };
 
-// Sequence generator
-static uint16_t game_seq_counter = 1;
-inline uint16_t next_game_seq() { return game_seq_counter++; }
+// Digest of the shared state (unreliable, see state_sync.h): the Zobrist
+// hash of each band of map rows folded to 16 bits, of the active bombs and
+// of both scores, and how long the sender's round has been running.
+const int STATE_HASH_REGIONS = 8;
+struct __attribute__((packed)) MsgStateHash { GameHdr h; uint16_t region[STATE_HASH_REGIONS]; uint32_t bombs; uint32_t scores; uint32_t roundMs; };
+
+// Several messages in one frame: GameHdr, then for each message a length
+// byte followed by the complete message (its own GameHdr included).
+const size_t BATCH_MAX_FRAME = ESP_NOW_MAX_DATA_LEN;
+
+// Sequence generator (one counter however many files include this)
+inline uint16_t next_game_seq() {
+  static uint16_t counter = 1;
+  return counter++;
+}
 
 // Weak handlers you can implement in your sketch to receive game events
 extern void game_on_join(const uint8_t *src_mac, const GameHdr *h, const uint8_t *payload, int payloadLen) __attribute__((weak));
@@ -61,19 +91,103 @@ extern void game_on_pos(const uint8_t *src_mac, const MsgPos *m) __attribute__((
 extern void game_on_score_update(const uint8_t *src_mac, const MsgScoreUpdate *m) __attribute__((weak));
 extern void game_on_player_death(const uint8_t *src_mac, const MsgPlayerDeath *m) __attribute__((weak));
 extern void game_on_state_snapshot(const uint8_t *src_mac, const uint8_t *data, int len) __attribute__((weak));
+extern void game_on_state_hash(const uint8_t *src_mac, const MsgStateHash *m) __attribute__((weak));
 extern void game_on_ack(const uint8_t *src_mac, const MsgAck *m) __attribute__((weak));
 extern void game_on_heartbeat(const uint8_t *src_mac, const GameHdr *h) __attribute__((weak));
 
-// Send helpers (fire-and-forget; caller may add reliability wrappers)
-inline bool send_raw_to_peer(const uint8_t *buf, size_t len) {
+// Outgoing batcher. Between net_batch_begin() and net_batch_flush() every
+// message from the task that opened the batch is appended to one frame
+// instead of being sent (a full frame is sent early); the sketch opens one
+// batch per loop() with a NetBatchScope. Messages sent from other tasks
+// (the ESP-NOW receive callback) go out immediately. A batch holding a single
+// message is sent as that message, without the MSG_BATCH wrapper.
+struct NetBatch {
+  bool open;
+  void *owner;
+  size_t len;
+  int count;
+  uint8_t buf[BATCH_MAX_FRAME];
+  // statistics
+  unsigned long messages;  // messages handed to send_raw_to_peer()
+  unsigned long frames;    // frames given to the transport
+  unsigned long batched;   // frames that carried more than one message
+};
+inline NetBatch &net_batch() { static NetBatch b = {}; return b; }
+
+inline void *net_current_task() {
+#if defined(ESP32)
+  return (void *)xTaskGetCurrentTaskHandle();
+#else
+  return nullptr;
+#endif
+}
+
+inline bool send_frame_to_peer(const uint8_t *buf, size_t len) {
   uint8_t *peer = espnow_get_peer_mac();
   // refuse if peer not configured
   bool zero = true; for (int i=0;i<6;i++) if (peer[i]!=0) { zero=false; break; }
   if (zero) return false;
-  esp_err_t r = esp_now_send(peer, buf, len);
-  return (r == ESP_OK);
+  net_batch().frames++;
+  return net_send(peer, buf, len);
 }
 
+inline bool net_batch_flush() {
+  NetBatch &b = net_batch();
+  if (b.count == 0) return true;
+  bool ok;
+  if (b.count == 1) {
+    ok = send_frame_to_peer(b.buf + sizeof(GameHdr) + 1, b.buf[sizeof(GameHdr)]);
+  } else {
+    GameHdr *h = (GameHdr *)b.buf;
+    h->type = MSG_BATCH; h->seq = next_game_seq(); h->fromId = ((const GameHdr *)(b.buf + sizeof(GameHdr) + 1))->fromId;
+    b.batched++;
+    telemetry_count_tx(MSG_BATCH);
+    ok = send_frame_to_peer(b.buf, b.len);
+  }
+  b.len = sizeof(GameHdr);
+  b.count = 0;
+  return ok;
+}
+
+inline void net_batch_begin() {
+  NetBatch &b = net_batch();
+  b.open = true;
+  b.owner = net_current_task();
+  b.len = sizeof(GameHdr);
+  b.count = 0;
+}
+
+inline void net_batch_end() {
+  net_batch_flush();
+  net_batch().open = false;
+}
+
+// Opens a batch for the lifetime of the object, so every return path of
+// loop() sends what it queued.
+struct NetBatchScope {
+  NetBatchScope() { net_batch_begin(); }
+  ~NetBatchScope() { net_batch_end(); }
+};
+
+// Send helpers. Bomb place/explode, score, death and snapshot messages go
+// through the reliable channel (espnow_reliable.h); the rest are fire-and-forget.
+// All of them end up here and are batched while a batch is open.
+inline bool send_raw_to_peer(const uint8_t *buf, size_t len) {
+  NetBatch &b = net_batch();
+  b.messages++;
+  if (len) telemetry_count_tx(buf[0]);
+  if (!b.open || b.owner != net_current_task() || len > 255 || sizeof(GameHdr) + 1 + len > BATCH_MAX_FRAME)
+    return send_frame_to_peer(buf, len);
+  if (b.len + 1 + len > BATCH_MAX_FRAME) net_batch_flush();
+  b.buf[b.len++] = (uint8_t)len;
+  memcpy(b.buf + b.len, buf, len);
+  b.len += len;
+  b.count++;
+  return true;
+}
+
+#include "espnow_reliable.h"
+
 inline bool send_join(uint8_t fromId) {
   uint8_t pkt[sizeof(GameHdr)];
   GameHdr *h = (GameHdr*)pkt;
@@ -84,29 +198,44 @@ inline bool send_join(uint8_t fromId) {
 inline bool send_ack(uint16_t ackSeq, uint8_t fromId) {
   MsgAck m;
   m.h.type = MSG_ACK; m.h.seq = next_game_seq(); m.h.fromId = fromId;
-  m.ackSeq = ackSeq; m.reserved = 0;
+  m.ackSeq = ackSeq; m.extra = 0;
   return send_raw_to_peer((uint8_t*)&m, sizeof(m));
 }
 
 inline bool send_input(uint8_t fromId, uint32_t clientTick, uint8_t inputFlags) {
   MsgInput m;
   m.h.type = MSG_INPUT; m.h.seq = next_game_seq(); m.h.fromId = fromId;
-  m.clientTick = clientTick; m.inputFlags = inputFlags; m.reserved = 0;
+  m.clientTick = clientTick; m.inputFlags = inputFlags; m.history = 0;
   return send_raw_to_peer((uint8_t*)&m, sizeof(m));
 }
 
-inline bool send_bomb_place(uint8_t fromId, uint16_t bombId, uint8_t x, uint8_t y, uint32_t placedMs, uint16_t fuseMs) {
+// Input for clientTick (flags[0]) and the `history` ticks before it
+// (flags[1] ... flags[history], at most INPUT_HISTORY_MASK), in one message,
+// with the tick before which we hold all of the peer's inputs.
+inline bool send_input_window(uint8_t fromId, uint32_t clientTick, const uint8_t *flags, uint8_t history, uint32_t ackTick) {
+  uint8_t buf[sizeof(MsgInput) + INPUT_HISTORY_MASK + 4];
+  MsgInput *m = (MsgInput*)buf;
+  if (history > INPUT_HISTORY_MASK) history = INPUT_HISTORY_MASK;
+  m->h.type = MSG_INPUT; m->h.seq = next_game_seq(); m->h.fromId = fromId;
+  m->clientTick = clientTick; m->inputFlags = flags[0]; m->history = (uint8_t)(history | INPUT_HAS_ACK);
+  memcpy(buf + sizeof(MsgInput), flags + 1, history);
+  memcpy(buf + sizeof(MsgInput) + history, &ackTick, 4);
+  return send_raw_to_peer(buf, sizeof(MsgInput) + history + 4);
+}
+
+inline bool send_bomb_place(uint8_t fromId, uint16_t bombId, uint8_t x, uint8_t y, uint32_t placedMs, uint16_t fuseMs, uint32_t placedGameMs) {
   MsgBombPlace m;
-  m.h.type = MSG_BOMB_PLACE; m.h.seq = next_game_seq(); m.h.fromId = fromId;
-  m.bombId = bombId; m.x = x; m.y = y; m.placedMs = placedMs; m.fuseMs = fuseMs;
-  return send_raw_to_peer((uint8_t*)&m, sizeof(m));
+  m.h.type = MSG_BOMB_PLACE; m.h.fromId = fromId;
+  m.bombId = bombId; m.x = x; m.y = y; m.placedMs = placedMs; m.fuseMs = fuseMs; m.placedGameMs = placedGameMs;
+  return reliable_send((uint8_t*)&m, sizeof(m));
 }
 
 inline bool send_bomb_explode(uint8_t fromId, uint16_t bombId, uint8_t cx, uint8_t cy, uint32_t explodeMs) {
   MsgBombExplode m;
-  m.h.type = MSG_BOMB_EXPLODE; m.h.seq = next_game_seq(); m.h.fromId = fromId;
+  m.h.type = MSG_BOMB_EXPLODE; m.h.fromId = fromId;
   m.bombId = bombId; m.cx = cx; m.cy = cy; m.explodeMs = explodeMs;
-  return send_raw_to_peer((uint8_t*)&m, sizeof(m));
+  reliable_cancel_bomb_place(bombId);
+  return reliable_send((uint8_t*)&m, sizeof(m));
 }
 
 inline bool send_ready(uint8_t fromId) {
@@ -125,37 +254,58 @@ inline bool send_pos(uint8_t fromId, uint8_t px, uint8_t py, uint8_t dir = 0, in
 
 inline bool send_score_update(uint8_t owner, int16_t delta, uint8_t fromId) {
   MsgScoreUpdate m;
-  m.h.type = MSG_SCORE_UPDATE; m.h.seq = next_game_seq(); m.h.fromId = fromId;
+  m.h.type = MSG_SCORE_UPDATE; m.h.fromId = fromId;
   m.owner = owner; m.delta = delta;
-  return send_raw_to_peer((uint8_t*)&m, sizeof(m));
+  return reliable_send((uint8_t*)&m, sizeof(m));
 }
 
 inline bool send_player_death(uint8_t victimId, uint8_t killerId, int32_t score0, int32_t score1, uint8_t fromId) {
   MsgPlayerDeath m;
-  m.h.type = MSG_PLAYER_DEATH; m.h.seq = next_game_seq(); m.h.fromId = fromId;
+  m.h.type = MSG_PLAYER_DEATH; m.h.fromId = fromId;
   m.victimId = victimId; m.killerId = killerId; m.score0 = score0; m.score1 = score1;
+  return reliable_send((uint8_t*)&m, sizeof(m));
+}
+
+inline bool send_state_hash(uint8_t fromId, const uint16_t region[STATE_HASH_REGIONS], uint32_t bombs, uint32_t scores, uint32_t roundMs) {
+  MsgStateHash m;
+  m.h.type = MSG_STATE_HASH; m.h.seq = next_game_seq(); m.h.fromId = fromId;
+  memcpy(m.region, region, sizeof(m.region)); m.bombs = bombs; m.scores = scores; m.roundMs = roundMs;
   return send_raw_to_peer((uint8_t*)&m, sizeof(m));
 }
 
-// State snapshot: beware of size; keep under 1400 bytes to avoid fragmentation issues
+// State snapshot: one frame at most. Payloads up to RELIABLE_MAX_LEN are
+// resent until acked, larger ones go out once; the full game state is cut
+// into fragments by state_snapshot.h.
 inline bool send_state_snapshot(const uint8_t *data, size_t len, uint8_t fromId) {
-  if (len + sizeof(GameHdr) > 1450) return false; // avoid big packets here
-  // allocate on stack only for small len; if bigger, caller should fragment
-  uint8_t buf[1500];
+  if (len + sizeof(GameHdr) + RELIABLE_TRAILER > BATCH_MAX_FRAME) return false;
+  uint8_t buf[BATCH_MAX_FRAME];
   GameHdr *h = (GameHdr*)buf;
-  h->type = MSG_STATE_SNAPSHOT; h->seq = next_game_seq(); h->fromId = fromId;
+  h->type = MSG_STATE_SNAPSHOT; h->fromId = fromId;
   memcpy(buf + sizeof(GameHdr), data, len);
-  return send_raw_to_peer(buf, sizeof(GameHdr) + len);
+  return reliable_send(buf, sizeof(GameHdr) + len);
 }
 
 // Parser: call this to parse raw buffer and dispatch to weak handlers
 inline void processGamePacket(const uint8_t *src_mac, const uint8_t *data, int len) {
   if (!data || len < (int)sizeof(GameHdr)) return;
   const GameHdr *h = (const GameHdr*)data;
+  telemetry_count_rx(h->type);
+  // unreliable seqs show what the link lost (telemetry.h); a batch's own
+  // seq is taken after those of the messages it carries
+  if (h->type == MSG_JOIN) telemetry_seq_restart();
+  if (!reliable_is_type(h->type) && h->type != MSG_BATCH) telemetry_rx_seq(h->seq);
+  // reliable messages are acked even when repeated, but delivered once;
+  // the session byte at the end is theirs, not the message's
+  if (reliable_is_type(h->type)) {
+    if (len < (int)sizeof(GameHdr) + RELIABLE_TRAILER) return;
+    len -= RELIABLE_TRAILER;
+    if (!reliable_on_receive(h, data[len])) return;
+  }
   switch (h->type) {
     case MSG_INPUT:
       if (len >= (int)sizeof(MsgInput)) {
         const MsgInput *m = (const MsgInput*)data;
+        if (len < (int)sizeof(MsgInput) + input_trailer_len(m)) break;
         if ((void*)game_on_input != nullptr) game_on_input(src_mac, m);
       }
       break;
@@ -194,13 +344,34 @@ inline void processGamePacket(const uint8_t *src_mac, const uint8_t *data, int l
         game_on_state_snapshot(src_mac, data + sizeof(GameHdr), len - sizeof(GameHdr));
       }
       break;
+    case MSG_STATE_HASH:
+      if (len >= (int)sizeof(MsgStateHash)) {
+        const MsgStateHash *m = (const MsgStateHash*)data;
+        if ((void*)game_on_state_hash != nullptr) game_on_state_hash(src_mac, m);
+      }
+      break;
+    case MSG_BATCH: {
+      // unpack and handle each message in order (no nested batches)
+      int off = sizeof(GameHdr);
+      while (off < len) {
+        int n = data[off++];
+        if (n < (int)sizeof(GameHdr) || off + n > len) break;
+        if (data[off] != MSG_BATCH) processGamePacket(src_mac, data + off, n);
+        off += n;
+      }
+      telemetry_rx_seq(h->seq);
+      break;
+    }
     case MSG_ACK:
       if (len >= (int)sizeof(MsgAck)) {
         const MsgAck *m = (const MsgAck*)data;
+        reliable_on_ack(m, len);
         if ((void*)game_on_ack != nullptr) game_on_ack(src_mac, m);
       }
       break;
     case MSG_JOIN:
+      reliable_peer_reset();
+      // fall through
     case MSG_JOIN_ACK:
       if ((void*)game_on_join != nullptr) game_on_join(src_mac, h, data + sizeof(GameHdr), len - sizeof(GameHdr));
       break;
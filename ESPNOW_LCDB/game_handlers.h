@@ -0,0 +1,254 @@
+#pragma once
+
+// game_handlers.h - the game_on_*() hooks of espnow_game.h
+//
+// What a device does with each message from the peer: remote bombs placed
+// and exploded by their age or game time, score and death updates, the
+// end-of-game and MAP_SYNC snapshots, state digests, JOIN, the ready
+// handshake, clock probes and lockstep inputs. The sketches and the host
+// programs that play against a peer (host/sim/sim_net.cpp) include this
+// same file, so what is measured on the host is what ships.
+//
+// The handlers are definitions, not inline (they take the place of the
+// weak declarations in espnow_game.h): include this in exactly one file
+// of a program, after game_engine.h. That file also defines
+// game_waiting_for_peer(), game_round_running() and game_ended_by_peer()
+// for its own state machine, and the globals declared here. A host
+// program may define on_game_rx() to count what arrived; the sketch does
+// not.
+
+#include "espnow_game.h"
+#include "state_sync.h"
+#include "state_snapshot.h"
+#include "lockstep.h"
+#include "remote_player.h"
+#include "clock_sync.h"
+#include "debug.h"
+
+// Remote placement thresholds (retransmission is handled by espnow_reliable.h)
+const unsigned long BOMB_MIN_REMAIN_MS = 150;        // when a remote place is slightly expired, leave a small remainder
+const unsigned long BOMB_STALE_THRESHOLD_MS = 1000;  // if placement is older than this, treat as exploded
+
+// The including file's side.
+extern bool peerReady;            // the peer's heartbeat was seen on the waiting page
+extern unsigned long peerReadyAt;
+bool game_waiting_for_peer();     // on the waiting page: heartbeats mark the peer ready
+bool game_round_running();        // a round is being played: digests and JOINs are answered
+void game_ended_by_peer(int winnerId);  // GAME_END snapshot
+
+enum GameRxEvent : uint8_t {
+  GAME_RX_JOIN,
+  GAME_RX_POS,
+  GAME_RX_INPUT,
+  GAME_RX_PLACE_FRESH,          // age < fuse: placed with the remaining fuse
+  GAME_RX_PLACE_NEAR_EXPIRED,   // fuse passed by at most BOMB_STALE_THRESHOLD_MS: BOMB_MIN_REMAIN_MS left
+  GAME_RX_PLACE_STALE,          // older: treated as already exploded
+  GAME_RX_PLACE_TIMED,          // one of these, aged by the game clock (clock_sync.h)
+  GAME_RX_EXPLODE_TIMED,        // MSG_BOMB_EXPLODE with a game time; value: ms after the blast
+  GAME_RX_DEATH,
+  GAME_RX_MAP_SYNC
+};
+extern void on_game_rx(GameRxEvent ev, unsigned long value) __attribute__((weak));
+
+inline void game_rx_note(GameRxEvent ev, unsigned long value = 0) {
+  if ((void*)on_game_rx != nullptr) on_game_rx(ev, value);
+}
+
+void game_on_input(const uint8_t *src_mac, const MsgInput *m) {
+  (void)src_mac;
+  // interpret inputFlags: bit0=up, bit1=down, bit2=left, bit3=right, bit4=drop
+  if (!m) return;
+  game_rx_note(GAME_RX_INPUT);
+  // lockstep: an input for a tick, applied when that tick is stepped
+  if (lockstep_on_input(m)) return;
+  // outside lockstep the peer's player is walked from MSG_POS (remote_player.h)
+  // and its bombs arrive as MSG_BOMB_PLACE
+  DBG_PRINT("RX INPUT flags="); DBG_PRINTLN(m->inputFlags);
+}
+
+// Position update from peer
+void game_on_pos(const uint8_t *src_mac, const MsgPos *m) {
+  (void)src_mac;
+  if (!m) return;
+  game_rx_note(GAME_RX_POS);
+  // in lockstep the peer's position follows from its inputs
+  if (lockstep().active) return;
+  remote_player_on_pos(m, millis());
+}
+
+void game_on_bomb_place(const uint8_t *src_mac, const MsgBombPlace *m) {
+  (void)src_mac;
+  if (!m) return;
+  // The sender transmits the age (ms since placement) instead of its
+  // absolute millis() to avoid requiring synchronized clocks. Interpret
+  // m->placedMs as "age" here. With a shared game clock the placement time
+  // gives the age including the time in flight.
+  unsigned long now = millis();
+  unsigned long age = (unsigned long)m->placedMs;
+  if (m->placedGameMs && clock_synced()) {
+    age = clock_age_ms(m->placedGameMs);
+    game_rx_note(GAME_RX_PLACE_TIMED);
+  }
+  unsigned long placedAt = now - age;
+  // If the bomb is already older than its fuse, treat as near-expired or stale
+  if (age >= (unsigned long)m->fuseMs) {
+    if (age - (unsigned long)m->fuseMs > BOMB_STALE_THRESHOLD_MS) {
+      // too old -> it has exploded already (once, even if repeated)
+      game_rx_note(GAME_RX_PLACE_STALE);
+      DBG_PRINT("RX BOMB PLACE (stale) id="); DBG_PRINTLN(m->bombId);
+      remoteBombExplode(m->h.fromId, m->bombId, m->x, m->y, age - (unsigned long)m->fuseMs);
+      return;
+    }
+    // schedule a near-immediate explosion (leave a small remainder)
+    game_rx_note(GAME_RX_PLACE_NEAR_EXPIRED);
+    placedAt = now - (m->fuseMs - BOMB_MIN_REMAIN_MS);
+  } else {
+    game_rx_note(GAME_RX_PLACE_FRESH);
+  }
+  // Upsert by (sender, bombId): a repeat only refines the fuse estimate and
+  // a bomb that already went off here is not placed again.
+  RemoteBombResult r = remoteBombPlace(m->h.fromId, m->bombId, m->x, m->y, placedAt, m->fuseMs);
+  (void)r;
+  DBG_PRINT("RX BOMB PLACE id="); DBG_PRINT(m->bombId);
+  DBG_PRINT(" age="); DBG_PRINT(age);
+  DBG_PRINT(" fuse="); DBG_PRINT(m->fuseMs);
+  DBG_PRINT(" result="); DBG_PRINTLN((int)r);
+}
+
+void game_on_bomb_explode(const uint8_t *src_mac, const MsgBombExplode *m) {
+  (void)src_mac;
+  if (!m) return;
+  DBG_PRINT("RX BOMB EXPLODE id="); DBG_PRINTLN(m->bombId);
+  // detonate our copy of the bomb (and anything it chains into) if we still
+  // have it, blast the location if the placement never arrived, and ignore
+  // it if the bomb already went off here. With a shared game clock the
+  // cells burn until they do at the owner's.
+  unsigned long late = 0;
+  if (m->explodeMs && clock_synced()) {
+    late = clock_age_ms(m->explodeMs);
+    game_rx_note(GAME_RX_EXPLODE_TIMED, late);
+  }
+  if (!remoteBombExplode(m->h.fromId, m->bombId, m->cx, m->cy, late)) {
+    DBG_PRINT("RX BOMB EXPLODE (already exploded) id="); DBG_PRINTLN(m->bombId);
+  }
+}
+
+// Score update received from peer
+void game_on_score_update(const uint8_t *src_mac, const MsgScoreUpdate *m) {
+  (void)src_mac;
+  if (!m) return;
+  DBG_PRINTF("RX SCORE UPDATE owner=%u delta=%d from=%u\n", m->owner, m->delta, m->h.fromId);
+  if (m->owner == myPlayerId) score_local += m->delta;
+  else score_remote += m->delta;
+  score = score_local;
+  DBG_PRINTF("scores after RX: local=%ld remote=%ld\n", score_local, score_remote);
+}
+
+// Player death reported by peer: apply its scores, score0/score1 mapped
+// to score_local/score_remote by our myPlayerId
+void game_on_player_death(const uint8_t *src_mac, const MsgPlayerDeath *m) {
+  (void)src_mac;
+  if (!m) return;
+  game_rx_note(GAME_RX_DEATH);
+  DBG_PRINTF("RX PLAYER DEATH victim=%u killer=%u from=%u s0=%ld s1=%ld\n", m->victimId, m->killerId, m->h.fromId, (long)m->score0, (long)m->score1);
+  if (myPlayerId == 0) {
+    score_local = m->score0;
+    score_remote = m->score1;
+  } else {
+    score_local = m->score1;
+    score_remote = m->score0;
+  }
+  score = score_local;
+  DBG_PRINTF("scores after DEATH snapshot applied: local=%ld remote=%ld\n", score_local, score_remote);
+}
+
+// State snapshot from peer (game end, MAP_SYNC, resyncs)
+void game_on_state_snapshot(const uint8_t *src_mac, const uint8_t *data, int len) {
+  (void)src_mac;
+  if (!data || len < 2) return;
+  // map band / score resync (state_sync.h), full state (state_snapshot.h);
+  // a lockstep round takes none of them
+  if (lockstep_drops_snapshot(data, len)) return;
+  if (state_sync_on_snapshot(data, len)) return;
+  if (snapshot_on_message(data, len, myPlayerId)) return;
+  uint8_t code = data[0];
+  if (code == 0x01) {
+    DBG_PRINT("RX STATE SNAPSHOT: winner="); DBG_PRINTLN(data[1]);
+    game_ended_by_peer((int)data[1]);
+  }
+  // MAP sync: payload = [0x02][4 bytes seed LE]
+  else if (code == 0x02 && len >= 5) {
+    uint32_t seed = 0;
+    memcpy(&seed, data + 1, 4);
+    pending_map_seed = seed;
+    game_rx_note(GAME_RX_MAP_SYNC);
+    DBG_PRINT("RX MAP_SYNC seed="); DBG_PRINTLN(seed);
+  }
+}
+
+// Peer's state digest: compare with ours, resync what stays different
+void game_on_state_hash(const uint8_t *src_mac, const MsgStateHash *m) {
+  (void)src_mac;
+  if (!m || !game_round_running()) return;
+  // lockstep ticks at its own pace on each side: digests would not match,
+  // and a lockstep round is not caught up with snapshots
+  if (lockstep().active) return;
+  state_sync_on_hash(m, myPlayerId);
+  // a peer whose round is much younger than ours missed it: catch it up
+  snapshot_on_peer_round(millis(), m->roundMs);
+  DBG_PRINTF("RX STATE HASH: %lu mismatches, %lu/%lu/%lu map/bomb/score desyncs\n", state_sync().stats.mismatches,
+             state_sync().stats.mapDesyncs, state_sync().stats.bombDesyncs, state_sync().stats.scoreDesyncs);
+}
+
+// When receiving a JOIN, mark remote player visible and set their spawn
+void game_on_join(const uint8_t *src_mac, const GameHdr *h, const uint8_t *payload, int payloadLen) {
+  (void)src_mac; (void)payload; (void)payloadLen;
+  game_rx_note(GAME_RX_JOIN);
+  // mark remote player spawn using sender id (in lockstep it may have moved already)
+  remote_player_on_join();
+  if (!lockstep().active) {
+    if (h->fromId == 0) { otherPlayerX = 1; otherPlayerY = 1; }
+    else { otherPlayerX = MAP_COLS - 2; otherPlayerY = MAP_ROWS - 2; }
+    otherPlayerVisible = true;
+  }
+  // reply with our current pos so peer sees us
+  send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
+  // a peer joining a round that is already running gets the whole state
+  if (game_round_running() && !lockstep().active) snapshot_on_join(millis());
+}
+
+// Answer to one of our clock probes (clock_sync.h)
+void net_on_time_probe(const uint8_t *src_mac, const TimeProbe *p) {
+  (void)src_mac;
+  bool was = clock_synced();
+  clock_sync_on_probe(p, millis());
+  if (!was && clock_synced()) {
+    DBG_PRINTF("clock synced: offset %ld us, drift %.1f ppm, error %ld us\n", (long)clock_sync().offset,
+               clock_sync().drift * 1e6, (long)clock_sync_error_us());
+  }
+}
+
+// Heartbeat/ready received from peer while in waiting page
+void game_on_heartbeat(const uint8_t *src_mac, const GameHdr *h) {
+  (void)src_mac; (void)h;
+  // mark peer presence only if we're in the waiting state
+  if (game_waiting_for_peer()) {
+    // if this is the first time we see their ready since entering waiting, reply once
+    if (!peerReady) {
+      peerReady = true;
+      peerReadyAt = millis();
+      // reply so the sender knows we saw them (quick two-way handshake)
+      send_ready(myPlayerId);
+      DBG_PRINT("RX READY (first) from "); DBG_PRINTLN(h->fromId);
+    } else {
+      // already marked ready; refresh timestamp only
+      peerReadyAt = millis();
+      DBG_PRINT("RX READY (refresh) from "); DBG_PRINTLN(h->fromId);
+    }
+  } else {
+    // ignore heartbeats received outside waiting to avoid false-positive ready
+    DBG_PRINT("RX READY (ignored, not waiting) from "); DBG_PRINTLN(h->fromId);
+  }
+}
+
+// End of game_handlers.h
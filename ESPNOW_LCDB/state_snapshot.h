@@ -0,0 +1,367 @@
+#pragma once
+
+// state_snapshot.h - the whole round in MSG_STATE_SNAPSHOT, for catching a
+// peer up
+//
+// Include after game_engine.h. Call snapshot_round_start() when a round
+// starts, snapshot_on_join() when the peer's JOIN arrives, snapshot_poll()
+// from loop() while the round runs, and hand MSG_STATE_SNAPSHOT payloads to
+// snapshot_on_message() first.
+//
+// Raw layout, in player order so both sides lay it out the same way:
+//   map      2 bits per tile, row-major
+//   burning  1 bit per tile, then 1 byte: ms left of the longest-burning cell / 2
+//   bombs    MAX_BOMBS records {owner + 1 (0 = free slot), x, y, netId, ms left}
+//   players  {x, y, lives} for player 0 and player 1 (0xFF = not known)
+//   scores   int32 score of player 0 and of player 1
+// The sender XORs the raw snapshot with the last one the peer acked, if it
+// still has it, so an unchanged byte becomes 0. It then run-length codes
+// it and cuts it into fragments:
+//   [0x05][snapId u16][baseId u16][encLen u16][index][count][bytes...]
+// baseId 0 means a full snapshot. Fragments are bigger than
+// RELIABLE_MAX_LEN, so they go out once. The receiver applies a complete
+// snapshot and acks it with [0x06][snapId u16] on the reliable channel. An
+// ack of 0 asks for a full snapshot, because the base is gone. A snapshot
+// that is not acked within SNAPSHOT_RETRY_MS is replaced by a new one.
+//
+// A snapshot is sent when the peer's round started more than
+// SNAPSHOT_LATE_JOIN_MS after ours: the peer joined late, or it rebooted.
+// Its JOIN tells us so, and MSG_STATE_HASH carries the age of its round in
+// case the JOIN was lost. The receiver takes from it the map, the sender's
+// bombs, the burning cells, the sender's position and both scores. The
+// lives are carried but not applied: outside lockstep.h each side only
+// keeps its own. A 16x16 round is one fragment, a full 64x64 one six.
+
+#include "espnow_game.h"
+
+extern long score_local;
+extern long score_remote;
+
+const uint8_t SNAPSHOT_FRAGMENT = 0x05;
+const uint8_t SNAPSHOT_ACK = 0x06;
+const int SNAPSHOT_MAX_BOMBS = MAX_BOMBS_LIMIT;
+const int SNAPSHOT_BOMB_BYTES = 7;
+const int SNAPSHOT_MAP_BYTES = (MAP_ROWS * MAP_COLS + 3) / 4;
+const int SNAPSHOT_BURN_BYTES = (MAP_ROWS * MAP_COLS + 7) / 8;
+const int SNAPSHOT_MAX_RAW = SNAPSHOT_MAP_BYTES + SNAPSHOT_BURN_BYTES + 1 + SNAPSHOT_MAX_BOMBS * SNAPSHOT_BOMB_BYTES + 6 + 8;
+const int SNAPSHOT_MAX_ENC = SNAPSHOT_MAX_RAW + SNAPSHOT_MAX_RAW / 128 + 1;  // RLE worst case
+const int SNAPSHOT_FRAG_HDR = 9;
+const int SNAPSHOT_FRAG_BYTES = 200;  // fragment + headers stay under one frame
+const int SNAPSHOT_HISTORY = 4;       // sent / applied snapshots kept as delta bases
+const unsigned long SNAPSHOT_RETRY_MS = 300;
+const int SNAPSHOT_MAX_TRIES = 8;
+const unsigned long SNAPSHOT_LATE_JOIN_MS = 1000;
+
+struct SnapshotStats {
+  unsigned long sent;        // snapshots (full + delta)
+  unsigned long full;
+  unsigned long fragments;
+  unsigned long bytes;       // encoded bytes sent, fragment headers included
+  unsigned long rawBytes;    // what they would have been raw
+  unsigned long acked;
+  unsigned long applied;
+  unsigned long baseMissing; // delta against a snapshot we no longer have
+};
+
+struct SnapshotCopy {
+  uint16_t id;
+  uint8_t raw[SNAPSHOT_MAX_RAW];
+};
+
+struct SnapshotSync {
+  // sending
+  uint16_t nextId;
+  uint16_t ackedId;          // newest snapshot the peer applied (0 = none)
+  uint16_t lastSentId;
+  bool wanted;
+  uint8_t tries;
+  unsigned long lastSentAt;
+  unsigned long roundStartedAt;
+  unsigned long servedPeerRound;  // start of the peer round we last caught up
+  bool servedAny;
+  SnapshotCopy tx[SNAPSHOT_HISTORY];
+  int txNext;
+  // receiving: one snapshot in reassembly, the last applied ones as bases
+  uint16_t rxId, rxBase, rxEncLen;
+  uint8_t rxCount;
+  uint32_t rxMask;
+  uint8_t rxBuf[SNAPSHOT_MAX_ENC];
+  SnapshotCopy rx[SNAPSHOT_HISTORY];
+  int rxNext;
+  SnapshotStats stats;
+};
+
+inline SnapshotSync &snapshot_sync() { static SnapshotSync s = {}; return s; }
+
+inline int snapshot_raw_size() {
+  return SNAPSHOT_MAP_BYTES + SNAPSHOT_BURN_BYTES + 1 + MAX_BOMBS * SNAPSHOT_BOMB_BYTES + 6 + 8;
+}
+
+// Runs of zero bytes (0x80 | (n - 1)) and literals (n - 1, then n bytes),
+// n <= 128. out needs n + n / 128 + 1 bytes.
+inline size_t snapshot_rle_encode(const uint8_t *in, size_t n, uint8_t *out) {
+  size_t o = 0, i = 0;
+  while (i < n) {
+    size_t z = 0;
+    while (i + z < n && in[i + z] == 0 && z < 128) z++;
+    if (z >= 2 || (z == 1 && i + 1 == n)) {
+      out[o++] = (uint8_t)(0x80 | (z - 1));
+      i += z;
+      continue;
+    }
+    // literal up to the next pair of zeros (a lone zero is cheaper inline)
+    size_t start = i;
+    while (i < n && i - start < 128 && !(in[i] == 0 && (i + 1 == n || in[i + 1] == 0))) i++;
+    out[o++] = (uint8_t)(i - start - 1);
+    memcpy(out + o, in + start, i - start);
+    o += i - start;
+  }
+  return o;
+}
+
+// Returns false unless the input decodes to exactly n bytes.
+inline bool snapshot_rle_decode(const uint8_t *in, size_t len, uint8_t *out, size_t n) {
+  size_t i = 0, o = 0;
+  while (i < len) {
+    uint8_t c = in[i++];
+    size_t k = (size_t)(c & 0x7F) + 1;
+    if (o + k > n) return false;
+    if (c & 0x80) {
+      memset(out + o, 0, k);
+    } else {
+      if (i + k > len) return false;
+      memcpy(out + o, in + i, k);
+      i += k;
+    }
+    o += k;
+  }
+  return o == n;
+}
+
+inline void snapshot_capture(uint8_t *raw, uint8_t myId) {
+  unsigned long now = gameMillis();
+  memset(raw, 0, SNAPSHOT_MAX_RAW);
+  uint8_t *map = raw, *burn = map + SNAPSHOT_MAP_BYTES, *bomb = burn + SNAPSHOT_BURN_BYTES + 1;
+  int n = 0;
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS; c++, n++) map[n / 4] |= (uint8_t)((mapTileAt(c, r) & 3) << ((n % 4) * 2));
+  unsigned long burnLeft = 0;
+  for (int i = 0; i < explosions.activeCount; i++) {
+    uint16_t cell = explosions.active[i];
+    unsigned long endAt = explosions.endAt[cell / MAP_COLS][cell % MAP_COLS];
+    if ((long)(endAt - now) < 0) continue;
+    burn[cell / 8] |= (uint8_t)(1u << (cell % 8));
+    if (endAt - now > burnLeft) burnLeft = endAt - now;
+  }
+  burn[SNAPSHOT_BURN_BYTES] = (uint8_t)min(burnLeft / 2, 255UL);
+  for (int i = 0; i < MAX_BOMBS && i < SNAPSHOT_MAX_BOMBS; i++, bomb += SNAPSHOT_BOMB_BYTES) {
+    if (!bombs[i].active) continue;
+    unsigned long end = bombs[i].placedAt + bombs[i].fuseMs;
+    long left = (long)(end - now);
+    uint16_t ms = (uint16_t)((left < 0) ? 0 : (left > 65535 ? 65535 : left));
+    bomb[0] = (uint8_t)(bombs[i].owner + 1);
+    bomb[1] = (uint8_t)bombs[i].x; bomb[2] = (uint8_t)bombs[i].y;
+    memcpy(bomb + 3, &bombs[i].netId, 2);
+    memcpy(bomb + 5, &ms, 2);
+  }
+  uint8_t *players = raw + SNAPSHOT_MAP_BYTES + SNAPSHOT_BURN_BYTES + 1 + MAX_BOMBS * SNAPSHOT_BOMB_BYTES;
+  uint8_t *me = players + 3 * (myId ? 1 : 0), *peer = players + 3 * (myId ? 0 : 1);
+  me[0] = (uint8_t)playerX; me[1] = (uint8_t)playerY; me[2] = (uint8_t)lives;
+  peer[0] = otherPlayerVisible ? (uint8_t)otherPlayerX : 0xFF;
+  peer[1] = otherPlayerVisible ? (uint8_t)otherPlayerY : 0xFF;
+  peer[2] = 0xFF;
+  int32_t s0 = (int32_t)((myId == 0) ? score_local : score_remote);
+  int32_t s1 = (int32_t)((myId == 0) ? score_remote : score_local);
+  memcpy(players + 6, &s0, 4);
+  memcpy(players + 10, &s1, 4);
+}
+
+inline void snapshot_apply(const uint8_t *raw, uint8_t senderId, uint8_t myId) {
+  unsigned long now = gameMillis();
+  const uint8_t *map = raw, *burn = map + SNAPSHOT_MAP_BYTES, *bomb = burn + SNAPSHOT_BURN_BYTES + 1;
+  int n = 0;
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS; c++, n++) {
+      Tile t = (Tile)((map[n / 4] >> ((n % 4) * 2)) & 3);
+      if (mapTileAt(c, r) != t) mapSetTile(c, r, t);
+    }
+  unsigned long burnLeft = (unsigned long)burn[SNAPSHOT_BURN_BYTES] * 2;
+  for (int cell = 0; cell < MAP_ROWS * MAP_COLS; cell++)
+    if (burn[cell / 8] & (1u << (cell % 8))) explosionBurn(cell % MAP_COLS, cell / MAP_COLS, now + burnLeft);
+  // our own bombs are ours to report; the sender's are placed like a late MSG_BOMB_PLACE
+  for (int i = 0; i < MAX_BOMBS && i < SNAPSHOT_MAX_BOMBS; i++, bomb += SNAPSHOT_BOMB_BYTES) {
+    if (bomb[0] == 0 || bomb[0] - 1 == myId) continue;
+    uint16_t id, ms;
+    memcpy(&id, bomb + 3, 2);
+    memcpy(&ms, bomb + 5, 2);
+    remoteBombPlace((uint8_t)(bomb[0] - 1), id, bomb[1], bomb[2], now, ms ? ms : 1);
+  }
+  const uint8_t *players = raw + SNAPSHOT_MAP_BYTES + SNAPSHOT_BURN_BYTES + 1 + MAX_BOMBS * SNAPSHOT_BOMB_BYTES;
+  const uint8_t *them = players + 3 * (senderId ? 1 : 0);
+  if (them[0] != 0xFF) {
+    otherPlayerX = them[0]; otherPlayerY = them[1];
+    otherPlayerVisible = true;
+  }
+  int32_t s0, s1;
+  memcpy(&s0, players + 6, 4);
+  memcpy(&s1, players + 10, 4);
+  score_local = (myId == 0) ? s0 : s1;
+  score_remote = (myId == 0) ? s1 : s0;
+  score = score_local;
+}
+
+inline SnapshotCopy *snapshot_find(SnapshotCopy *ring, uint16_t id) {
+  if (id == 0) return nullptr;
+  for (int i = 0; i < SNAPSHOT_HISTORY; i++) if (ring[i].id == id) return &ring[i];
+  return nullptr;
+}
+
+inline void snapshot_send_ack(uint16_t id, uint8_t myId) {
+  uint8_t buf[3];
+  buf[0] = SNAPSHOT_ACK;
+  memcpy(buf + 1, &id, 2);
+  send_state_snapshot(buf, sizeof(buf), myId);
+}
+
+// Capture, delta against the peer's last acked snapshot, encode, fragment.
+inline void snapshot_send(uint8_t myId) {
+  SnapshotSync &s = snapshot_sync();
+  SnapshotCopy &cur = s.tx[s.txNext];
+  s.txNext = (s.txNext + 1) % SNAPSHOT_HISTORY;
+  if (++s.nextId == 0) s.nextId = 1;
+  cur.id = s.nextId;
+  snapshot_capture(cur.raw, myId);
+  int rawLen = snapshot_raw_size();
+  const SnapshotCopy *base = snapshot_find(s.tx, s.ackedId);
+  if (base == &cur) base = nullptr;
+  uint8_t delta[SNAPSHOT_MAX_RAW];
+  for (int i = 0; i < rawLen; i++) delta[i] = base ? (uint8_t)(cur.raw[i] ^ base->raw[i]) : cur.raw[i];
+  uint8_t enc[SNAPSHOT_MAX_ENC];
+  uint16_t encLen = (uint16_t)snapshot_rle_encode(delta, rawLen, enc);
+  uint16_t baseId = base ? base->id : 0;
+  uint8_t count = (uint8_t)((encLen + SNAPSHOT_FRAG_BYTES - 1) / SNAPSHOT_FRAG_BYTES);
+  if (count == 0) count = 1;
+  for (uint8_t k = 0; k < count; k++) {
+    uint8_t frag[SNAPSHOT_FRAG_HDR + SNAPSHOT_FRAG_BYTES];
+    int off = k * SNAPSHOT_FRAG_BYTES;
+    int len = min(SNAPSHOT_FRAG_BYTES, (int)encLen - off);
+    frag[0] = SNAPSHOT_FRAGMENT;
+    memcpy(frag + 1, &cur.id, 2);
+    memcpy(frag + 3, &baseId, 2);
+    memcpy(frag + 5, &encLen, 2);
+    frag[7] = k;
+    frag[8] = count;
+    memcpy(frag + SNAPSHOT_FRAG_HDR, enc + off, len);
+    send_state_snapshot(frag, SNAPSHOT_FRAG_HDR + len, myId);
+    s.stats.fragments++;
+    s.stats.bytes += SNAPSHOT_FRAG_HDR + len;
+  }
+  s.lastSentId = cur.id;
+  s.stats.sent++;
+  if (!base) s.stats.full++;
+  s.stats.rawBytes += rawLen;
+}
+
+// A new round: earlier snapshots can no longer be bases.
+inline void snapshot_round_start(unsigned long now) {
+  SnapshotSync &s = snapshot_sync();
+  s.ackedId = 0;
+  s.wanted = false;
+  s.roundStartedAt = now;
+  s.servedAny = false;
+  s.rxId = 0;
+  s.rxMask = 0;
+  for (int i = 0; i < SNAPSHOT_HISTORY; i++) { s.tx[i].id = 0; s.rx[i].id = 0; }
+}
+
+// The peer's round has been running for peerRoundMs: catch it up once if
+// it started well after ours.
+inline void snapshot_on_peer_round(unsigned long now, unsigned long peerRoundMs) {
+  SnapshotSync &s = snapshot_sync();
+  unsigned long peerStart = now - peerRoundMs;
+  if ((long)(peerStart - s.roundStartedAt) < (long)SNAPSHOT_LATE_JOIN_MS) return;
+  long since = (long)(peerStart - s.servedPeerRound);
+  if (s.servedAny && since < (long)SNAPSHOT_LATE_JOIN_MS && since > -(long)SNAPSHOT_LATE_JOIN_MS) return;
+  s.servedPeerRound = peerStart;
+  s.servedAny = true;
+  s.wanted = true;
+  s.tries = 0;
+}
+
+// The peer (re)joined: its round starts now.
+inline void snapshot_on_join(unsigned long now) { snapshot_on_peer_round(now, 0); }
+
+inline void snapshot_poll(unsigned long now, uint8_t myId) {
+  SnapshotSync &s = snapshot_sync();
+  if (!s.wanted) return;
+  if (s.tries && now - s.lastSentAt < SNAPSHOT_RETRY_MS) return;
+  if (s.tries >= SNAPSHOT_MAX_TRIES) { s.wanted = false; return; }
+  snapshot_send(myId);
+  s.tries++;
+  s.lastSentAt = now;
+}
+
+// MSG_STATE_SNAPSHOT codes of this header; returns false for other codes.
+inline bool snapshot_on_message(const uint8_t *data, int len, uint8_t myId) {
+  if (len < 1) return false;
+  SnapshotSync &s = snapshot_sync();
+  if (data[0] == SNAPSHOT_ACK) {
+    if (len < 3) return true;
+    uint16_t id;
+    memcpy(&id, data + 1, 2);
+    if (id == 0) {
+      // the peer lost our base: send it everything, now
+      s.ackedId = 0;
+      s.wanted = true;
+      s.tries = 0;
+      return true;
+    }
+    if (!snapshot_find(s.tx, id)) return true;
+    if (s.ackedId == 0 || (int16_t)(id - s.ackedId) > 0) s.ackedId = id;
+    s.stats.acked++;
+    if (id == s.lastSentId) s.wanted = false;
+    return true;
+  }
+  if (data[0] != SNAPSHOT_FRAGMENT) return false;
+  if (len < SNAPSHOT_FRAG_HDR) return true;
+  uint16_t id, baseId, encLen;
+  memcpy(&id, data + 1, 2);
+  memcpy(&baseId, data + 3, 2);
+  memcpy(&encLen, data + 5, 2);
+  uint8_t k = data[7], count = data[8];
+  if (count == 0 || count > 32 || k >= count || encLen > SNAPSHOT_MAX_ENC) return true;
+  if (snapshot_find(s.rx, id)) return true;  // applied already
+  if (id != s.rxId) {
+    s.rxId = id; s.rxBase = baseId; s.rxEncLen = encLen; s.rxCount = count; s.rxMask = 0;
+  }
+  int off = k * SNAPSHOT_FRAG_BYTES, n = len - SNAPSHOT_FRAG_HDR;
+  if (off + n > (int)s.rxEncLen) return true;
+  memcpy(s.rxBuf + off, data + SNAPSHOT_FRAG_HDR, n);
+  s.rxMask |= 1UL << k;
+  uint32_t all = (s.rxCount >= 32) ? 0xFFFFFFFFUL : ((1UL << s.rxCount) - 1);
+  if (s.rxMask != all) return true;
+
+  uint8_t peerId = myId ? 0 : 1;
+  int rawLen = snapshot_raw_size();
+  SnapshotCopy &cur = s.rx[s.rxNext];
+  uint8_t raw[SNAPSHOT_MAX_RAW];
+  memset(raw, 0, sizeof(raw));
+  s.rxMask = 0;
+  if (!snapshot_rle_decode(s.rxBuf, s.rxEncLen, raw, rawLen)) return true;
+  if (s.rxBase) {
+    const SnapshotCopy *base = snapshot_find(s.rx, s.rxBase);
+    if (!base) {
+      s.stats.baseMissing++;
+      snapshot_send_ack(0, myId);
+      return true;
+    }
+    for (int i = 0; i < rawLen; i++) raw[i] ^= base->raw[i];
+  }
+  s.rxNext = (s.rxNext + 1) % SNAPSHOT_HISTORY;
+  cur.id = s.rxId;
+  memcpy(cur.raw, raw, sizeof(raw));
+  snapshot_apply(cur.raw, peerId, myId);
+  s.stats.applied++;
+  snapshot_send_ack(cur.id, myId);
+  return true;
+}
@@ -0,0 +1,170 @@
+#pragma once
+
+// state_sync.h - desync detection and targeted resync
+//
+// Include after game_engine.h (it reads the engine's StateHashGE) and call
+// state_sync_poll() from loop() while a round is running.
+//
+// Every STATE_SYNC_INTERVAL_MS each side sends MSG_STATE_HASH with the
+// digest of its map bands, active bombs and scores. The receiver compares it
+// with its own digest. Messages in flight make the two differ for a few ms
+// after every bomb or blast, so a part only counts as desynced when it
+// differed in two digests in a row. Then only that part is resynced,
+// through MSG_STATE_SNAPSHOT:
+//   - map band: [0x03][band][tiles, 2 bits each, row-major]. Both sides
+//     send their band. Breakables are never created during a round, so the
+//     receiver clears the breakables that the peer has already cleared.
+//   - scores: [0x04][int32 score]. Each side sends its own score_local (it
+//     is the one that applies the peer's death snapshots); the receiver
+//     takes it as score_remote.
+// Bombs are not resynced: a bomb either side is missing goes off within
+// BOMB_FUSE, and MSG_BOMB_EXPLODE blasts its tile anyway. Bomb desyncs are
+// only counted.
+
+#include "espnow_game.h"
+
+extern long score_local;
+extern long score_remote;
+
+const unsigned long STATE_SYNC_INTERVAL_MS = 500;
+const uint8_t SNAPSHOT_MAP_BAND = 0x03;
+const uint8_t SNAPSHOT_SCORES = 0x04;
+// bits of StateSync.lastDiff besides the map bands
+const uint16_t STATE_DIFF_BOMBS = 1u << STATE_HASH_REGIONS;
+const uint16_t STATE_DIFF_SCORES = 1u << (STATE_HASH_REGIONS + 1);
+
+struct StateSyncStats {
+  unsigned long hashesSent;
+  unsigned long hashesReceived;
+  unsigned long mismatches;      // received digests that differed anywhere
+  unsigned long mapDesyncs;      // band still different on the next digest
+  unsigned long bombDesyncs;
+  unsigned long scoreDesyncs;
+  unsigned long resyncsSent;     // MSG_STATE_SNAPSHOT band/score messages
+  unsigned long resyncBytes;     // their payload bytes
+  unsigned long resyncsApplied;
+  unsigned long tilesRepaired;   // breakables cleared by a peer's band
+};
+
+struct StateSync {
+  unsigned long roundStartedAt;
+  unsigned long lastSent;
+  bool sentAny;
+  uint16_t lastDiff;             // parts that differed in the previous digest
+  StateSyncStats stats;
+};
+
+inline StateSync &state_sync() { static StateSync s = {}; return s; }
+
+// Start of a round: forget the previous digest (counters are kept).
+inline void state_sync_reset(unsigned long now) {
+  StateSync &s = state_sync();
+  s.roundStartedAt = now;
+  s.sentAny = false;
+  s.lastDiff = 0;
+}
+
+inline uint16_t state_hash_fold(uint32_t h) { return (uint16_t)(h ^ (h >> 16)); }
+
+// scores in player order, so both sides hash the same pair
+inline uint32_t state_hash_scores(uint8_t myId) {
+  long s0 = (myId == 0) ? score_local : score_remote;
+  long s1 = (myId == 0) ? score_remote : score_local;
+  return zobristKey(0x40000000u ^ (uint32_t)s0) ^ zobristKey(0x20000000u ^ (uint32_t)s1);
+}
+
+inline void state_sync_poll(unsigned long now, uint8_t myId) {
+  StateSync &s = state_sync();
+  if (s.sentAny && now - s.lastSent < STATE_SYNC_INTERVAL_MS) return;
+  const StateHashGE &h = stateHash();
+  uint16_t region[STATE_HASH_REGIONS];
+  for (int i = 0; i < STATE_HASH_REGIONS; i++) region[i] = state_hash_fold(h.region[i]);
+  send_state_hash(myId, region, h.bombs, state_hash_scores(myId), (uint32_t)(now - s.roundStartedAt));
+  s.lastSent = now;
+  s.sentAny = true;
+  s.stats.hashesSent++;
+}
+
+inline void state_sync_send_band(int band, uint8_t myId) {
+  uint8_t buf[2 + (MAP_ROWS * MAP_COLS + 3) / 4];
+  memset(buf, 0, sizeof(buf));
+  buf[0] = SNAPSHOT_MAP_BAND;
+  buf[1] = (uint8_t)band;
+  int n = 0;
+  for (int r = 0; r < MAP_ROWS; r++) {
+    if (stateHashRegionOf(r) != band) continue;
+    for (int c = 0; c < MAP_COLS; c++, n++) buf[2 + n / 4] |= (uint8_t)((mapTileAt(c, r) & 3) << ((n % 4) * 2));
+  }
+  size_t len = 2 + (n + 3) / 4;
+  send_state_snapshot(buf, len, myId);
+  state_sync().stats.resyncsSent++;
+  state_sync().stats.resyncBytes += len;
+}
+
+inline void state_sync_send_scores(uint8_t myId) {
+  uint8_t buf[5];
+  int32_t v = (int32_t)score_local;
+  buf[0] = SNAPSHOT_SCORES;
+  memcpy(buf + 1, &v, 4);
+  send_state_snapshot(buf, sizeof(buf), myId);
+  state_sync().stats.resyncsSent++;
+  state_sync().stats.resyncBytes += sizeof(buf);
+}
+
+// Compare the peer's digest with ours and resync what stayed different.
+inline void state_sync_on_hash(const MsgStateHash *m, uint8_t myId) {
+  StateSync &s = state_sync();
+  const StateHashGE &h = stateHash();
+  s.stats.hashesReceived++;
+  uint16_t diff = 0;
+  for (int i = 0; i < STATE_HASH_REGIONS; i++)
+    if (m->region[i] != state_hash_fold(h.region[i])) diff |= (uint16_t)(1u << i);
+  if (m->bombs != h.bombs) diff |= STATE_DIFF_BOMBS;
+  if (m->scores != state_hash_scores(myId)) diff |= STATE_DIFF_SCORES;
+  if (diff) s.stats.mismatches++;
+  uint16_t stuck = diff & s.lastDiff;
+  for (int i = 0; i < STATE_HASH_REGIONS; i++) {
+    if (!(stuck & (1u << i))) continue;
+    s.stats.mapDesyncs++;
+    state_sync_send_band(i, myId);
+  }
+  if (stuck & STATE_DIFF_BOMBS) s.stats.bombDesyncs++;
+  if (stuck & STATE_DIFF_SCORES) {
+    s.stats.scoreDesyncs++;
+    state_sync_send_scores(myId);
+  }
+  // a resynced part has to differ twice more before it is sent again
+  s.lastDiff = diff & ~stuck;
+}
+
+// MSG_STATE_SNAPSHOT codes of this header; returns false for other codes.
+inline bool state_sync_on_snapshot(const uint8_t *data, int len) {
+  if (len < 1) return false;
+  StateSync &s = state_sync();
+  if (data[0] == SNAPSHOT_MAP_BAND) {
+    if (len < 2 || data[1] >= STATE_HASH_REGIONS) return true;
+    int band = data[1], n = 0;
+    for (int r = 0; r < MAP_ROWS; r++) {
+      if (stateHashRegionOf(r) != band) continue;
+      for (int c = 0; c < MAP_COLS; c++, n++) {
+        if (2 + n / 4 >= len) return true;
+        Tile peer = (Tile)((data[2 + n / 4] >> ((n % 4) * 2)) & 3);
+        if (peer == TILE_EMPTY && mapTileAt(c, r) == TILE_BREAKABLE) {
+          mapSetTile(c, r, TILE_EMPTY);
+          s.stats.tilesRepaired++;
+        }
+      }
+    }
+    s.stats.resyncsApplied++;
+    return true;
+  }
+  if (data[0] == SNAPSHOT_SCORES) {
+    if (len < 5) return true;
+    int32_t v;
+    memcpy(&v, data + 1, 4);
+    score_remote = v;
+    s.stats.resyncsApplied++;
+    return true;
+  }
+  return false;
+}
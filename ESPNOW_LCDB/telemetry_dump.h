@@ -0,0 +1,155 @@
+#pragma once
+
+// telemetry_dump.h - the counters as one binary record over Serial
+//
+// Include after state_sync.h. telemetry_serial_poll() in loop() answers a
+// 'T' on Serial with a record of the counters of telemetry.h and the
+// statistics of the reliable channel, the peer probe, the receive queue,
+// the batcher and state_sync.h, as they are at that moment. Counters only
+// grow (until a reboot), so two records give the rates in between.
+//
+// Record: 'T' 'L', version, payload length (uint16), payload, CRC-16
+// (CCITT: poly 0x1021, init 0xFFFF) of version, length and payload
+// (uint16). Little-endian. The payload is the fields of TelemetryRecord in
+// order, each as an unsigned LEB128 varint, so counts under 128 take one
+// byte; a record is typically 110-150 bytes. The version changes with the
+// field list. Records can be mixed with text on the same port: a reader
+// looks for the magic and checks the CRC (telemetry_record_decode(), used by
+// the host's telemetry_decode).
+
+#include "state_sync.h"
+
+const uint8_t TELEM_MAGIC0 = 'T', TELEM_MAGIC1 = 'L';
+const uint8_t TELEM_VERSION = 2;
+const char TELEM_DUMP_CMD = 'T';
+
+struct TelemetryRecord {
+  uint32_t uptimeMs, playerId;
+  // frames (telemetry.h)
+  uint32_t txFrames, txBytes, txFail, txOk, txNoAck, rxFrames, rxBytes;
+  // receive queue (rx_queue.h)
+  uint32_t rxQueued, rxQueueDrops, rxOversize, rxHighWater;
+  // messages per type, seqs
+  uint32_t txMsgs[TELEM_TYPES], rxMsgs[TELEM_TYPES];
+  uint32_t seqGaps, seqLate, seqDups, seqRestarts, relOutOfOrder;
+  // reliable channel (espnow_reliable.h)
+  uint32_t relSent, relRetransmits, relAcked, relDropped, relUnqueued, relReceived, relDuplicates, relAckFrames;
+  uint32_t relPeerRestarts, relSrttUs, relRtoMs;
+  // peer probe (espnow_net.h)
+  uint32_t pings, pongs, pingsLost, pongsLate, pingSrttUs, pingMinUs;
+  // batcher (espnow_game.h)
+  uint32_t batchMessages, batchFrames, batchBatched;
+  // state digests (state_sync.h)
+  uint32_t hashesReceived, hashMismatches, mapDesyncs, bombDesyncs, scoreDesyncs, resyncsApplied, tilesRepaired;
+  uint32_t ackRtt[TELEM_RTT_BUCKETS], pingRtt[TELEM_RTT_BUCKETS];
+};
+const int TELEM_FIELDS = (int)(sizeof(TelemetryRecord) / sizeof(uint32_t));
+const int TELEM_RECORD_MAX = 7 + 5 * TELEM_FIELDS;
+
+inline void telemetry_record_fill(TelemetryRecord &r, unsigned long now, uint8_t playerId) {
+  const Telemetry &t = telemetry();
+  const RxQueue &q = espnow_rx_queue();
+  const ReliableState &rel = reliable();
+  const PeerLinkStats &probe = peer_probe().stats;
+  const NetBatch &b = net_batch();
+  const StateSyncStats &ss = state_sync().stats;
+  r = TelemetryRecord();
+  r.uptimeMs = (uint32_t)now;
+  r.playerId = playerId;
+  r.txFrames = t.txFrames.load(std::memory_order_relaxed);
+  r.txBytes = t.txBytes.load(std::memory_order_relaxed);
+  r.txFail = t.txFail.load(std::memory_order_relaxed);
+  r.txOk = t.txOk.load(std::memory_order_relaxed);
+  r.txNoAck = t.txNoAck.load(std::memory_order_relaxed);
+  r.rxFrames = t.rxFrames.load(std::memory_order_relaxed);
+  r.rxBytes = t.rxBytes.load(std::memory_order_relaxed);
+  r.rxQueued = q.pushed.load(std::memory_order_relaxed);
+  r.rxQueueDrops = q.dropped.load(std::memory_order_relaxed);
+  r.rxOversize = q.oversize.load(std::memory_order_relaxed);
+  r.rxHighWater = q.highWater.load(std::memory_order_relaxed);
+  memcpy(r.txMsgs, t.txMsgs, sizeof(r.txMsgs));
+  memcpy(r.rxMsgs, t.rxMsgs, sizeof(r.rxMsgs));
+  r.seqGaps = t.seqGaps; r.seqLate = t.seqLate; r.seqDups = t.seqDups; r.seqRestarts = t.seqRestarts;
+  r.relOutOfOrder = t.relOutOfOrder;
+  r.relSent = rel.stats.sent; r.relRetransmits = rel.stats.retransmits; r.relAcked = rel.stats.acked;
+  r.relDropped = rel.stats.dropped; r.relUnqueued = rel.stats.unqueued; r.relReceived = rel.stats.received;
+  r.relDuplicates = rel.stats.duplicates; r.relAckFrames = rel.stats.ackFrames;
+  r.relPeerRestarts = rel.stats.peerRestarts;
+  r.relSrttUs = rel.haveRtt ? (uint32_t)(rel.srtt * 1000) : 0;
+  r.relRtoMs = rel.rto;
+  r.pings = probe.pings; r.pongs = probe.pongs; r.pingsLost = probe.lost; r.pongsLate = probe.late;
+  r.pingSrttUs = (uint32_t)(probe.srttMs * 1000); r.pingMinUs = (uint32_t)(probe.minRttMs * 1000);
+  r.batchMessages = b.messages; r.batchFrames = b.frames; r.batchBatched = b.batched;
+  r.hashesReceived = ss.hashesReceived; r.hashMismatches = ss.mismatches;
+  r.mapDesyncs = ss.mapDesyncs; r.bombDesyncs = ss.bombDesyncs; r.scoreDesyncs = ss.scoreDesyncs;
+  r.resyncsApplied = ss.resyncsApplied; r.tilesRepaired = ss.tilesRepaired;
+  memcpy(r.ackRtt, t.ackRtt, sizeof(r.ackRtt));
+  memcpy(r.pingRtt, t.pingRtt, sizeof(r.pingRtt));
+}
+
+inline uint16_t telemetry_crc16(const uint8_t *p, size_t n) {
+  uint16_t crc = 0xFFFF;
+  while (n--) {
+    crc ^= (uint16_t)(*p++ << 8);
+    for (int i = 0; i < 8; i++) crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+// Encode into buf (TELEM_RECORD_MAX bytes); returns the record's length.
+inline size_t telemetry_record_encode(const TelemetryRecord &r, uint8_t *buf) {
+  const uint32_t *v = (const uint32_t *)&r;
+  size_t n = 5;
+  for (int i = 0; i < TELEM_FIELDS; i++) {
+    uint32_t x = v[i];
+    while (x >= 0x80) { buf[n++] = (uint8_t)(x | 0x80); x >>= 7; }
+    buf[n++] = (uint8_t)x;
+  }
+  uint16_t len = (uint16_t)(n - 5);
+  buf[0] = TELEM_MAGIC0; buf[1] = TELEM_MAGIC1; buf[2] = TELEM_VERSION;
+  memcpy(buf + 3, &len, 2);
+  uint16_t crc = telemetry_crc16(buf + 2, n - 2);
+  memcpy(buf + n, &crc, 2);
+  return n + 2;
+}
+
+// A record at buf (len bytes available): its length, 0 if more bytes are
+// needed to tell, -1 if this is not a record of this version.
+inline int telemetry_record_decode(const uint8_t *buf, size_t len, TelemetryRecord *r) {
+  if (len >= 1 && buf[0] != TELEM_MAGIC0) return -1;
+  if (len >= 2 && buf[1] != TELEM_MAGIC1) return -1;
+  if (len >= 3 && buf[2] != TELEM_VERSION) return -1;
+  if (len < 5) return 0;
+  uint16_t plen;
+  memcpy(&plen, buf + 3, 2);
+  if (plen > TELEM_RECORD_MAX) return -1;
+  if (len < (size_t)plen + 7) return 0;
+  uint16_t crc;
+  memcpy(&crc, buf + 5 + plen, 2);
+  if (crc != telemetry_crc16(buf + 2, (size_t)plen + 3)) return -1;
+  uint32_t *v = (uint32_t *)r;
+  const uint8_t *p = buf + 5, *end = p + plen;
+  for (int i = 0; i < TELEM_FIELDS; i++) {
+    uint32_t x = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p == end || shift > 28) return -1;
+      uint8_t c = *p++;
+      x |= (uint32_t)(c & 0x7F) << shift;
+      if (!(c & 0x80)) break;
+    }
+    v[i] = x;
+  }
+  return p == end ? (int)plen + 7 : -1;
+}
+
+// Call once per loop(): a 'T' on Serial gets a record back.
+inline void telemetry_serial_poll(unsigned long now, uint8_t playerId) {
+  bool dump = false;
+  while (Serial.available() > 0)
+    if (Serial.read() == TELEM_DUMP_CMD) dump = true;
+  if (!dump) return;
+  TelemetryRecord r;
+  telemetry_record_fill(r, now, playerId);
+  uint8_t buf[TELEM_RECORD_MAX];
+  Serial.write(buf, telemetry_record_encode(r, buf));
+}
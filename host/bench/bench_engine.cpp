@@ -0,0 +1,117 @@
+// bench_engine.cpp - off-device benchmark for game_engine.h.
+//
+// Runs a scripted single-player simulation (random walk, periodic bomb
+// placement, fuse expiry, explosions, round resets) over a simulated
+// millisecond clock and reports the host cost per simulated tick, plus
+// isolated timings for initializeGame() and explodeAt(). The printed
+// checksum covers the final map/score state so two builds of the engine can
+// be compared for identical behavior.
+//
+// usage: bench_engine [ticks] [seed]
+#include "sim_sketch.h"
+
+#include <chrono>
+#include <inttypes.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Bench-side RNG, independent from the engine's random() used by generateMap().
+struct XorShift32 {
+  uint32_t s;
+  uint32_t next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+  uint32_t below(uint32_t n) { return next() % n; }
+};
+
+double nsSince(Clock::time_point t0, unsigned long count) {
+  double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+  return count ? ns / (double)count : 0.0;
+}
+
+int countBreakables() {
+  int n = 0;
+  for (int r = 0; r < MAP_ROWS; r++) for (int c = 0; c < MAP_COLS; c++) if (mapData[r][c] == TILE_BREAKABLE) n++;
+  return n;
+}
+
+uint32_t stateChecksum() {
+  uint32_t h = 2166136261u;
+  auto mix = [&](uint32_t v) { h ^= v; h *= 16777619u; };
+  for (int r = 0; r < MAP_ROWS; r++) for (int c = 0; c < MAP_COLS; c++) mix((uint32_t)mapData[r][c]);
+  for (int i = 0; i < MAX_BOMBS; i++) { mix(bombs[i].active); mix((uint32_t)bombs[i].x); mix((uint32_t)bombs[i].y); }
+  mix((uint32_t)score_local); mix((uint32_t)lives); mix((uint32_t)playerX); mix((uint32_t)playerY);
+  mix((uint32_t)explosionEventCounter);
+  return h;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long ticks = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 5000000UL;
+  uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 12345u;
+  XorShift32 rng = {seed ? seed : 1u};
+
+  host_set_millis(1);
+  simResetRound(rng.next());
+  int breakablesAtStart = countBreakables();
+
+  // --- full simulation: one tick == one simulated millisecond -------------
+  unsigned long rounds = 1, bombsPlaced = 0;
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+  Clock::time_point t0 = Clock::now();
+  for (unsigned long t = 0; t < ticks; t++) {
+    host_advance_millis(1);
+    if (t % 60 == 0) {
+      int d = (int)rng.below(4);
+      int nx = playerX + dx[d], ny = playerY + dy[d];
+      if (mapIsWalkable(nx, ny)) { playerX = nx; playerY = ny; }
+    }
+    if (t % 170 == 0) { placeBombAtPlayer(); bombsPlaced++; }
+    updateBombs();
+    (void)isExplosionAt(playerX, playerY);
+    if (t % 5000 == 4999 && countBreakables() * 10 < breakablesAtStart) {
+      simResetRound(rng.next());
+      rounds++;
+    }
+  }
+  double nsPerTick = nsSince(t0, ticks);
+  uint32_t simChecksum = stateChecksum();
+
+  // --- initializeGame() in isolation ---------------------------------------
+  const unsigned long initIters = 20000;
+  t0 = Clock::now();
+  for (unsigned long i = 0; i < initIters; i++) { pending_map_seed = rng.next() | 1u; initializeGame(); }
+  double nsPerInit = nsSince(t0, initIters);
+
+  // --- explodeAt() in isolation (fresh map every 64 blasts) ----------------
+  const unsigned long explodeIters = 200000;
+  double explodeNs = 0.0;
+  for (unsigned long done = 0; done < explodeIters; ) {
+    host_advance_millis(EXPLOSION_VIS_MS + 1);
+    simResetRound(rng.next());
+    spawnInvulEnd = ~0UL; // keep damage bookkeeping out of the blast timing
+    t0 = Clock::now();
+    for (int k = 0; k < 64 && done < explodeIters; k++, done++) {
+      int x = 1 + (int)rng.below(MAP_COLS - 2), y = 1 + (int)rng.below(MAP_ROWS - 2);
+      explodeAt(x, y, myPlayerId);
+    }
+    explodeNs += nsSince(t0, 1);
+  }
+
+#ifdef MAP_BITBOARD
+  const char *backend = "bitboard";
+#else
+  const char *backend = "array";
+#endif
+  printf("map %dx%d (%s), MAX_BOMBS=%d, radius=%d\n", MAP_COLS, MAP_ROWS, backend, MAX_BOMBS, EXPLOSION_RADIUS);
+  printf("simulation     : %lu ticks, %lu rounds, %lu bomb attempts, %lu hits, score=%ld\n",
+         ticks, rounds, bombsPlaced, simStats.playerHits, score_local);
+  printf("blast chains   : %lu, %lu bombs chain-detonated\n", simStats.blastChains, simStats.chainedBombs);
+  printf("ns/tick        : %.1f\n", nsPerTick);
+  printf("initializeGame : %.1f ns/call\n", nsPerInit);
+  printf("explodeAt      : %.1f ns/call\n", explodeNs / (double)explodeIters);
+  printf("checksum       : %08" PRIx32 "\n", simChecksum);
+  return 0;
+}
@@ -0,0 +1,105 @@
+// bench_net.cpp - off-device measurement of the game's ESP-NOW traffic.
+//
+// Plays the bench_engine script (random walk, periodic bombs, round resets)
+// and sends what the sketch sends for it: MSG_POS when remote_player.h
+// says the peer's dead reckoning needs one, MSG_BOMB_PLACE per bomb, MSG_BOMB_EXPLODE per local chain and
+// MSG_SCORE_UPDATE per score change. Frames go over the in-process loopback
+// transport (host_transport.h) and come back after a few milliseconds, so
+// the reliable channel gets its acks (from itself). One
+// tick is one loop() iteration; the run is repeated without and with the
+// per-loop NetBatchScope and the frame counts compared.
+//
+// usage: bench_net [ticks] [seed]
+#include "sim_sketch.h"
+#include "host_transport.h"
+
+namespace {
+
+const unsigned long LOOPBACK_DELAY_MS = 3;
+// 802.11 action frame around an ESP-NOW payload: MAC header, category, OUI,
+// random bytes, vendor element header and FCS
+const double FRAME_OVERHEAD_BYTES = 43.0;
+const double PREAMBLE_US = 192.0;  // long preamble at 1 Mbps
+
+struct XorShift32 {
+  uint32_t s;
+  uint32_t next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+  uint32_t below(uint32_t n) { return next() % n; }
+};
+
+struct Result {
+  unsigned long messages, frames, batched, bytes;
+  unsigned long retransmits;
+};
+
+Result run(unsigned long ticks, uint32_t seed, bool batching) {
+  static const uint8_t mac[6] = {0x02, 0, 0, 0, 0, 0x01};
+  XorShift32 rng = {seed ? seed : 1u};
+  setPeerMac(mac);
+  reliable() = ReliableState();
+  net_batch() = NetBatch();
+  hostLoopbackOpen(mac, LOOPBACK_DELAY_MS);
+  net_set_transport(hostLoopbackTransport());
+  host_set_millis(1);
+  simResetRound(rng.next());
+  simStats = SimStats();
+  remote_player() = RemotePlayer();
+
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+  const uint8_t dirFlag[4] = {0x08, 0x04, 0x02, 0x01};
+  uint8_t held = 0;  // the direction button of the last move, held until the next
+  for (unsigned long t = 0; t < ticks; t++) {
+    host_advance_millis(1);
+    if (batching) net_batch_begin();
+    espnow_poll_rx();
+    reliable_poll(millis(), myPlayerId);
+    bool stepped = (t % 60 == 0);
+    if (stepped) {
+      int d = (int)rng.below(4);
+      if (mapIsWalkable(playerX + dx[d], playerY + dy[d])) { playerX += dx[d]; playerY += dy[d]; }
+      held = dirFlag[d];
+    }
+    remote_pos_poll(myPlayerId, playerX, playerY, held, stepped, millis());
+    if (t % 170 == 0) {
+      int i = placeBombAtPlayer();
+      if (i >= 0) send_bomb_place(myPlayerId, bombs[i].netId, bombs[i].x, bombs[i].y, 0, bombs[i].fuseMs, clock_game_stamp());
+    }
+    unsigned long chains = simStats.blastChains, scores = simStats.scoreEvents;
+    updateBombs();
+    if (simStats.blastChains != chains) send_bomb_explode(myPlayerId, 0, 0, 0, millis());
+    if (simStats.scoreEvents != scores) send_score_update(myPlayerId, 1, myPlayerId);
+    if (t % 20000 == 19999) simResetRound(rng.next());
+    if (batching) net_batch_end();
+  }
+  Result r;
+  r.messages = net_batch().messages;
+  r.frames = net_batch().frames;
+  r.batched = net_batch().batched;
+  r.bytes = hostLoopbackStats().bytesSent;
+  r.retransmits = reliable().stats.retransmits;
+  return r;
+}
+
+void report(const char *name, const Result &r, unsigned long ticks) {
+  double secs = ticks / 1000.0;
+  double airUs = r.frames * PREAMBLE_US + (r.bytes + r.frames * FRAME_OVERHEAD_BYTES) * 8.0;
+  printf("%-10s: %lu msgs, %lu frames (%.1f/s, %.2f msgs/frame, %lu batched), %.1f B/frame, ~%.1f ms air/s @1Mbps, %lu rexmit\n",
+         name, r.messages, r.frames, r.frames / secs, r.frames ? (double)r.messages / r.frames : 0.0, r.batched,
+         r.frames ? (double)r.bytes / r.frames : 0.0, airUs / 1000.0 / secs, r.retransmits);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long ticks = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 600000UL;
+  uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 12345u;
+
+  Result plain = run(ticks, seed, false);
+  Result batch = run(ticks, seed, true);
+  printf("%lu ticks (1 ms loop iterations), loopback delay %lu ms\n", ticks, LOOPBACK_DELAY_MS);
+  report("unbatched", plain, ticks);
+  report("batched", batch, ticks);
+  printf("frame reduction: %.1f%%\n", plain.frames ? 100.0 * (1.0 - (double)batch.frames / plain.frames) : 0.0);
+  return 0;
+}
@@ -0,0 +1,143 @@
+// bench_render.cpp - off-device check of the dirty-tile renderer and the
+// partial SH1107 flush.
+//
+// Runs the same scripted game as bench_engine and, every DISPLAY_REFRESH_MS,
+// renders a frame two ways:
+//   - incremental: renderDirtyTiles() + AsyncFlush::submit(FLUSH_DIRTY)
+//                  (synchronous on the host, same bytes as flushDirty())
+//   - reference:   clearDisplay() + full redraw + display() (the old path)
+// The two framebuffers must be identical after every frame. Reports the
+// bytes sent per frame by each path and the bus time they imply, plus the
+// CPU cost of a full repaint (map layer + sprite blits vs. drawBitmap for
+// everything) and of a single sprite (blitSprite() vs. drawBitmap()).
+//
+// usage: bench_render [ticks] [seed]
+#include "sim_sketch.h"
+#include "async_flush.h"
+
+#include <chrono>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+const unsigned long DISPLAY_REFRESH_MS = 33;
+
+struct XorShift32 {
+  uint32_t s;
+  uint32_t next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+  uint32_t below(uint32_t n) { return next() % n; }
+};
+
+// Full redraw with the layering the sketch used before dirty tracking.
+void renderReference(PartialSH1107 &disp) {
+  disp.clearDisplay();
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS && c * TILE_SIZE < 128; c++) drawTile(disp, c * TILE_SIZE, r * TILE_SIZE + HUD_HEIGHT, mapData[r][c]);
+  unsigned long now = millis();
+  if (!(now < spawnInvulEnd) || ((now / 200) % 2 == 0))
+    disp.drawBitmap(playerX * TILE_SIZE + 1, playerY * TILE_SIZE + HUD_HEIGHT + 1, SPRITE_PLAYER_6x6, 6, 6, 1);
+  if (otherPlayerVisible)
+    disp.drawBitmap(otherPlayerX * TILE_SIZE + 1, otherPlayerY * TILE_SIZE + HUD_HEIGHT + 1, SPRITE_PLAYER_6x6, 6, 6, 1);
+  // bombs and explosions straight from the tables, independent of the blitter
+  for (int i = 0; i < MAX_BOMBS; i++) {
+    if (!bombs[i].active || bombs[i].x * TILE_SIZE >= 128) continue;
+    disp.drawBitmap(bombs[i].x * TILE_SIZE + 1, bombs[i].y * TILE_SIZE + HUD_HEIGHT + 1, SPRITE_BOMB_6x6, 6, 6, 1);
+  }
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS && c * TILE_SIZE < 128; c++)
+      if (explosions.endAt[r][c] && now <= explosions.endAt[r][c])
+        disp.drawBitmap(c * TILE_SIZE, r * TILE_SIZE + HUD_HEIGHT, SPRITE_EXPLODE_8x8, 8, 8, 1);
+}
+
+// SH1107 over I2C: ~9 bit times per byte (8 data + ACK)
+double busMs(double bytes, double hz) { return bytes * 9.0 * 1000.0 / hz; }
+
+double nsSince(Clock::time_point t0) {
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long ticks = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 600000UL;
+  uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 12345u;
+  XorShift32 rng = {seed ? seed : 1u};
+
+  PartialSH1107 inc(128, 128);
+  PartialSH1107 ref(128, 128);
+  inc.begin();
+  ref.begin();
+  AsyncFlush incFlush(inc);
+
+  host_set_millis(1);
+  simResetRound(rng.next());
+  // a second, scripted player wandering around the map
+  otherPlayerX = MAP_COLS - 2; otherPlayerY = MAP_ROWS - 2; otherPlayerVisible = true;
+
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+  unsigned long frames = 0, mismatches = 0, refBytes = 0, incBytes = 0;
+  double incNs = 0.0;
+  for (unsigned long t = 0; t < ticks; t++) {
+    host_advance_millis(1);
+    if (t % 60 == 0) {
+      int d = (int)rng.below(4);
+      if (mapIsWalkable(playerX + dx[d], playerY + dy[d])) { playerX += dx[d]; playerY += dy[d]; }
+      d = (int)rng.below(4);
+      if (mapIsWalkable(otherPlayerX + dx[d], otherPlayerY + dy[d])) { otherPlayerX += dx[d]; otherPlayerY += dy[d]; }
+    }
+    if (t % 170 == 0) placeBombAtPlayer();
+    updateBombs();
+    if (t % 20000 == 19999) simResetRound(rng.next());
+    if (t % DISPLAY_REFRESH_MS != 0) continue;
+
+    Clock::time_point t0 = Clock::now();
+    renderDirtyTiles(inc, 0);
+    unsigned long before = inc.totalBytes;
+    incFlush.submit(FLUSH_DIRTY);
+    incBytes += inc.totalBytes - before;
+    incNs += nsSince(t0);
+
+    renderReference(ref);
+    ref.display();
+    refBytes += ref.lastFlushBytes;
+
+    frames++;
+    if (memcmp(inc.getBuffer(), ref.getBuffer(), 128 * 128 / 8) != 0) mismatches++;
+  }
+
+  // --- full repaint of the current state, CPU only ---------------------------
+  const int repaintIters = 20000;
+  Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < repaintIters; i++) renderReference(ref);
+  double refRepaintNs = nsSince(t0) / repaintIters;
+  t0 = Clock::now();
+  for (int i = 0; i < repaintIters; i++) { markAllTilesDirty(); renderDirtyTiles(inc, 0); }
+  double layerRepaintNs = nsSince(t0) / repaintIters;
+
+  // --- one 6x6 sprite at every y offset -------------------------------------
+  const int spriteIters = 200000;
+  const PageSprite &bomb = pageSprites().bomb;
+  PartialSH1107 scratch(128, 128);
+  scratch.begin();
+  t0 = Clock::now();
+  for (int i = 0; i < spriteIters; i++) scratch.drawBitmap(i & 63, (i >> 6) & 63, SPRITE_BOMB_6x6, 6, 6, 1);
+  double gfxSpriteNs = nsSince(t0) / spriteIters;
+  t0 = Clock::now();
+  for (int i = 0; i < spriteIters; i++) blitSprite(scratch.frameBuffer(), 128, 128, bomb, i & 63, (i >> 6) & 63);
+  double blitSpriteNs = nsSince(t0) / spriteIters;
+  if (memcmp(inc.getBuffer(), ref.getBuffer(), 128 * 128 / 8) != 0) mismatches++;
+
+  double refPerFrame = frames ? (double)refBytes / frames : 0.0;
+  double incPerFrame = frames ? (double)incBytes / frames : 0.0;
+  printf("map %dx%d, %lu frames (one every %lu ms)\n", MAP_COLS, MAP_ROWS, frames, DISPLAY_REFRESH_MS);
+  printf("full flush     : %.1f bytes/frame, %.1f ms @100kHz, %.1f ms @400kHz\n",
+         refPerFrame, busMs(refPerFrame, 100000.0), busMs(refPerFrame, 400000.0));
+  printf("partial flush  : %.1f bytes/frame, %.1f ms @100kHz, %.1f ms @400kHz\n",
+         incPerFrame, busMs(incPerFrame, 100000.0), busMs(incPerFrame, 400000.0));
+  printf("render+flush   : %.1f ns/frame (incremental, host)\n", frames ? incNs / frames : 0.0);
+  printf("full repaint   : %.1f ns drawBitmap, %.1f ns map layer + sprite blits\n", refRepaintNs, layerRepaintNs);
+  printf("6x6 sprite     : %.1f ns drawBitmap, %.1f ns blitSprite\n", gfxSpriteNs, blitSpriteNs);
+  printf("framebuffers   : %s (%lu mismatching frames)\n", mismatches ? "DIFFER" : "identical", mismatches);
+  return mismatches ? 1 : 0;
+}
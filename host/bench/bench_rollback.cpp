@@ -0,0 +1,194 @@
+// bench_rollback.cpp - cost of rollback (rollback.h, lockstep.h with rollback).
+//
+// Plays scripted rounds as player 0 of a lockstep round with rollback. The
+// peer's inputs are handed to lockstep_on_input() a fixed number of ticks
+// late, so every tick is first stepped on a guess and each change of the
+// peer's buttons is rolled back. Each round is played again with the
+// inputs on time (no guesses) as the reference; both must end in the same
+// state. Every tick the state is also saved, restored to the save from the
+// late-input distance back and restored forward again, which must give the
+// state back exactly. Reports the save size and the host cost of a save, a
+// restore, a plain tick and a rollback, and how many of the deepest
+// rollbacks fit in one 60 Hz frame.
+//
+// usage: bench_rollback [ticks] [seed] [late ticks]
+#include "sim_sketch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const uint32_t ROUND_TICKS = 3600;  // one minute per round
+
+struct XorShift32 {
+  uint32_t s;
+  uint32_t next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+  uint32_t below(uint32_t n) { return next() % n; }
+};
+
+double nsSince(Clock::time_point t0) {
+  return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+}
+
+// A direction (or none) every 4 ticks, a bomb press every 54.
+void scriptRound(XorShift32 &rng, std::vector<uint8_t> flags[2]) {
+  static const uint8_t dirFlag[6] = {0x01, 0x02, 0x04, 0x08, 0, 0};
+  for (int p = 0; p < 2; p++) {
+    flags[p].assign(ROUND_TICKS, 0);
+    uint8_t dir = 0;
+    for (uint32_t t = 0; t < ROUND_TICKS; t++) {
+      if (t % 4 == 0) dir = dirFlag[rng.below(6)];
+      flags[p][t] = (uint8_t)(dir | (((t + 27 * p) % 54 < 2) ? 0x10 : 0));
+    }
+  }
+}
+
+void deliver(uint32_t t, uint8_t f) {
+  uint8_t buf[sizeof(MsgInput) + 4];
+  MsgInput *m = (MsgInput *)buf;
+  memset(buf, 0, sizeof(buf));
+  m->h.type = MSG_INPUT;
+  m->h.fromId = 1;
+  m->clientTick = t;
+  m->inputFlags = f;
+  m->history = INPUT_HAS_ACK;
+  lockstep_on_input(m);
+}
+
+// FNV-1a over everything a tick can change
+uint32_t stateDigest() {
+  uint32_t h = 2166136261u;
+  auto mix = [&h](uint32_t v) { h = (h ^ v) * 16777619u; };
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS; c++) {
+      mix(mapData[r][c]);
+      mix((uint32_t)explosions.endAt[r][c]);
+      mix((uint32_t)bombIndex.at[r][c]);
+    }
+  for (int i = 0; i < MAX_BOMBS; i++) {
+    if (!bombs[i].active) continue;
+    mix(i); mix(bombs[i].x); mix(bombs[i].y); mix(bombs[i].owner); mix(bombs[i].netId);
+    mix((uint32_t)bombs[i].placedAt); mix((uint32_t)bombs[i].fuseMs);
+  }
+  mix(bombIndex.freeMask); mix(bombIndex.lastNetId);
+  mix(timers.count); mix(timers.seq); mix(timers.explosionPending);
+  for (int i = 0; i < timers.count; i++) { mix((uint32_t)timerHeap[i].at); mix(timerHeap[i].seq); mix(timerHeap[i].kind); mix(timerHeap[i].slot); }
+  for (int i = 0; i < STATE_HASH_REGIONS; i++) mix(stateHash().region[i]);
+  mix(stateHash().bombs);
+  mix(playerX); mix(playerY); mix(otherPlayerX); mix(otherPlayerY); mix(lives);
+  mix((uint32_t)spawnInvulEnd); mix(lastDamageEvent); mix(explosionEventCounter);
+  mix((uint32_t)score_local); mix((uint32_t)score_remote);
+  const LockstepSim &ls = lockstep().sim;
+  mix(ls.prevFlags[0]); mix(ls.prevFlags[1]); mix(ls.lastMoveTick[0]); mix(ls.lastMoveTick[1]);
+  mix((uint32_t)ls.peerInvulEnd); mix(ls.peerLastEvent); mix(ls.peerLives); mix(ls.outMask);
+  return h;
+}
+
+struct Costs {
+  double saveNs, restoreNs, stepNs, rollbackNs;
+  unsigned long saves, restores, steps, restoreMismatches;
+  unsigned long rollbacks, resimTicks, maxRollback;
+};
+
+// One round as player 0, the peer's input for tick t arriving before tick
+// t + late is stepped. Returns the digest of the final state.
+uint32_t playRound(unsigned long seed, const std::vector<uint8_t> flags[2], uint32_t late, Costs *c) {
+  myPlayerId = 0;
+  simResetRound(seed);
+  lockstep_begin(millis(), 0, false, true);
+  LockstepStats before = lockstep().stats;
+  unsigned long start = millis();
+  std::vector<RollbackState> ring(late + 1);
+  for (uint32_t t = 0; t < ROUND_TICKS; t++) {
+    lockstep_set_input(flags[0][t]);
+    if (t >= late) deliver(t - late, flags[1][t - late]);
+    host_set_millis(start + (t * 1000 + LOCKSTEP_HZ - 1) / LOCKSTEP_HZ);
+    Clock::time_point t0 = Clock::now();
+    unsigned long rolled = lockstep().stats.rollbacks;
+    lockstep_reconcile();
+    double reconcileNs = nsSince(t0);
+    if (c && lockstep().stats.rollbacks != rolled) c->rollbackNs += reconcileNs;
+    t0 = Clock::now();
+    lockstep_poll(millis());
+    if (c && late == 0) { c->stepNs += nsSince(t0); c->steps++; }
+    if (!c || late == 0) continue;
+
+    // save now, restore the save from `late` ticks ago, then this one again
+    RollbackState &cur = ring[t % (late + 1)];
+    uint32_t digest = stateDigest();
+    t0 = Clock::now();
+    rollback_save(cur, t ? &ring[(t + late) % (late + 1)] : nullptr);
+    c->saveNs += nsSince(t0);
+    c->saves++;
+    if (t < late) continue;
+    t0 = Clock::now();
+    rollback_restore(ring[(t + 1) % (late + 1)]);
+    rollback_restore(cur);
+    c->restoreNs += nsSince(t0);
+    c->restores += 2;
+    if (stateDigest() != digest) c->restoreMismatches++;
+  }
+  // the inputs still in flight
+  for (uint32_t t = ROUND_TICKS - late; t < ROUND_TICKS; t++) deliver(t, flags[1][t]);
+  lockstep_reconcile();
+  if (c) {
+    const LockstepStats &s = lockstep().stats;
+    c->rollbacks += s.rollbacks - before.rollbacks;
+    c->resimTicks += s.resimTicks - before.resimTicks;
+    c->maxRollback = std::max(c->maxRollback, s.maxRollback);
+  }
+  uint32_t digest = stateDigest();
+  lockstep_end();
+  return digest;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long ticks = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 36000UL;
+  uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 12345u;
+  uint32_t late = (argc > 3) ? (uint32_t)strtoul(argv[3], nullptr, 10) : 6u;
+  if (late > ROLLBACK_MAX_TICKS) late = ROLLBACK_MAX_TICKS;
+  if (late == 0) late = 1;
+  XorShift32 rng = {seed ? seed : 1u};
+  unsigned long rounds = std::max(1UL, ticks / ROUND_TICKS);
+
+  host_set_millis(1);
+  Costs ref = {}, rb = {};
+  unsigned long agree = 0;
+  for (unsigned long r = 0; r < rounds; r++) {
+    std::vector<uint8_t> flags[2];
+    unsigned long roundSeed = rng.next();
+    scriptRound(rng, flags);
+    uint32_t want = playRound(roundSeed, flags, 0, &ref);
+    uint32_t got = playRound(roundSeed, flags, late, &rb);
+    if (got == want) agree++;
+  }
+
+  double save = rb.saves ? rb.saveNs / rb.saves : 0.0;
+  double restore = rb.restores ? rb.restoreNs / rb.restores : 0.0;
+  double step = ref.steps ? ref.stepNs / ref.steps : 0.0;
+  double perRollback = rb.rollbacks ? rb.rollbackNs / rb.rollbacks : 0.0;
+  double perResim = rb.resimTicks ? rb.rollbackNs / rb.resimTicks : 0.0;
+  // the deepest rollback: one restore, then a save and a step per tick
+  double deepest = restore + ROLLBACK_MAX_TICKS * (save + step);
+  printf("map %dx%d, MAX_BOMBS=%d, %lu rounds of %u ticks, the peer's input %u ticks (%lu ms) late\n", MAP_COLS,
+         MAP_ROWS, MAX_BOMBS, rounds, ROUND_TICKS, late, (unsigned long)(late * 1000 / LOCKSTEP_HZ));
+  printf("save size      : %zu B per tick (%zu B with the lockstep state, %d kept)\n", sizeof(RollbackState),
+         sizeof(LockstepFrame), ROLLBACK_FRAMES);
+  printf("save           : %.0f ns\n", save);
+  printf("restore        : %.0f ns (%u ticks back and forward again)\n", restore, late);
+  printf("step           : %.0f ns/tick (inputs on time)\n", step);
+  printf("rollback       : %lu, %.1f ticks deep on average (max %lu); %.0f ns each, %.0f ns per tick stepped again\n",
+         rb.rollbacks, rb.rollbacks ? (double)rb.resimTicks / rb.rollbacks : 0.0, rb.maxRollback, perRollback, perResim);
+  printf("frame budget   : %.0f rollbacks of %u ticks per 16.7 ms frame\n", deepest > 0 ? 16666667.0 / deepest : 0.0,
+         ROLLBACK_MAX_TICKS);
+  bool ok = agree == rounds && rb.restoreMismatches == 0;
+  printf("determinism    : %s (%lu of %lu rounds end as with inputs on time, %lu of %lu restores inexact)\n",
+         ok ? "ok" : "FAILED", agree, rounds, rb.restoreMismatches, rb.restores / 2);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+// bench_snapshot.cpp - size and cost of the catch-up snapshot (state_snapshot.h).
+//
+// Plays the bench_engine script (random walk, periodic bombs, round resets)
+// and every SAMPLE_MS captures the round as state_snapshot.h would send it.
+// Each capture is encoded in full and as a delta against the capture
+// SNAPSHOT_RETRY_MS earlier (a snapshot the peer acked one retry ago), then
+// decoded again and compared byte for byte; a mismatch fails the run.
+// Reports the raw size, the encoded sizes, fragments per snapshot and the
+// host cost of capture + encode.
+//
+// usage: bench_snapshot [ticks] [seed]
+#include "sim_sketch.h"
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const unsigned long SAMPLE_MS = 100;
+const int DELTA_LAG = (int)(SNAPSHOT_RETRY_MS / SAMPLE_MS);
+
+struct XorShift32 {
+  uint32_t s;
+  uint32_t next() { s ^= s << 13; s ^= s >> 17; s ^= s << 5; return s; }
+  uint32_t below(uint32_t n) { return next() % n; }
+};
+
+int countBreakables() {
+  int n = 0;
+  for (int r = 0; r < MAP_ROWS; r++) for (int c = 0; c < MAP_COLS; c++) if (mapData[r][c] == TILE_BREAKABLE) n++;
+  return n;
+}
+
+int fragmentsFor(size_t encLen) { return std::max(1, (int)((encLen + SNAPSHOT_FRAG_BYTES - 1) / SNAPSHOT_FRAG_BYTES)); }
+
+// Encode `in` (already XORed with its base, if any), decode it again and
+// check that the round trip gives `in` back.
+bool roundTrip(const uint8_t *in, int rawLen, size_t &encLen) {
+  uint8_t enc[SNAPSHOT_MAX_ENC], dec[SNAPSHOT_MAX_RAW];
+  encLen = snapshot_rle_encode(in, rawLen, enc);
+  if (encLen > (size_t)SNAPSHOT_MAX_ENC) return false;
+  return snapshot_rle_decode(enc, encLen, dec, rawLen) && memcmp(dec, in, rawLen) == 0;
+}
+
+double percentile(std::vector<size_t> v, double p) {
+  if (v.empty()) return 0.0;
+  std::sort(v.begin(), v.end());
+  return (double)v[std::min(v.size() - 1, (size_t)(p * (double)(v.size() - 1) + 0.5))];
+}
+
+double mean(const std::vector<size_t> &v) {
+  double sum = 0.0;
+  for (size_t x : v) sum += (double)x;
+  return v.empty() ? 0.0 : sum / (double)v.size();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long ticks = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 600000UL;
+  uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 12345u;
+  XorShift32 rng = {seed ? seed : 1u};
+
+  host_set_millis(1);
+  simResetRound(rng.next());
+  int breakablesAtStart = countBreakables();
+  int rawLen = snapshot_raw_size();
+
+  // the last DELTA_LAG + 1 captures of the current round
+  std::vector<std::vector<uint8_t>> history;
+  std::vector<size_t> fullSizes, deltaSizes;
+  unsigned long rounds = 1, failures = 0, deltaFrags = 0, fullFrags = 0;
+  double captureNs = 0.0;
+  const int dx[4] = {1, -1, 0, 0};
+  const int dy[4] = {0, 0, 1, -1};
+  for (unsigned long t = 0; t < ticks; t++) {
+    host_advance_millis(1);
+    if (t % 60 == 0) {
+      int d = (int)rng.below(4);
+      int nx = playerX + dx[d], ny = playerY + dy[d];
+      if (mapIsWalkable(nx, ny)) { playerX = nx; playerY = ny; }
+    }
+    if (t % 170 == 0) placeBombAtPlayer();
+    updateBombs();
+    if (t % SAMPLE_MS == SAMPLE_MS - 1) {
+      std::vector<uint8_t> raw(SNAPSHOT_MAX_RAW);
+      Clock::time_point t0 = Clock::now();
+      snapshot_capture(raw.data(), myPlayerId);
+      uint8_t enc[SNAPSHOT_MAX_ENC];
+      size_t len = snapshot_rle_encode(raw.data(), rawLen, enc);
+      captureNs += (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t0).count();
+      (void)len;
+
+      size_t fullLen = 0, deltaLen = 0;
+      if (!roundTrip(raw.data(), rawLen, fullLen)) failures++;
+      fullSizes.push_back(fullLen);
+      fullFrags += fragmentsFor(fullLen);
+      if ((int)history.size() > DELTA_LAG) {
+        const std::vector<uint8_t> &base = history[history.size() - 1 - DELTA_LAG];
+        uint8_t delta[SNAPSHOT_MAX_RAW];
+        for (int i = 0; i < rawLen; i++) delta[i] = (uint8_t)(raw[i] ^ base[i]);
+        if (!roundTrip(delta, rawLen, deltaLen)) failures++;
+        deltaSizes.push_back(deltaLen);
+        deltaFrags += fragmentsFor(deltaLen);
+      }
+      history.push_back(raw);
+      if ((int)history.size() > DELTA_LAG + 1) history.erase(history.begin());
+    }
+    if (t % 5000 == 4999 && countBreakables() * 10 < breakablesAtStart) {
+      simResetRound(rng.next());
+      history.clear();  // a new round starts from a full snapshot
+      rounds++;
+    }
+  }
+
+  printf("map %dx%d, MAX_BOMBS=%d, %lu ticks, %lu rounds, a capture every %lu ms\n",
+         MAP_COLS, MAP_ROWS, MAX_BOMBS, ticks, rounds, SAMPLE_MS);
+  printf("raw snapshot   : %d B\n", rawLen);
+  printf("full snapshot  : mean %.1f B, p95 %.0f B, max %.0f B, %.2f fragments\n", mean(fullSizes),
+         percentile(fullSizes, 0.95), percentile(fullSizes, 1.0),
+         fullSizes.empty() ? 0.0 : (double)fullFrags / (double)fullSizes.size());
+  printf("delta (%lu ms) : mean %.1f B, p95 %.0f B, max %.0f B, %.2f fragments\n", SNAPSHOT_RETRY_MS,
+         mean(deltaSizes), percentile(deltaSizes, 0.95), percentile(deltaSizes, 1.0),
+         deltaSizes.empty() ? 0.0 : (double)deltaFrags / (double)deltaSizes.size());
+  printf("capture+encode : %.0f ns/snapshot\n", fullSizes.empty() ? 0.0 : captureNs / (double)fullSizes.size());
+  printf("round trip     : %s (%lu of %zu encodings differ)\n", failures ? "FAILED" : "ok", failures,
+         fullSizes.size() + deltaSizes.size());
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,493 @@
+// net_impair.cpp - two-player sessions through an impaired link: how fast and
+// how completely the players' states agree.
+//
+// Player 0 and player 1 are two processes running the scripted session of
+// sim_session.h in lockstep on the simulated clock (pipe transport of
+// host_transport.h: one barrier per millisecond tick). Each side sends
+// through the impairment stage of impair.h. Every tick both record a
+// digest of their state (map hash, the set of live bombs keyed by (owner,
+// netId), both scores) and the ticks at which bombs appear in and leave
+// bombs[]. The parent lines the two logs up and reports, per profile:
+//   - how often and for how long mapData, bombs[] and the scores differ,
+//     and whether they agree at the end (after the drain)
+//   - bomb place reflection: owner places -> bomb appears at the peer
+//   - explosion reflection: bomb leaves the owner's bombs[] -> leaves the peer's
+//   - how remote placements were taken (fresh / near-expired / stale per
+//     BOMB_STALE_THRESHOLD_MS) and the reliable channel's work
+//   - with rejoin=MS, how long player 1 takes to catch up after dropping
+//     out of the round (state_snapshot.h)
+//   - with lockstep=1, the round in lockstep.h's fixed-tick mode: ticks,
+//     stalls waiting for the peer's input and the MSG_INPUT traffic; with
+//     rollback=1 also the ticks stepped on a guessed input and the rollbacks
+//   - where each player sees the other against where it is, and the
+//     MSG_POS traffic (remote_player.h; dr=0 for a plain MSG_POS per step)
+//   - what each side's pings (peer_probe_poll()) make of the link: RTT and
+//     loss against what the impairment stage did
+//   - the shared game clock (clock_sync.h): player 1's timer starts
+//     SKEW_US ahead and runs SKEW_PPM fast; how long until it is synced,
+//     its error estimate and the game times of the two sides compared
+// With telemetry=PREFIX each player also writes the records a 'T' on its
+// Serial would get (telemetry_dump.h), every TELEMETRY_EVERY_MS and at the
+// end, to PREFIX-<profile>-p<player>.bin for telemetry_decode.
+// Runs are deterministic for a given seed.
+//
+// usage: net_impair [ms] [seed] [profile|all] [key=value ...]
+//   keys: loss, burst=enter,exit,lossInBad, delay, jitter, dist=uniform|normal|pareto,
+//         reorder, dup (probabilities as fractions, times in ms),
+//         sync=0 (no MSG_STATE_HASH exchange, for comparison),
+//         rejoin=MS (player 1 drops the round MS into the game and joins again),
+//         lockstep=1 (fixed-tick simulation from exchanged inputs; no rejoin),
+//         rollback=1 (lockstep with no input delay, guessing the peer's input),
+//         dr=0 (MSG_POS after every step, no dead reckoning, for comparison),
+//         skew=US,PPM (player 1's timer against player 0's),
+//         telemetry=PREFIX (telemetry records to PREFIX-<profile>-p<player>.bin)
+#include "sim_session.h"
+#include "host_transport.h"
+#include "impair.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+const unsigned long DRAIN_MS = 4000;
+const unsigned long TELEMETRY_EVERY_MS = 10000;
+
+// Conditions we plan for. "event" is a hall full of 2.4 GHz traffic:
+// short loss bursts and a few ms of queueing jitter; "crowded" adds long
+// stalls (Pareto tail), reordering and duplicate frames from the driver's
+// own retries; "edge" is the far end of the room.
+const ImpairConfig PROFILES[] = {
+  {"clean",   0.00f, 0.00f, 0.00f, 0.00f,  2,  0, JITTER_UNIFORM, 0.00f, 0.000f},
+  {"event",   0.03f, 0.02f, 0.30f, 0.70f,  6,  4, JITTER_NORMAL,  0.00f, 0.005f},
+  {"crowded", 0.08f, 0.04f, 0.20f, 0.80f, 10, 15, JITTER_PARETO,  0.03f, 0.020f},
+  {"edge",    0.25f, 0.05f, 0.10f, 0.90f, 15, 20, JITTER_PARETO,  0.05f, 0.020f},
+};
+
+struct Sample {
+  int64_t gameUs;
+  uint32_t t;
+  uint32_t mapHash;
+  uint32_t bombsHash;
+  int32_t s0, s1;
+  uint8_t phase;
+  int8_t px, py;  // our player
+  int8_t ox, oy;  // the peer's as we see it (-1 = not seen)
+};
+
+enum : uint8_t { EV_APPEAR = 0, EV_GONE = 1 };
+struct BombEvent {
+  uint32_t t;
+  uint8_t kind;
+  uint8_t owner;
+  uint16_t id;
+};
+
+struct SideSummary {
+  ImpairStats link;
+  RelStats rel;
+  SimNetState net;
+  StateSyncStats sync;
+  SnapshotStats snap;
+  LockstepStats lock;
+  RemotePlayerStats remote;
+  PeerLinkStats probe;
+  ClockSyncStats clock;
+  int32_t clockErrorUs;
+  double clockDrift;
+  unsigned long rejoinedAt;
+  unsigned long rxDropped;
+  unsigned long remoteSpawned, remoteRefined, remoteDupPlaces, remoteDupExplodes;
+  bool timedOut;
+};
+
+bool stateSyncOn = true;  // sync=0 turns the state digest off
+unsigned long rejoinMs = 0;  // rejoin=MS: player 1 reboots MS into the game
+bool lockstepOn = false;     // lockstep=1
+bool rollbackOn = false;     // rollback=1 (implies lockstep=1)
+bool deadReckoningOn = true; // dr=0: MSG_POS after every step instead
+int64_t skewUs = 123456789;  // skew=US,PPM
+double skewPpm = 40.0;
+std::string telemetryPrefix;  // telemetry=PREFIX
+
+uint32_t bombKey(uint8_t owner, uint16_t id) { return ((uint32_t)owner << 16) | id; }
+
+uint32_t mix(uint32_t x) {
+  x ^= x >> 16; x *= 0x7feb352du; x ^= x >> 15; x *= 0x846ca68bu; x ^= x >> 16;
+  return x;
+}
+
+// ------------------------------------------------------------ one player
+void writeAll(FILE *f, const void *p, size_t n) { fwrite(p, 1, n, f); }
+
+void runPlayer(int player, int fd, const ImpairConfig &cfg, uint32_t seed, unsigned long gameMs, FILE *out) {
+  uint8_t mac[6] = {0x02, 0, 0, 0, 0, (uint8_t)(player + 1)};
+  uint8_t peer[6] = {0x02, 0, 0, 0, 0, (uint8_t)(2 - player)};
+  memcpy(host_wifi_mac(), mac, 6);
+  host_set_millis(1);
+  if (player == 1) host_esp_timer_skew() = {skewUs, skewPpm};
+  hostPipeOpen(fd);
+  net_set_transport(hostImpairTransport(hostPipeTransport(), cfg, seed * 7919u + (uint32_t)player * 104729u + 1u));
+  initEspNow();
+  setPeerMac(peer);
+  addEspNowPeer();
+
+  SimSession s;
+  simSessionBegin(s, player, seed, gameMs, DRAIN_MS);
+  simNet.stateSync = stateSyncOn;
+  s.lockstep = lockstepOn;
+  s.rollback = rollbackOn;
+  s.deadReckoning = deadReckoningOn;
+  unsigned long total = SIM_HANDSHAKE_TIMEOUT_MS + SIM_COUNTDOWN_MS + gameMs + DRAIN_MS;
+  std::map<uint32_t, bool> live;  // bombs[] last tick
+  std::vector<Sample> samples;
+  std::vector<BombEvent> events;
+  samples.reserve(total);
+  FILE *telem = nullptr;
+  if (!telemetryPrefix.empty()) {
+    std::string path = telemetryPrefix + "-" + cfg.name + "-p" + std::to_string(player) + ".bin";
+    telem = fopen(path.c_str(), "wb");
+    if (!telem) perror(path.c_str());
+  }
+  for (unsigned long tick = 1; tick <= total; tick++) {
+    host_set_millis(tick);
+    simSessionStep(s);
+    if (player == 1 && rejoinMs && !lockstepOn && s.phase == PHASE_GAME && tick - s.phaseAt == rejoinMs) simSessionRejoin(s, seed ^ 0x5EEDu);
+
+    Sample sm = {};
+    sm.gameUs = gameTimeUs();
+    sm.t = (uint32_t)tick;
+    sm.mapHash = simMapHash();
+    std::map<uint32_t, bool> now;
+    for (int i = 0; i < MAX_BOMBS; i++) {
+      if (!bombs[i].active) continue;
+      uint32_t k = bombKey(bombs[i].owner, bombs[i].netId);
+      now[k] = true;
+      sm.bombsHash += mix(k * 2654435761u ^ ((uint32_t)bombs[i].x << 8 | (uint32_t)bombs[i].y));
+    }
+    for (auto &kv : now)
+      if (!live.count(kv.first)) events.push_back({(uint32_t)tick, EV_APPEAR, (uint8_t)(kv.first >> 16), (uint16_t)kv.first});
+    for (auto &kv : live)
+      if (!now.count(kv.first)) events.push_back({(uint32_t)tick, EV_GONE, (uint8_t)(kv.first >> 16), (uint16_t)kv.first});
+    live.swap(now);
+    sm.s0 = (int32_t)((player == 0) ? score_local : score_remote);
+    sm.s1 = (int32_t)((player == 0) ? score_remote : score_local);
+    sm.phase = s.phase;
+    sm.px = (int8_t)playerX; sm.py = (int8_t)playerY;
+    sm.ox = otherPlayerVisible ? (int8_t)otherPlayerX : -1;
+    sm.oy = otherPlayerVisible ? (int8_t)otherPlayerY : -1;
+    samples.push_back(sm);
+
+    if (telem && (tick % TELEMETRY_EVERY_MS == 0 || tick == total)) {
+      TelemetryRecord r;
+      telemetry_record_fill(r, tick, myPlayerId);
+      uint8_t buf[TELEM_RECORD_MAX];
+      writeAll(telem, buf, telemetry_record_encode(r, buf));
+    }
+    if (!hostPipeBarrier()) break;
+  }
+  if (telem) fclose(telem);
+
+  SideSummary sum = {};
+  sum.link = hostImpairStats();
+  sum.rel = reliable().stats;
+  sum.net = simNet;
+  sum.sync = state_sync().stats;
+  sum.snap = snapshot_sync().stats;
+  sum.lock = lockstep().stats;
+  sum.remote = remote_player().stats;
+  sum.probe = peer_probe().stats;
+  sum.clock = clock_sync().stats;
+  sum.clockErrorUs = clock_sync_error_us();
+  sum.clockDrift = clock_sync().drift;
+  sum.rejoinedAt = s.rejoinedAt;
+  sum.rxDropped = espnow_rx_queue().dropped.load();
+  sum.remoteSpawned = remoteBombs.spawned;
+  sum.remoteRefined = remoteBombs.refined;
+  sum.remoteDupPlaces = remoteBombs.duplicatePlaces;
+  sum.remoteDupExplodes = remoteBombs.duplicateExplodes;
+  sum.timedOut = s.timedOut;
+  uint32_t n = (uint32_t)samples.size(), m = (uint32_t)events.size();
+  writeAll(out, &sum, sizeof(sum));
+  writeAll(out, &n, 4);
+  writeAll(out, samples.data(), n * sizeof(Sample));
+  writeAll(out, &m, 4);
+  writeAll(out, events.data(), m * sizeof(BombEvent));
+  fflush(out);
+}
+
+// ---------------------------------------------------------------- report
+struct SideLog {
+  SideSummary sum;
+  std::vector<Sample> samples;
+  std::vector<BombEvent> events;
+};
+
+bool readLog(FILE *f, SideLog &log) {
+  rewind(f);
+  uint32_t n = 0, m = 0;
+  if (fread(&log.sum, sizeof(log.sum), 1, f) != 1 || fread(&n, 4, 1, f) != 1) return false;
+  log.samples.resize(n);
+  if (n && fread(log.samples.data(), sizeof(Sample), n, f) != n) return false;
+  if (fread(&m, 4, 1, f) != 1) return false;
+  log.events.resize(m);
+  if (m && fread(log.events.data(), sizeof(BombEvent), m, f) != m) return false;
+  return true;
+}
+
+struct Divergence {
+  unsigned long ticks = 0, longest = 0, run = 0;
+  void add(bool differs) {
+    if (differs) { ticks++; run++; longest = std::max(longest, run); }
+    else run = 0;
+  }
+};
+
+struct Dist {
+  std::vector<long> v;
+  void add(long x) { v.push_back(x); }
+  long pct(double p) {
+    if (v.empty()) return 0;
+    std::sort(v.begin(), v.end());
+    size_t i = (size_t)(p * (v.size() - 1) + 0.5);
+    return v[i];
+  }
+  double mean() const {
+    double s = 0;
+    for (long x : v) s += x;
+    return v.empty() ? 0 : s / v.size();
+  }
+  std::string str() {
+    char b[96];
+    if (v.empty()) return "-";
+    snprintf(b, sizeof(b), "mean %.1f p50 %ld p95 %ld max %ld", mean(), pct(0.5), pct(0.95), pct(1.0));
+    return b;
+  }
+};
+
+void report(const ImpairConfig &cfg, SideLog side[2]) {
+  printf("== %s: loss %.0f%%, burst %.2f/%.2f/%.0f%%, delay %lu ms + %s jitter %lu ms, reorder %.0f%%, dup %.1f%%\n",
+         cfg.name, cfg.loss * 100, cfg.burstEnter, cfg.burstExit, cfg.burstLoss * 100, cfg.delayMs,
+         cfg.dist == JITTER_UNIFORM ? "uniform" : cfg.dist == JITTER_NORMAL ? "normal" : "pareto", cfg.jitterMs,
+         cfg.reorder * 100, cfg.duplicate * 100);
+  for (int p = 0; p < 2; p++) {
+    const SideSummary &s = side[p].sum;
+    unsigned long lost = s.link.lost + s.link.burstLost;
+    printf("  link p%d->p%d : %lu frames, %lu lost (%.1f%%, %lu in bursts), %lu dup, %lu reordered, delay mean %.1f max %lu ms\n",
+           p, 1 - p, s.link.offered, lost, s.link.offered ? 100.0 * lost / s.link.offered : 0.0, s.link.burstLost,
+           s.link.duplicated, s.link.reordered, s.link.offered ? (double)s.link.delaySumMs / (s.link.offered - lost) : 0.0,
+           s.link.delayMaxMs);
+  }
+  for (int p = 0; p < 2; p++) {
+    const SideSummary &s = side[p].sum;
+    printf("  p%d pings: %lu sent, %lu answered, %lu lost (%.1f%%), %lu late; rtt smoothed %.1f min %.1f ms, "
+           "timeout %lu ms; last %d: %d lost\n", p, s.probe.pings, s.probe.pongs, s.probe.lost,
+           s.probe.pings ? 100.0 * s.probe.lost / s.probe.pings : 0.0, s.probe.late, s.probe.srttMs, s.probe.minRttMs,
+           (unsigned long)std::min<float>(std::max<float>(s.probe.srttMs + 4 * s.probe.rttvarMs + 0.5f, PEER_PROBE_TIMEOUT_MIN_MS), PEER_PROBE_TIMEOUT_MAX_MS),
+           s.probe.window, s.probe.windowLost);
+    printf("  p%d reliable: %lu sent, %lu rexmit, %lu gave up, %lu dup suppressed | rx queue drops %lu%s\n", p,
+           s.rel.sent, s.rel.retransmits, s.rel.dropped, s.rel.duplicates, s.rxDropped, s.timedOut ? " | NO HANDSHAKE" : "");
+    printf("  p%d remote placements: %lu fresh, %lu near-expired, %lu stale (%lu by the game clock); %lu spawned, %lu refined, "
+           "%lu dup place, %lu dup explode, %lu deaths rx\n", p, s.net.placeFresh, s.net.placeNearExpired, s.net.placeStale,
+           s.net.placeTimed, s.remoteSpawned, s.remoteRefined, s.remoteDupPlaces, s.remoteDupExplodes, s.net.deaths);
+    if (s.net.explodeTimed)
+      printf("  p%d remote explosions by the game clock: %lu, applied %.1f ms after the blast on average\n", p,
+             s.net.explodeTimed, (double)s.net.explodeLateMs / s.net.explodeTimed);
+    if (s.sync.hashesSent)
+      printf("  p%d state hash: %lu sent, %lu received, %lu differed; desyncs map %lu bombs %lu scores %lu; "
+             "resync %lu msgs %lu B, %lu tiles repaired\n", p, s.sync.hashesSent, s.sync.hashesReceived,
+             s.sync.mismatches, s.sync.mapDesyncs, s.sync.bombDesyncs, s.sync.scoreDesyncs, s.sync.resyncsSent,
+             s.sync.resyncBytes, s.sync.tilesRepaired);
+    if (s.snap.sent || s.snap.applied)
+      printf("  p%d snapshots: %lu sent (%lu full), %lu fragments, %lu B for %lu B raw, %lu acked; %lu applied, %lu base missing\n",
+             p, s.snap.sent, s.snap.full, s.snap.fragments, s.snap.bytes, s.snap.rawBytes, s.snap.acked, s.snap.applied,
+             s.snap.baseMissing);
+    if (s.lock.ticks)
+      printf("  p%d lockstep: %lu ticks, %lu stalls (%lu ms), at most %lu ticks behind; %lu inputs sent (%.1f B each), "
+             "%lu received; %lu peer hits%s\n", p, s.lock.ticks, s.lock.stalls, s.lock.stallMs, s.lock.maxBehind,
+             s.lock.inputsSent, s.lock.inputsSent ? (double)s.lock.inputBytes / s.lock.inputsSent : 0.0,
+             s.lock.inputsReceived, s.lock.peerHits, s.lock.peerLost ? " | PEER LOST" : "");
+    if (s.lock.guessed)
+      printf("  p%d rollback: %lu ticks on a guess, %lu rolled back (%lu ticks stepped again, at most %lu at once)\n", p,
+             s.lock.guessed, s.lock.rollbacks, s.lock.resimTicks, s.lock.maxRollback);
+  }
+
+  // state agreement while both are in the game (or draining)
+  Divergence map, bombsDiv, scores;
+  size_t n = std::min(side[0].samples.size(), side[1].samples.size());
+  unsigned long inGame = 0;
+  for (size_t i = 0; i < n; i++) {
+    const Sample &a = side[0].samples[i], &b = side[1].samples[i];
+    if (a.phase < PHASE_GAME || b.phase < PHASE_GAME) continue;
+    inGame++;
+    map.add(a.mapHash != b.mapHash);
+    bombsDiv.add(a.bombsHash != b.bombsHash);
+    scores.add(a.s0 != b.s0 || a.s1 != b.s1);
+  }
+  auto pctOf = [&](unsigned long x) { return inGame ? 100.0 * x / inGame : 0.0; };
+  printf("  differ (%% of %lu ms, longest run ms): map %.2f%% (%lu), bombs %.2f%% (%lu), scores %.2f%% (%lu)\n", inGame,
+         pctOf(map.ticks), map.longest, pctOf(bombsDiv.ticks), bombsDiv.longest, pctOf(scores.ticks), scores.longest);
+  if (n) {
+    const Sample &a = side[0].samples[n - 1], &b = side[1].samples[n - 1];
+    printf("  at the end: map %s, bombs %s, scores %s (p0 sees %d/%d, p1 sees %d/%d)\n",
+           a.mapHash == b.mapHash ? "agree" : "DIFFER", a.bombsHash == b.bombsHash ? "agree" : "DIFFER",
+           (a.s0 == b.s0 && a.s1 == b.s1) ? "agree" : "DIFFER", a.s0, a.s1, b.s0, b.s1);
+  }
+  // where each side sees the other while both are in the game
+  for (int p = 0; p < 2; p++) {
+    unsigned long seen = 0, onTile = 0, offSum = 0;
+    long offMax = 0;
+    for (size_t i = 0; i < n; i++) {
+      const Sample &a = side[p].samples[i], &b = side[1 - p].samples[i];
+      if (a.phase != PHASE_GAME || b.phase != PHASE_GAME || a.ox < 0) continue;
+      long off = labs((long)a.ox - b.px) + labs((long)a.oy - b.py);
+      seen++;
+      if (off == 0) onTile++;
+      offSum += (unsigned long)off;
+      offMax = std::max(offMax, off);
+    }
+    const RemotePlayerStats &r = side[p].sum.remote;
+    printf("  p%d sees p%d: on its tile %.1f%% of %lu ms, %.2f tiles off on average (max %ld); %lu pos sent, "
+           "%lu applied (%lu corrections, %lu snaps, %lu stale ignored), %lu steps walked on\n", p, 1 - p,
+           seen ? 100.0 * onTile / seen : 0.0, seen, seen ? (double)offSum / seen : 0.0, offMax, r.posSent,
+           r.updates, r.corrections, r.snaps, r.stale, r.extrapolated);
+  }
+  // the game clock: player 1's estimate of player 0's timer
+  {
+    const SideSummary &c = side[1].sum;
+    Dist err;
+    for (size_t i = 0; i < n; i++) {
+      const Sample &a = side[0].samples[i], &b = side[1].samples[i];
+      if (b.phase >= PHASE_GAME) err.add((long)llabs(b.gameUs - a.gameUs));
+    }
+    printf("  clock: p1 %s; %lu probes, %lu used, %lu rejected, %lu restarts; drift %.1f ppm (true %.1f), "
+           "error estimate %ld us; off by us %s in the game\n",
+           c.clock.syncedAt ? ("synced at " + std::to_string(c.clock.syncedAt) + " ms").c_str() : "NOT SYNCED",
+           c.clock.probesSent, c.clock.samples, c.clock.rejected, c.clock.restarts, -c.clockDrift * 1e6, skewPpm,
+           (long)c.clockErrorUs, err.str().c_str());
+  }
+  // samples are indexed by tick - 1 on both sides
+  if (unsigned long at = side[1].sum.rejoinedAt) {
+    long mapAt = -1;
+    for (size_t i = at - 1; i < n && mapAt < 0; i++)
+      if (side[0].samples[i].mapHash == side[1].samples[i].mapHash) mapAt = (long)(i + 1 - at);
+    printf("  p1 rejoined at %lu ms: map agrees again after %ld ms (-1 = never)\n", at, mapAt);
+  }
+
+  // reflection of each bomb on the other side
+  Dist place, explode;
+  unsigned long bombs = 0, neverShown = 0, neverGone = 0, goneEarly = 0;
+  for (int p = 0; p < 2; p++) {
+    std::map<uint32_t, uint32_t> peerAppear, peerGone;
+    for (const BombEvent &e : side[1 - p].events) {
+      if (e.owner != p) continue;
+      uint32_t k = bombKey(e.owner, e.id);
+      if (e.kind == EV_APPEAR && !peerAppear.count(k)) peerAppear[k] = e.t;
+      if (e.kind == EV_GONE) peerGone[k] = e.t;
+    }
+    std::map<uint32_t, uint32_t> ownGone;
+    for (const BombEvent &e : side[p].events)
+      if (e.owner == p && e.kind == EV_GONE) ownGone[bombKey(e.owner, e.id)] = e.t;
+    for (const BombEvent &e : side[p].events) {
+      if (e.owner != p || e.kind != EV_APPEAR) continue;
+      uint32_t k = bombKey(e.owner, e.id);
+      bombs++;
+      auto a = peerAppear.find(k);
+      if (a == peerAppear.end()) { neverShown++; continue; }
+      place.add((long)a->second - (long)e.t);
+      auto g = ownGone.find(k);
+      auto pg = peerGone.find(k);
+      if (g == ownGone.end()) continue;
+      if (pg == peerGone.end()) { neverGone++; continue; }
+      long d = (long)pg->second - (long)g->second;
+      if (d < 0) goneEarly++;
+      explode.add(d);
+    }
+  }
+  printf("  bombs placed %lu: place shown at peer after ms %s; %lu never shown\n", bombs, place.str().c_str(), neverShown);
+  printf("  explosion at peer after ms %s; %lu before the owner's, %lu never\n", explode.str().c_str(), goneEarly, neverGone);
+}
+
+ImpairConfig parseOverrides(ImpairConfig c, int argc, char **argv, int from) {
+  for (int i = from; i < argc; i++) {
+    const char *a = argv[i];
+    const char *eq = strchr(a, '=');
+    if (!eq) continue;
+    std::string key(a, eq - a);
+    const char *v = eq + 1;
+    if (key == "sync") { stateSyncOn = atoi(v) != 0; continue; }
+    if (key == "rejoin") { rejoinMs = strtoul(v, nullptr, 10); continue; }
+    if (key == "lockstep") { lockstepOn = atoi(v) != 0; continue; }
+    if (key == "dr") { deadReckoningOn = atoi(v) != 0; continue; }
+    if (key == "skew") { long long us = 0; sscanf(v, "%lld,%lf", &us, &skewPpm); skewUs = us; continue; }
+    if (key == "telemetry") { telemetryPrefix = v; continue; }
+    if (key == "rollback") { rollbackOn = atoi(v) != 0; if (rollbackOn) lockstepOn = true; continue; }
+    if (key == "loss") c.loss = (float)atof(v);
+    else if (key == "burst") sscanf(v, "%f,%f,%f", &c.burstEnter, &c.burstExit, &c.burstLoss);
+    else if (key == "delay") c.delayMs = strtoul(v, nullptr, 10);
+    else if (key == "jitter") c.jitterMs = strtoul(v, nullptr, 10);
+    else if (key == "dist") c.dist = !strcmp(v, "normal") ? JITTER_NORMAL : !strcmp(v, "pareto") ? JITTER_PARETO : JITTER_UNIFORM;
+    else if (key == "reorder") c.reorder = (float)atof(v);
+    else if (key == "dup") c.duplicate = (float)atof(v);
+    else fprintf(stderr, "unknown key %s\n", key.c_str());
+    c.name = "custom";
+  }
+  return c;
+}
+
+bool runProfile(const ImpairConfig &cfg, uint32_t seed, unsigned long gameMs) {
+  int sv[2];
+  if (!hostPipePair(sv)) return false;
+  FILE *logs[2] = {tmpfile(), tmpfile()};
+  if (!logs[0] || !logs[1]) { perror("tmpfile"); return false; }
+  fflush(stdout);
+  pid_t pids[2];
+  for (int p = 0; p < 2; p++) {
+    pids[p] = fork();
+    if (pids[p] < 0) { perror("fork"); return false; }
+    if (pids[p] == 0) {
+      close(sv[1 - p]);
+      runPlayer(p, sv[p], cfg, seed, gameMs, logs[p]);
+      _exit(0);
+    }
+  }
+  close(sv[0]);
+  close(sv[1]);
+  bool ok = true;
+  for (int p = 0; p < 2; p++) {
+    int status = 0;
+    waitpid(pids[p], &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  SideLog side[2];
+  for (int p = 0; p < 2; p++) {
+    ok = ok && readLog(logs[p], side[p]);
+    fclose(logs[p]);
+  }
+  if (!ok) { printf("== %s: a player failed\n", cfg.name); return false; }
+  report(cfg, side);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long gameMs = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 60000UL;
+  uint32_t seed = (argc > 2) ? (uint32_t)strtoul(argv[2], nullptr, 10) : 12345u;
+  const char *which = (argc > 3) ? argv[3] : "all";
+  printf("%lu ms game + %lu ms drain per profile, seed %u, lockstep on the simulated clock\n", gameMs, DRAIN_MS,
+         (unsigned)seed);
+  bool ok = true, any = false;
+  for (const ImpairConfig &p : PROFILES) {
+    if (strcmp(which, "all") != 0 && strcmp(which, p.name) != 0) continue;
+    ok = runProfile(parseOverrides(p, argc, argv, 4), seed, gameMs) && ok;
+    any = true;
+  }
+  if (!any) { fprintf(stderr, "unknown profile %s\n", which); return 2; }
+  return ok ? 0 : 1;
+}
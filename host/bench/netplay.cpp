@@ -0,0 +1,144 @@
+// netplay.cpp - player 0 against player 1 on one Linux machine over UDP.
+//
+// Each player is a separate process running the game logic (engine, the
+// sketch's protocol handlers through sim_net.cpp, reliable channel, batching)
+// on the UDP transport of host_transport.h, at real time: one loop()
+// iteration per millisecond of wall clock. The round is the scripted
+// session of sim_session.h (ready handshake, countdown with MAP_SYNC,
+// random walk with bombs, drain). At the end each player prints its traffic
+// and a digest of its state (map hash, live bombs, scores as player 0 and
+// player 1 see them).
+//
+// usage: netplay [ms] [seed] [port]                  both players, forked
+//        netplay --player <0|1> [ms] [seed] [port]   one player (start the
+//                                                    other in a second shell)
+// Player p binds 127.0.0.1:port+p.
+#include "sim_session.h"
+#include "host_transport.h"
+
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+namespace {
+
+const unsigned long DRAIN_MS = 1500;
+
+struct Digest {
+  int player;
+  bool ok;
+  uint32_t mapHash;
+  int liveBombs;
+  long s0, s1;  // player 0's and player 1's score as seen here
+  unsigned long framesSent, framesReceived, messages, retransmits, duplicates, rxDropped;
+};
+
+uint64_t wallUs() {
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// Run one player; fills d and returns false if the peer never showed up.
+bool play(int player, unsigned long gameMs, uint32_t seed, uint16_t port, Digest &d) {
+  uint8_t mac[6] = {0x02, 0, 0, 0, 0, (uint8_t)(player + 1)};
+  uint8_t peer[6] = {0x02, 0, 0, 0, 0, (uint8_t)(2 - player)};
+  memcpy(host_wifi_mac(), mac, 6);
+  if (!hostUdpOpen((uint16_t)(port + player), "127.0.0.1", (uint16_t)(port + 1 - player))) return false;
+  net_set_transport(hostUdpTransport());
+  initEspNow();
+  setPeerMac(peer);
+  addEspNowPeer();
+
+  SimSession s;
+  simSessionBegin(s, player, seed, gameMs, DRAIN_MS);
+  // keep answering for a moment after our own drain, until the peer's is over
+  unsigned long linger = 0;
+  uint64_t t0 = wallUs();
+  for (unsigned long tick = 1;; tick++) {
+    // one iteration per wall-clock millisecond
+    while (wallUs() - t0 < tick * 1000ULL) usleep(200);
+    host_set_millis(tick);
+    if (!simSessionStep(s) && (s.timedOut || ++linger >= 200)) break;
+  }
+  bool ok = !s.timedOut;
+  if (!ok) fprintf(stderr, "player %d: no answer from the peer on port %u\n", player, (unsigned)(port + 1 - player));
+
+  d = Digest();
+  d.player = player;
+  d.ok = ok;
+  d.mapHash = simMapHash();
+  for (int i = 0; i < MAX_BOMBS; i++) d.liveBombs += bombs[i].active ? 1 : 0;
+  d.s0 = (player == 0) ? score_local : score_remote;
+  d.s1 = (player == 0) ? score_remote : score_local;
+  d.framesSent = hostUdpStats().framesSent;
+  d.framesReceived = hostUdpStats().framesReceived;
+  d.messages = net_batch().messages;
+  d.retransmits = reliable().stats.retransmits;
+  d.duplicates = reliable().stats.duplicates;
+  d.rxDropped = espnow_rx_queue().dropped.load();
+  hostUdpClose();
+  return ok;
+}
+
+void report(const Digest &d) {
+  printf("player %d: map %08x, %d live bombs, scores p0=%ld p1=%ld | %lu frames out, %lu in, %lu msgs, %lu rexmit, %lu dup, %lu rx dropped%s\n",
+         d.player, (unsigned)d.mapHash, d.liveBombs, d.s0, d.s1, d.framesSent, d.framesReceived, d.messages,
+         d.retransmits, d.duplicates, d.rxDropped, d.ok ? "" : " (no peer)");
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int player = -1;
+  int a = 1;
+  if (argc > 2 && strcmp(argv[1], "--player") == 0) { player = atoi(argv[2]); a = 3; }
+  unsigned long gameMs = (argc > a) ? strtoul(argv[a], nullptr, 10) : 10000UL;
+  uint32_t seed = (argc > a + 1) ? (uint32_t)strtoul(argv[a + 1], nullptr, 10) : 12345u;
+  uint16_t port = (argc > a + 2) ? (uint16_t)strtoul(argv[a + 2], nullptr, 10) : 47000;
+  setvbuf(stdout, nullptr, _IOLBF, 0);
+
+  if (player == 0 || player == 1) {
+    Digest d;
+    bool ok = play(player, gameMs, seed, port, d);
+    report(d);
+    return ok ? 0 : 1;
+  }
+
+  // both players: one child process each, digests sent back over a pipe
+  int fds[2];
+  if (pipe(fds) != 0) { perror("pipe"); return 1; }
+  pid_t pids[2];
+  for (int p = 0; p < 2; p++) {
+    pids[p] = fork();
+    if (pids[p] < 0) { perror("fork"); return 1; }
+    if (pids[p] == 0) {
+      close(fds[0]);
+      Digest d;
+      bool ok = play(p, gameMs, seed, port, d);
+      ssize_t n = write(fds[1], &d, sizeof(d));
+      _exit(ok && n == (ssize_t)sizeof(d) ? 0 : 1);
+    }
+  }
+  close(fds[1]);
+  Digest got[2];
+  bool have[2] = {false, false};
+  Digest d;
+  while (read(fds[0], &d, sizeof(d)) == (ssize_t)sizeof(d)) {
+    if (d.player == 0 || d.player == 1) { got[d.player] = d; have[d.player] = true; }
+  }
+  bool ok = true;
+  for (int p = 0; p < 2; p++) {
+    int status = 0;
+    waitpid(pids[p], &status, 0);
+    ok = ok && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+  }
+  printf("%lu ms game + %lu ms drain, seed %u, UDP ports %u/%u\n", gameMs, DRAIN_MS, (unsigned)seed, (unsigned)port,
+         (unsigned)(port + 1));
+  for (int p = 0; p < 2; p++) if (have[p]) report(got[p]);
+  if (!ok || !have[0] || !have[1]) { printf("a player failed\n"); return 1; }
+  bool mapSame = got[0].mapHash == got[1].mapHash;
+  bool scoresSame = got[0].s0 == got[1].s0 && got[0].s1 == got[1].s1;
+  printf("map %s, scores %s\n", mapSame ? "identical" : "DIFFERENT", scoresSame ? "identical" : "DIFFERENT");
+  return 0;
+}
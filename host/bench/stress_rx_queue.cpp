@@ -0,0 +1,113 @@
+// stress_rx_queue.cpp - two-thread stress run of the receive queue (rx_queue.h).
+//
+// A producer thread plays the ESP-NOW callback and a consumer thread plays
+// loop(). Every frame carries its sequence number and a payload derived from
+// it, with lengths cycling through 4..RX_FRAME_MAX, so the consumer can
+// check order and contents.
+//   - lossless: the producer retries while the queue is full (each failed
+//     try counts as dropped); every frame must arrive, in order and intact.
+//   - overflow: the producer sends bursts of 24 frames without waiting and
+//     the consumer is slowed down;
+//     frames may be dropped, but the ones that arrive must be in order and
+//     intact, and pushed + dropped must equal the frames offered.
+//
+// usage: stress_rx_queue [frames]
+#include <Arduino.h>
+#include "rx_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+int frameLen(uint32_t seq) { return 4 + (int)(seq % (RX_FRAME_MAX - 3)); }
+
+uint8_t payloadByte(uint32_t seq, int i) { return (uint8_t)(seq * 31u + (uint32_t)i * 7u); }
+
+void makeFrame(uint32_t seq, uint8_t *buf, int *len) {
+  *len = frameLen(seq);
+  memcpy(buf, &seq, 4);
+  for (int i = 4; i < *len; i++) buf[i] = payloadByte(seq, i);
+}
+
+struct Check {
+  unsigned long received = 0;
+  unsigned long outOfOrder = 0;
+  unsigned long corrupt = 0;
+};
+
+void verify(const RxFrame &f, uint32_t *expectAtLeast, Check &c) {
+  uint32_t seq;
+  memcpy(&seq, f.data, 4);
+  c.received++;
+  if (seq < *expectAtLeast) c.outOfOrder++;
+  *expectAtLeast = seq + 1;
+  bool ok = f.len == frameLen(seq) && f.src[0] == (uint8_t)seq && f.src[5] == 0xEE;
+  for (int i = 4; ok && i < f.len; i++) ok = f.data[i] == payloadByte(seq, i);
+  if (!ok) c.corrupt++;
+}
+
+bool run(const char *name, unsigned long frames, bool lossless) {
+  RxQueue *queue = new RxQueue();
+  RxQueue &q = *queue;
+  std::atomic<bool> done{false};
+  Check c;
+
+  Clock::time_point t0 = Clock::now();
+  std::thread consumer([&] {
+    uint32_t expect = 0;
+    unsigned long spins = 0;
+    for (;;) {
+      const RxFrame *f = q.peek();
+      if (!f) {
+        if (done.load(std::memory_order_acquire) && !q.peek()) break;
+        std::this_thread::yield();
+        continue;
+      }
+      verify(*f, &expect, c);
+      q.pop();
+      // overflow mode: a slow loop() every few frames
+      if (!lossless && (++spins % 8) == 0) std::this_thread::sleep_for(std::chrono::microseconds(20));
+    }
+  });
+  std::thread producer([&] {
+    uint8_t buf[RX_FRAME_MAX];
+    uint8_t src[6] = {0, 1, 2, 3, 4, 0xEE};
+    for (uint32_t seq = 0; seq < frames; seq++) {
+      int len;
+      makeFrame(seq, buf, &len);
+      src[0] = (uint8_t)seq;
+      if (lossless) {
+        while (!q.push(src, buf, len)) std::this_thread::yield();  // full: retried, counted as dropped
+      } else {
+        q.push(src, buf, len);
+        if (seq % 24 == 23) std::this_thread::sleep_for(std::chrono::microseconds(100));
+      }
+    }
+    done.store(true, std::memory_order_release);
+  });
+  producer.join();
+  consumer.join();
+  double secs = std::chrono::duration<double>(Clock::now() - t0).count();
+
+  unsigned long pushed = q.pushed.load(), dropped = q.dropped.load();
+  bool ok = c.corrupt == 0 && c.outOfOrder == 0 && c.received == pushed &&
+            (lossless ? pushed == frames : pushed + dropped == frames);
+  printf("%-9s: %lu offered, %lu pushed, %lu dropped, %lu received, high water %u/%u, %lu out of order, %lu corrupt, %.2f Mframes/s -> %s\n",
+         name, frames, pushed, dropped, c.received, (unsigned)q.highWater.load(), (unsigned)RX_QUEUE_SLOTS,
+         c.outOfOrder, c.corrupt, frames / secs / 1e6, ok ? "ok" : "FAIL");
+  delete queue;
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  unsigned long frames = (argc > 1) ? strtoul(argv[1], nullptr, 10) : 2000000UL;
+  bool ok = run("lossless", frames, true);
+  ok = run("overflow", frames / 10, false) && ok;
+  return ok ? 0 : 1;
+}
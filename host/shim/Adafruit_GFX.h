@@ -0,0 +1,59 @@
+// Adafruit_GFX.h - host shim with the drawing primitives the game uses.
+// Text output is accepted but not rasterized (only the cursor moves).
+#pragma once
+#include <Arduino.h>
+
+class Adafruit_GFX {
+public:
+  Adafruit_GFX(int16_t w, int16_t h) : WIDTH(w), HEIGHT(h), _width(w), _height(h) { }
+  virtual ~Adafruit_GFX() { }
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    for (int16_t j = 0; j < h; j++) for (int16_t i = 0; i < w; i++) drawPixel(x + i, y + j, color);
+  }
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { fillRect(x, y, w, 1, color); }
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) { fillRect(x, y, 1, h, color); }
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+    drawFastHLine(x, y, w, color); drawFastHLine(x, y + h - 1, w, color);
+    drawFastVLine(x, y, h, color); drawFastVLine(x + w - 1, y, h, color);
+  }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r, uint16_t color) { (void)r; drawRect(x, y, w, h, color); }
+  void fillScreen(uint16_t color) { fillRect(0, 0, _width, _height, color); }
+
+  // Row-major, MSB-first bitmap (same format as Adafruit_GFX::drawBitmap)
+  void drawBitmap(int16_t x, int16_t y, const uint8_t bitmap[], int16_t w, int16_t h, uint16_t color) {
+    int16_t byteWidth = (w + 7) / 8;
+    uint8_t b = 0;
+    for (int16_t j = 0; j < h; j++, y++) {
+      for (int16_t i = 0; i < w; i++) {
+        if (i & 7) b <<= 1;
+        else b = pgm_read_byte(&bitmap[j * byteWidth + i / 8]);
+        if (b & 0x80) drawPixel(x + i, y, color);
+      }
+    }
+  }
+
+  void setTextSize(uint8_t s) { textsize = s; }
+  void setTextColor(uint16_t c) { textcolor = c; }
+  void setCursor(int16_t x, int16_t y) { cursor_x = x; cursor_y = y; }
+  void setTextWrap(bool w) { wrap = w; }
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  size_t print(const char *s) { size_t n = strlen(s); cursor_x += (int16_t)(n * 6 * textsize); return n; }
+  size_t print(char c) { char s[2] = {c, 0}; return print(s); }
+  size_t print(int v) { char s[16]; snprintf(s, sizeof(s), "%d", v); return print(s); }
+  size_t print(unsigned int v) { char s[16]; snprintf(s, sizeof(s), "%u", v); return print(s); }
+  size_t print(long v) { char s[24]; snprintf(s, sizeof(s), "%ld", v); return print(s); }
+  size_t print(unsigned long v) { char s[24]; snprintf(s, sizeof(s), "%lu", v); return print(s); }
+  template <typename T> size_t println(const T &v) { size_t n = print(v); cursor_x = 0; cursor_y += 8 * textsize; return n; }
+
+protected:
+  const int16_t WIDTH, HEIGHT;
+  int16_t _width, _height;
+  int16_t cursor_x = 0, cursor_y = 0;
+  uint8_t textsize = 1;
+  uint16_t textcolor = 1;
+  bool wrap = true;
+};
@@ -0,0 +1,28 @@
+// Adafruit_I2CDevice.h - host shim. Writes are not sent anywhere; the
+// device only counts transactions and bytes so flush paths can be measured.
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+class Adafruit_I2CDevice {
+public:
+  Adafruit_I2CDevice(uint8_t addr, TwoWire *theWire = &Wire) : _addr(addr), _wire(theWire) { }
+  bool begin(bool addr_detect = true) { (void)addr_detect; return true; }
+  bool write(const uint8_t *buffer, size_t len, bool stop = true, const uint8_t *prefix_buffer = nullptr, size_t prefix_len = 0) {
+    (void)buffer; (void)stop; (void)prefix_buffer;
+    transactions++;
+    bytesWritten += len + prefix_len;
+    return true;
+  }
+  size_t maxBufferSize() { return 128; }
+  bool setSpeed(uint32_t desiredclk) { (void)desiredclk; return true; }
+  uint8_t address() { return _addr; }
+
+  // host-only statistics
+  unsigned long transactions = 0;
+  unsigned long bytesWritten = 0;
+
+private:
+  uint8_t _addr;
+  TwoWire *_wire;
+};
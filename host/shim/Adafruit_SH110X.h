@@ -0,0 +1,86 @@
+// Adafruit_SH110X.h - host shim for the SH1107 OLED driver. Keeps the same
+// page-major framebuffer layout and protected members as the real library
+// (buffer, i2c_dev, window_*, _page_start_offset) so code that subclasses
+// the driver compiles unchanged. display() pushes the dirty window through
+// a counting Adafruit_I2CDevice instead of a bus.
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+#include <Adafruit_GFX.h>
+#include <Adafruit_I2CDevice.h>
+
+#define SH110X_BLACK 0
+#define SH110X_WHITE 1
+#define SH110X_INVERSE 2
+#define SH110X_SETPAGEADDR 0xB0
+
+class Adafruit_GrayOLED : public Adafruit_GFX {
+public:
+  Adafruit_GrayOLED(uint16_t w, uint16_t h, TwoWire *twi) : Adafruit_GFX(w, h), _twi(twi) { }
+  ~Adafruit_GrayOLED() { free(buffer); delete i2c_dev; }
+
+  bool _init(uint8_t i2caddr = 0x3C) {
+    if (!buffer) buffer = (uint8_t *)calloc(1, (size_t)WIDTH * ((HEIGHT + 7) / 8));
+    if (!i2c_dev) i2c_dev = new Adafruit_I2CDevice(i2caddr, _twi);
+    clearDisplay();
+    return buffer != nullptr;
+  }
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override {
+    if (!buffer || x < 0 || y < 0 || x >= _width || y >= _height) return;
+    uint8_t &b = buffer[x + (y / 8) * WIDTH];
+    switch (color) {
+      case SH110X_WHITE: b |= (uint8_t)(1 << (y & 7)); break;
+      case SH110X_BLACK: b &= (uint8_t)~(1 << (y & 7)); break;
+      case SH110X_INVERSE: b ^= (uint8_t)(1 << (y & 7)); break;
+    }
+    window_x1 = min(window_x1, x); window_y1 = min(window_y1, y);
+    window_x2 = max(window_x2, x); window_y2 = max(window_y2, y);
+  }
+  void clearDisplay() {
+    if (buffer) memset(buffer, 0, (size_t)WIDTH * ((HEIGHT + 7) / 8));
+    window_x1 = 0; window_y1 = 0; window_x2 = WIDTH - 1; window_y2 = HEIGHT - 1;
+  }
+  uint8_t *getBuffer() { return buffer; }
+
+protected:
+  TwoWire *_twi;
+  Adafruit_I2CDevice *i2c_dev = nullptr;
+  uint8_t *buffer = nullptr;
+  int16_t window_x1 = 0, window_y1 = 0, window_x2 = -1, window_y2 = -1;
+};
+
+class Adafruit_SH110X : public Adafruit_GrayOLED {
+public:
+  Adafruit_SH110X(uint16_t w, uint16_t h, TwoWire *twi) : Adafruit_GrayOLED(w, h, twi) { }
+  bool begin(uint8_t i2caddr = 0x3C, bool reset = true) { (void)reset; return _init(i2caddr); }
+  // Sends the dirty window, page by page, like the real driver.
+  void display() {
+    if (!buffer || !i2c_dev) return;
+    if (window_x2 >= window_x1 && window_y2 >= window_y1) {
+      uint8_t dc_byte = 0x40;
+      size_t maxbuff = i2c_dev->maxBufferSize() - 1;
+      for (int p = window_y1 / 8; p <= window_y2 / 8; p++) {
+        uint8_t *ptr = buffer + (size_t)p * WIDTH + window_x1;
+        size_t remaining = (size_t)(window_x2 - window_x1 + 1);
+        uint8_t col = (uint8_t)(window_x1 + _page_start_offset);
+        uint8_t cmd[] = {0x00, (uint8_t)(SH110X_SETPAGEADDR + p), (uint8_t)(0x10 + (col >> 4)), (uint8_t)(col & 0xF)};
+        i2c_dev->write(cmd, 4);
+        while (remaining) {
+          size_t n = min(remaining, maxbuff);
+          i2c_dev->write(ptr, n, true, &dc_byte, 1);
+          ptr += n; remaining -= n;
+        }
+      }
+    }
+    window_x1 = 1024; window_y1 = 1024; window_x2 = -1; window_y2 = -1;
+  }
+
+protected:
+  uint8_t _page_start_offset = 0;
+};
+
+class Adafruit_SH1107 : public Adafruit_SH110X {
+public:
+  Adafruit_SH1107(uint16_t w, uint16_t h, TwoWire *twi = &Wire, int8_t rst_pin = -1, uint32_t preclk = 400000, uint32_t postclk = 100000)
+    : Adafruit_SH110X(w, h, twi) { (void)rst_pin; (void)preclk; (void)postclk; }
+};
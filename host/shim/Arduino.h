@@ -0,0 +1,100 @@
+// Arduino.h - host (Linux) shim so the sketch headers compile off-device.
+// Only the subset of the Arduino core used by the game is provided. Time is
+// a simulated clock that the host program advances explicitly, so runs are
+// deterministic and independent of wall-clock speed.
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <algorithm>
+
+using std::min;
+using std::max;
+
+// -----------------------------
+// Simulated clock
+// -----------------------------
+inline uint64_t &host_clock_us() { static uint64_t us = 0; return us; }
+inline void host_set_millis(unsigned long ms) { host_clock_us() = (uint64_t)ms * 1000ULL; }
+inline void host_advance_millis(unsigned long ms) { host_clock_us() += (uint64_t)ms * 1000ULL; }
+inline void host_advance_micros(unsigned long us) { host_clock_us() += us; }
+
+inline unsigned long millis() { return (unsigned long)(host_clock_us() / 1000ULL); }
+inline unsigned long micros() { return (unsigned long)host_clock_us(); }
+// delay() advances the simulated clock instead of sleeping
+inline void delay(unsigned long ms) { host_advance_millis(ms); }
+inline void yield() { }
+
+// -----------------------------
+// RNG (small LCG; only needs to be deterministic per seed on the host)
+// -----------------------------
+inline uint32_t &host_rng_state() { static uint32_t s = 1; return s; }
+inline void randomSeed(unsigned long seed) { host_rng_state() = (uint32_t)seed ? (uint32_t)seed : 1u; }
+inline long random(long howbig) {
+  if (howbig <= 0) return 0;
+  uint32_t &s = host_rng_state();
+  s = s * 1664525u + 1013904223u;
+  return (long)((s >> 8) % (uint32_t)howbig);
+}
+inline long random(long howsmall, long howbig) {
+  if (howsmall >= howbig) return howsmall;
+  return random(howbig - howsmall) + howsmall;
+}
+// the hardware RNG on the ESP32; its own state here so it does not move
+// the sequence random() gives a map seed
+inline uint32_t esp_random() {
+  static uint32_t s = 0x9E3779B9u;
+  s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+  return s;
+}
+
+// -----------------------------
+// GPIO / analog
+// -----------------------------
+#define HIGH 0x1
+#define LOW 0x0
+#define INPUT 0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+#define A0 1
+inline void pinMode(int, int) { }
+inline int digitalRead(int) { return HIGH; }
+inline int analogRead(int) { return 0; }
+
+// -----------------------------
+// PROGMEM
+// -----------------------------
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+// -----------------------------
+// Serial (stdout)
+// -----------------------------
+class HostSerial {
+public:
+  void begin(unsigned long) { }
+  int available() { return 0; }
+  int read() { return -1; }
+  size_t write(const uint8_t *buf, size_t len) { return fwrite(buf, 1, len, stdout); }
+  size_t write(uint8_t b) { return fwrite(&b, 1, 1, stdout); }
+  void flush() { fflush(stdout); }
+  int printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+    va_list ap; va_start(ap, fmt); int n = vprintf(fmt, ap); va_end(ap); return n;
+  }
+  void print(const char *s) { fputs(s, stdout); }
+  void print(char c) { fputc(c, stdout); }
+  void print(int v) { ::printf("%d", v); }
+  void print(unsigned int v) { ::printf("%u", v); }
+  void print(long v) { ::printf("%ld", v); }
+  void print(unsigned long v) { ::printf("%lu", v); }
+  void print(double v) { ::printf("%.2f", v); }
+  template <typename T> void println(const T &v) { print(v); fputc('\n', stdout); }
+  void println() { fputc('\n', stdout); }
+};
+inline HostSerial Serial;
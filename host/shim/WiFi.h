@@ -0,0 +1,11 @@
+// WiFi.h - host shim.
+#pragma once
+#include <esp_wifi.h>
+
+typedef enum { WIFI_OFF = 0, WIFI_STA = 1, WIFI_AP = 2, WIFI_AP_STA = 3 } wifi_mode_t;
+
+class HostWiFi {
+public:
+  bool mode(wifi_mode_t m) { (void)m; return true; }
+};
+inline HostWiFi WiFi;
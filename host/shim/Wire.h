@@ -0,0 +1,13 @@
+// Wire.h - host shim for the ESP32 TwoWire controller.
+#pragma once
+#include <Arduino.h>
+
+class TwoWire {
+public:
+  explicit TwoWire(uint8_t busNum = 0) : bus(busNum) { }
+  bool begin(int sda = -1, int scl = -1, uint32_t frequency = 0) { (void)sda; (void)scl; clock = frequency; return true; }
+  void setClock(uint32_t frequency) { clock = frequency; }
+  uint8_t bus;
+  uint32_t clock = 100000;
+};
+inline TwoWire Wire(0);
@@ -0,0 +1,65 @@
+// esp_now.h - host shim for the ESP-IDF ESP-NOW API. Frames handed to
+// esp_now_send() are counted and forwarded to an optional host hook; the
+// registered send callback is invoked synchronously with success.
+#pragma once
+#include <Arduino.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+#define ESP_ERR_ESPNOW_BASE 0x3066
+#define ESP_ERR_ESPNOW_EXIST (ESP_ERR_ESPNOW_BASE + 7)
+#define ESP_NOW_ETH_ALEN 6
+#define ESP_NOW_MAX_DATA_LEN 250
+
+typedef enum { WIFI_IF_STA = 0, WIFI_IF_AP = 1 } wifi_interface_t;
+
+typedef enum { ESP_NOW_SEND_SUCCESS = 0, ESP_NOW_SEND_FAIL } esp_now_send_status_t;
+
+typedef struct { const uint8_t *des_addr; const uint8_t *src_addr; } wifi_tx_info_t;
+
+typedef struct esp_now_recv_info {
+  uint8_t *src_addr;
+  uint8_t *des_addr;
+  void *rx_ctrl;
+} esp_now_recv_info_t;
+
+typedef struct {
+  uint8_t peer_addr[ESP_NOW_ETH_ALEN];
+  uint8_t lmk[16];
+  uint8_t channel;
+  wifi_interface_t ifidx;
+  bool encrypt;
+  void *priv;
+} esp_now_peer_info_t;
+
+typedef void (*esp_now_send_cb_t)(const wifi_tx_info_t *tx_info, esp_now_send_status_t status);
+typedef void (*esp_now_recv_cb_t)(const esp_now_recv_info_t *info, const uint8_t *data, int len);
+
+struct HostEspNow {
+  esp_now_send_cb_t sendCb = nullptr;
+  esp_now_recv_cb_t recvCb = nullptr;
+  // optional host hook that carries the frame somewhere (loopback, UDP, ...)
+  bool (*sendHook)(const uint8_t *peer, const uint8_t *data, size_t len) = nullptr;
+  unsigned long framesSent = 0;
+  unsigned long bytesSent = 0;
+};
+inline HostEspNow &host_espnow() { static HostEspNow s; return s; }
+
+inline esp_err_t esp_now_init() { return ESP_OK; }
+inline esp_err_t esp_now_deinit() { return ESP_OK; }
+inline esp_err_t esp_now_register_send_cb(esp_now_send_cb_t cb) { host_espnow().sendCb = cb; return ESP_OK; }
+inline esp_err_t esp_now_register_recv_cb(esp_now_recv_cb_t cb) { host_espnow().recvCb = cb; return ESP_OK; }
+inline esp_err_t esp_now_add_peer(const esp_now_peer_info_t *peer) { (void)peer; return ESP_OK; }
+
+inline esp_err_t esp_now_send(const uint8_t *peer_addr, const uint8_t *data, size_t len) {
+  HostEspNow &s = host_espnow();
+  s.framesSent++;
+  s.bytesSent += len;
+  bool ok = s.sendHook ? s.sendHook(peer_addr, data, len) : true;
+  if (s.sendCb) {
+    wifi_tx_info_t info = {peer_addr, nullptr};
+    s.sendCb(&info, ok ? ESP_NOW_SEND_SUCCESS : ESP_NOW_SEND_FAIL);
+  }
+  return ESP_OK;
+}
@@ -0,0 +1,17 @@
+// esp_timer.h - host shim. esp_timer_get_time() reads the simulated clock.
+// A host program can set an offset and a rate error with
+// host_esp_timer_skew() to stand for a second device's free-running timer.
+#pragma once
+#include <Arduino.h>
+
+struct HostTimerSkew {
+  int64_t offsetUs;
+  double ppm;  // > 0: this timer runs fast
+};
+inline HostTimerSkew &host_esp_timer_skew() { static HostTimerSkew s = {}; return s; }
+
+inline int64_t esp_timer_get_time() {
+  const HostTimerSkew &s = host_esp_timer_skew();
+  int64_t t = (int64_t)host_clock_us();
+  return t + s.offsetUs + (int64_t)((double)t * s.ppm / 1e6);
+}
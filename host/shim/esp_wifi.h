@@ -0,0 +1,7 @@
+// esp_wifi.h - host shim.
+#pragma once
+#include <esp_now.h>
+
+inline uint8_t *host_wifi_mac() { static uint8_t mac[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01}; return mac; }
+inline esp_err_t esp_wifi_start() { return ESP_OK; }
+inline esp_err_t esp_wifi_get_mac(wifi_interface_t ifx, uint8_t mac[6]) { (void)ifx; memcpy(mac, host_wifi_mac(), 6); return ESP_OK; }
@@ -0,0 +1,3 @@
+// pgmspace.h - host shim: PROGMEM data lives in ordinary memory.
+#pragma once
+#include <Arduino.h>
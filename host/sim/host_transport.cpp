@@ -0,0 +1,192 @@
+// host_transport.cpp - UDP and in-process loopback transports (see host_transport.h).
+#include "host_transport.h"
+#include "espnow_net.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <deque>
+#include <vector>
+
+namespace {
+
+// ---------------------------------------------------------------- UDP
+int udpFd = -1;
+sockaddr_in udpPeer;
+HostLinkStats udpStats;
+
+bool udpBegin() { return udpFd >= 0; }
+
+bool udpAddPeer(const uint8_t mac[6]) { (void)mac; return udpFd >= 0; }
+
+bool udpSend(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  (void)mac;  // one peer per socket
+  if (udpFd < 0 || len > ESP_NOW_MAX_DATA_LEN) { udpStats.sendErrors++; return false; }
+  uint8_t pkt[6 + ESP_NOW_MAX_DATA_LEN];
+  memcpy(pkt, host_wifi_mac(), 6);
+  memcpy(pkt + 6, data, len);
+  ssize_t n = sendto(udpFd, pkt, 6 + len, 0, (const sockaddr *)&udpPeer, sizeof(udpPeer));
+  if (n != (ssize_t)(6 + len)) { udpStats.sendErrors++; return false; }
+  udpStats.framesSent++;
+  udpStats.bytesSent += len;
+  return true;
+}
+
+void udpPoll() {
+  if (udpFd < 0) return;
+  uint8_t pkt[6 + ESP_NOW_MAX_DATA_LEN + 1];
+  for (;;) {
+    ssize_t n = recv(udpFd, pkt, sizeof(pkt), 0);
+    if (n < 0) break;  // EAGAIN: nothing left
+    if (n <= 6 || n > 6 + ESP_NOW_MAX_DATA_LEN) continue;
+    udpStats.framesReceived++;
+    udpStats.bytesReceived += (unsigned long)(n - 6);
+    net_on_frame(pkt, pkt + 6, (int)(n - 6));
+  }
+}
+
+const NetTransport udpTransport = { "udp", udpBegin, udpAddPeer, udpSend, udpPoll };
+
+// ----------------------------------------------------------- loopback
+struct InFlight {
+  unsigned long at;
+  std::vector<uint8_t> data;
+};
+std::deque<InFlight> loopWire;
+uint8_t loopPeer[6];
+unsigned long loopDelayMs = 0;
+HostLinkStats loopStats;
+
+bool loopBegin() { return true; }
+
+bool loopAddPeer(const uint8_t mac[6]) { (void)mac; return true; }
+
+bool loopSend(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  (void)mac;
+  loopWire.push_back({millis() + loopDelayMs, std::vector<uint8_t>(data, data + len)});
+  loopStats.framesSent++;
+  loopStats.bytesSent += len;
+  return true;
+}
+
+void loopPoll() {
+  while (!loopWire.empty() && (long)(millis() - loopWire.front().at) >= 0) {
+    InFlight f = loopWire.front();
+    loopWire.pop_front();
+    loopStats.framesReceived++;
+    loopStats.bytesReceived += f.data.size();
+    net_on_frame(loopPeer, f.data.data(), (int)f.data.size());
+  }
+}
+
+const NetTransport loopTransport = { "loopback", loopBegin, loopAddPeer, loopSend, loopPoll };
+
+// --------------------------------------------------------------- pipe
+const uint8_t PIPE_TICK_MARK = 0xFF;  // 1-byte datagram: end of the sender's tick
+int pipeFd = -1;
+std::deque<std::vector<uint8_t>> pipeHeld;  // src + frame, delivered on poll
+HostLinkStats pipeStats;
+
+bool pipeBegin() { return pipeFd >= 0; }
+
+bool pipeAddPeer(const uint8_t mac[6]) { (void)mac; return pipeFd >= 0; }
+
+bool pipeSend(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  (void)mac;
+  if (pipeFd < 0 || len > ESP_NOW_MAX_DATA_LEN) { pipeStats.sendErrors++; return false; }
+  uint8_t pkt[6 + ESP_NOW_MAX_DATA_LEN];
+  memcpy(pkt, host_wifi_mac(), 6);
+  memcpy(pkt + 6, data, len);
+  if (send(pipeFd, pkt, 6 + len, 0) != (ssize_t)(6 + len)) { pipeStats.sendErrors++; return false; }
+  pipeStats.framesSent++;
+  pipeStats.bytesSent += len;
+  return true;
+}
+
+void pipePoll() {
+  while (!pipeHeld.empty()) {
+    std::vector<uint8_t> f = pipeHeld.front();
+    pipeHeld.pop_front();
+    pipeStats.framesReceived++;
+    pipeStats.bytesReceived += f.size() - 6;
+    net_on_frame(f.data(), f.data() + 6, (int)f.size() - 6);
+  }
+}
+
+const NetTransport pipeTransport = { "pipe", pipeBegin, pipeAddPeer, pipeSend, pipePoll };
+
+}  // namespace
+
+bool hostUdpOpen(uint16_t localPort, const char *peerHost, uint16_t peerPort) {
+  hostUdpClose();
+  udpStats = HostLinkStats();
+  int fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0) { perror("udp socket"); return false; }
+  int one = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  sockaddr_in local = {};
+  local.sin_family = AF_INET;
+  local.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  local.sin_port = htons(localPort);
+  if (bind(fd, (const sockaddr *)&local, sizeof(local)) != 0) { perror("udp bind"); close(fd); return false; }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  memset(&udpPeer, 0, sizeof(udpPeer));
+  udpPeer.sin_family = AF_INET;
+  udpPeer.sin_port = htons(peerPort);
+  if (inet_pton(AF_INET, peerHost, &udpPeer.sin_addr) != 1) {
+    fprintf(stderr, "udp: bad peer address %s\n", peerHost);
+    close(fd);
+    return false;
+  }
+  udpFd = fd;
+  return true;
+}
+
+void hostUdpClose() {
+  if (udpFd >= 0) close(udpFd);
+  udpFd = -1;
+}
+
+const NetTransport *hostUdpTransport() { return &udpTransport; }
+HostLinkStats &hostUdpStats() { return udpStats; }
+
+void hostLoopbackOpen(const uint8_t peer[6], unsigned long delayMs) {
+  memcpy(loopPeer, peer, 6);
+  loopDelayMs = delayMs;
+  loopWire.clear();
+  loopStats = HostLinkStats();
+}
+
+const NetTransport *hostLoopbackTransport() { return &loopTransport; }
+HostLinkStats &hostLoopbackStats() { return loopStats; }
+
+bool hostPipePair(int fds[2]) {
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds) == 0) return true;
+  perror("socketpair");
+  return false;
+}
+
+void hostPipeOpen(int fd) {
+  pipeFd = fd;
+  pipeHeld.clear();
+  pipeStats = HostLinkStats();
+}
+
+const NetTransport *hostPipeTransport() { return &pipeTransport; }
+HostLinkStats &hostPipeStats() { return pipeStats; }
+
+bool hostPipeBarrier() {
+  if (pipeFd < 0) return false;
+  if (send(pipeFd, &PIPE_TICK_MARK, 1, 0) != 1) return false;
+  uint8_t pkt[6 + ESP_NOW_MAX_DATA_LEN];
+  for (;;) {
+    ssize_t n = recv(pipeFd, pkt, sizeof(pkt), 0);
+    if (n <= 0) return false;  // closed
+    if (n == 1 && pkt[0] == PIPE_TICK_MARK) return true;
+    if (n > 6) pipeHeld.push_back(std::vector<uint8_t>(pkt, pkt + n));
+  }
+}
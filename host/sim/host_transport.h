@@ -0,0 +1,49 @@
+// host_transport.h - Linux backends for net_transport.h.
+//
+// udp: frames travel as UDP datagrams (normally on 127.0.0.1), so two
+// processes, each running one instance of the game logic, play each other.
+// A datagram is the sender's 6-byte address (host_wifi_mac()) followed by
+// the frame, so the receiver sees the same src_mac as over ESP-NOW.
+//
+// loopback: in-process; every frame sent comes back to the sender after a
+// fixed delay, as if sent by the peer. Used by bench_net, where one instance
+// acks its own reliable messages.
+//
+// pipe: a connected AF_UNIX SOCK_SEQPACKET socket (socketpair()) to a peer
+// process, for lockstep runs on the simulated clock. Frames received are held
+// until the next poll(); hostPipeBarrier() ends a tick: it tells the peer and
+// collects everything the peer sent during its tick, so each frame is
+// delivered one tick after it was sent, deterministically.
+//
+// Select one with net_set_transport() before initEspNow().
+#pragma once
+
+#include <Arduino.h>
+#include "net_transport.h"
+
+struct HostLinkStats {
+  unsigned long framesSent;
+  unsigned long bytesSent;
+  unsigned long framesReceived;
+  unsigned long bytesReceived;
+  unsigned long sendErrors;
+};
+
+// Bind localPort and send to peerHost:peerPort. False (with a message on
+// stderr) if the socket cannot be set up.
+bool hostUdpOpen(uint16_t localPort, const char *peerHost, uint16_t peerPort);
+void hostUdpClose();
+const NetTransport *hostUdpTransport();
+HostLinkStats &hostUdpStats();
+
+void hostLoopbackOpen(const uint8_t peer[6], unsigned long delayMs);
+const NetTransport *hostLoopbackTransport();
+HostLinkStats &hostLoopbackStats();
+
+// Create the connected pair (one end per player process).
+bool hostPipePair(int fds[2]);
+void hostPipeOpen(int fd);
+const NetTransport *hostPipeTransport();
+HostLinkStats &hostPipeStats();
+// False once the peer has closed its end.
+bool hostPipeBarrier();
@@ -0,0 +1,136 @@
+// impair.cpp - netem-style impairment stage (see impair.h).
+#include "impair.h"
+
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+namespace {
+
+struct Held {
+  unsigned long due;
+  uint32_t order;  // send order, keeps equal due times FIFO
+  uint8_t mac[6];
+  std::vector<uint8_t> data;
+};
+
+const NetTransport *inner = nullptr;
+ImpairConfig cfg;
+ImpairStats stats;
+uint32_t rng = 1;
+bool badState = false;
+uint32_t sendOrder = 0;
+std::vector<Held> held;  // min-heap on (due, order)
+
+uint32_t nextRandom() {
+  rng ^= rng << 13; rng ^= rng >> 17; rng ^= rng << 5;
+  return rng;
+}
+
+// uniform in [0, 1)
+double uniform() { return (nextRandom() >> 8) * (1.0 / 16777216.0); }
+
+bool chance(float p) { return p > 0 && uniform() < p; }
+
+unsigned long drawDelay() {
+  double d = (double)cfg.delayMs;
+  double j = (double)cfg.jitterMs;
+  if (j > 0) {
+    switch (cfg.dist) {
+      case JITTER_UNIFORM:
+        d += (uniform() * 2.0 - 1.0) * j;
+        break;
+      case JITTER_NORMAL: {
+        // Box-Muller
+        double u1 = uniform(), u2 = uniform();
+        if (u1 < 1e-12) u1 = 1e-12;
+        d += j * sqrt(-2.0 * log(u1)) * cos(2.0 * M_PI * u2);
+        break;
+      }
+      case JITTER_PARETO: {
+        // shape 3, scale chosen so the mean of the added delay is j
+        const double shape = 3.0;
+        double xm = j * (shape - 1.0) / shape;
+        double u = 1.0 - uniform();
+        d += xm / pow(u, 1.0 / shape) - xm;
+        break;
+      }
+    }
+  }
+  return d < 0 ? 0 : (unsigned long)(d + 0.5);
+}
+
+// heap order for std::push_heap (a max-heap): true if a is due after b
+bool heldLater(const Held &a, const Held &b) {
+  long d = (long)(a.due - b.due);
+  return d > 0 || (d == 0 && (int32_t)(a.order - b.order) > 0);
+}
+
+void forward(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  stats.forwarded++;
+  inner->send(mac, data, len);
+}
+
+void enqueue(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  unsigned long delay = 0;
+  if (chance(cfg.reorder)) stats.reordered++;
+  else delay = drawDelay();
+  stats.delaySumMs += delay;
+  if (delay > stats.delayMaxMs) stats.delayMaxMs = delay;
+  if (delay == 0) { forward(mac, data, len); return; }
+  Held h;
+  h.due = millis() + delay;
+  h.order = sendOrder++;
+  memcpy(h.mac, mac, 6);
+  h.data.assign(data, data + len);
+  held.push_back(h);
+  std::push_heap(held.begin(), held.end(), heldLater);
+}
+
+bool impairBegin() { return inner->begin(); }
+
+bool impairAddPeer(const uint8_t mac[6]) { return inner->addPeer(mac); }
+
+bool impairSend(const uint8_t mac[6], const uint8_t *data, size_t len) {
+  stats.offered++;
+  if (cfg.burstEnter > 0) {
+    if (!badState && chance(cfg.burstEnter)) badState = true;
+    else if (badState && chance(cfg.burstExit)) badState = false;
+    if (badState && chance(cfg.burstLoss)) { stats.burstLost++; return true; }
+  }
+  if (chance(cfg.loss)) { stats.lost++; return true; }  // the radio reports success either way
+  enqueue(mac, data, len);
+  if (chance(cfg.duplicate)) {
+    stats.duplicated++;
+    enqueue(mac, data, len);
+  }
+  return true;
+}
+
+void impairPoll() {
+  unsigned long now = millis();
+  while (!held.empty() && (long)(now - held.front().due) >= 0) {
+    std::pop_heap(held.begin(), held.end(), heldLater);
+    Held h = held.back();
+    held.pop_back();
+    forward(h.mac, h.data.data(), h.data.size());
+  }
+  if (inner->poll) inner->poll();
+}
+
+const NetTransport impairTransport = { "impair", impairBegin, impairAddPeer, impairSend, impairPoll };
+
+}  // namespace
+
+const NetTransport *hostImpairTransport(const NetTransport *in, const ImpairConfig &c, uint32_t seed) {
+  inner = in;
+  cfg = c;
+  stats = ImpairStats();
+  rng = seed ? seed : 1;
+  badState = false;
+  sendOrder = 0;
+  held.clear();
+  return &impairTransport;
+}
+
+ImpairStats &hostImpairStats() { return stats; }
@@ -0,0 +1,51 @@
+// impair.h - netem-style impairment stage in front of a host transport.
+//
+// hostImpairTransport() wraps another NetTransport. Every frame sent
+// through it may be:
+//   - lost: independently with `loss`, or in bursts with the two-state
+//     Gilbert-Elliott model (a good state and a bad state; each frame first
+//     moves good->bad with burstEnter or bad->good with burstExit, then is
+//     lost with burstLoss while bad)
+//   - delayed: delayMs plus jitter drawn from the chosen distribution,
+//     on the simulated clock; frames are released in due order, so jitter
+//     larger than the send interval reorders them
+//   - reordered: with `reorder` a frame skips the delay and goes out at once,
+//     overtaking the delayed ones (netem's reorder)
+//   - duplicated: with `duplicate` a second copy is sent, with its own delay
+// Delayed frames are handed to the inner transport from poll(), which then
+// polls the inner transport. The draws come from one seeded generator, so
+// a run on the simulated clock is repeatable.
+#pragma once
+
+#include <Arduino.h>
+#include "net_transport.h"
+
+enum JitterDist : uint8_t {
+  JITTER_UNIFORM = 0, // delay + [-jitter, +jitter]
+  JITTER_NORMAL = 1,  // delay + N(0, jitter), clipped at zero
+  JITTER_PARETO = 2   // delay + Pareto tail with mean `jitter` (rare long stalls)
+};
+
+struct ImpairConfig {
+  const char *name;
+  float loss;                               // independent loss probability
+  float burstEnter, burstExit, burstLoss;   // Gilbert-Elliott (burstEnter = 0: off)
+  unsigned long delayMs, jitterMs;
+  JitterDist dist;
+  float reorder;
+  float duplicate;
+};
+
+struct ImpairStats {
+  unsigned long offered;     // frames handed to send()
+  unsigned long lost;        // dropped by `loss`
+  unsigned long burstLost;   // dropped in the bad state
+  unsigned long duplicated;
+  unsigned long reordered;   // sent without the delay
+  unsigned long forwarded;   // copies given to the inner transport
+  unsigned long delaySumMs, delayMaxMs;
+};
+
+// Impair everything sent through `inner` (one instance per process).
+const NetTransport *hostImpairTransport(const NetTransport *inner, const ImpairConfig &cfg, uint32_t seed);
+ImpairStats &hostImpairStats();
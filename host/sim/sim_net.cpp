@@ -0,0 +1,40 @@
+// sim_net.cpp - the sketch's protocol handlers (game_handlers.h) for host programs (see sim_net.h).
+#include "sim_net.h"
+#include "game_handlers.h"
+
+SimNetState simNet;
+bool peerReady = false;
+unsigned long peerReadyAt = 0;
+
+void simNetReset() {
+  simNet = SimNetState();
+  simNet.finalWinnerId = -1;
+  simNet.stateSync = true;
+  peerReady = false;
+  peerReadyAt = 0;
+}
+
+// the sketch's side of game_handlers.h: waiting until the round starts
+bool game_waiting_for_peer() { return !simNet.inRound; }
+
+bool game_round_running() { return simNet.inRound; }
+
+void game_ended_by_peer(int winnerId) {
+  simNet.finalWinnerId = winnerId;
+  simNet.gameEnded = true;
+}
+
+void on_game_rx(GameRxEvent ev, unsigned long value) {
+  switch (ev) {
+    case GAME_RX_JOIN: simNet.joins++; break;
+    case GAME_RX_POS: simNet.positions++; break;
+    case GAME_RX_INPUT: simNet.inputs++; break;
+    case GAME_RX_PLACE_FRESH: simNet.placeFresh++; break;
+    case GAME_RX_PLACE_NEAR_EXPIRED: simNet.placeNearExpired++; break;
+    case GAME_RX_PLACE_STALE: simNet.placeStale++; break;
+    case GAME_RX_PLACE_TIMED: simNet.placeTimed++; break;
+    case GAME_RX_EXPLODE_TIMED: simNet.explodeTimed++; simNet.explodeLateMs += value; break;
+    case GAME_RX_DEATH: simNet.deaths++; break;
+    case GAME_RX_MAP_SYNC: simNet.mapSyncReceived = true; break;
+  }
+}
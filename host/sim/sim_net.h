@@ -0,0 +1,37 @@
+// sim_net.h - the sketch's protocol handlers for host programs.
+//
+// sim_net.cpp includes game_handlers.h, the game_on_*() hooks of
+// espnow_game.h that the sketches include (remote bomb place/explode with
+// the age or game time and BOMB_STALE_THRESHOLD_MS rules, clock probes,
+// score and death updates, MAP_SYNC, join and ready, lockstep inputs), and
+// gives them the host's side: the round state of sim_session.h in place of
+// the sketch's gameState, and counters of what arrived. Add it to the
+// sources of a host program that plays against a peer; being weak hooks,
+// the handlers are only picked up from an object file linked directly into
+// the executable.
+#pragma once
+
+#include "sim_sketch.h"
+
+// What the sketch keeps in its waiting/ending state, reduced to the host.
+struct SimNetState {
+  bool mapSyncReceived;     // MAP_SYNC snapshot applied to pending_map_seed
+  bool gameEnded;           // GAME_END snapshot received
+  int finalWinnerId;
+  unsigned long joins, positions, inputs;
+  // MSG_BOMB_PLACE by the age it arrived with (game_on_bomb_place() in game_handlers.h)
+  unsigned long placeFresh;        // age < fuse: placed with the remaining fuse
+  unsigned long placeNearExpired;  // fuse passed by at most BOMB_STALE_THRESHOLD_MS: BOMB_MIN_REMAIN_MS left
+  unsigned long placeStale;        // older: treated as already exploded
+  unsigned long placeTimed;        // any of these, aged by the game clock (clock_sync.h)
+  unsigned long explodeTimed;      // MSG_BOMB_EXPLODE with a game time
+  unsigned long explodeLateMs;     // ... summed: how long after the blast they arrived
+  unsigned long deaths;            // MSG_PLAYER_DEATH applied
+  bool stateSync;                  // send MSG_STATE_HASH (state_sync.h); on after simNetReset()
+  bool inRound;                    // the round runs: digests and JOINs are answered, heartbeats ignored
+};
+extern SimNetState simNet;
+extern bool peerReady;          // MSG_HEARTBEAT seen before the round (game_handlers.h)
+extern unsigned long peerReadyAt;
+
+void simNetReset();
@@ -0,0 +1,162 @@
+// sim_session.cpp - scripted two-player session (see sim_session.h).
+#include "sim_session.h"
+
+namespace {
+
+const unsigned long READY_INTERVAL_MS = 100;
+
+uint32_t nextRandom(uint32_t &s) {
+  s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+  return s;
+}
+
+void enterPhase(SimSession &s, SimPhase p) {
+  s.phase = p;
+  s.phaseAt = millis();
+}
+
+}  // namespace
+
+void simSessionBegin(SimSession &s, int player, uint32_t seed, unsigned long gameMs, unsigned long drainMs) {
+  s = SimSession();
+  s.player = player;
+  s.seed = seed;
+  s.gameMs = gameMs;
+  s.drainMs = drainMs;
+  s.rng = seed * 2u + (uint32_t)player + 1u;
+  if (!s.rng) s.rng = 1;
+  myPlayerId = (uint8_t)player;
+  simNetworked = true;
+  simNetReset();
+  pending_map_seed = 0;
+  bombResetAll();
+  timerReset();
+  reliable() = ReliableState();
+  net_batch() = NetBatch();
+  state_sync() = StateSync();
+  snapshot_sync() = SnapshotSync();
+  lockstep_end();
+  lockstep() = Lockstep();
+  remote_player() = RemotePlayer();
+  clock_sync() = ClockSync();
+  peer_probe_reset();
+  s.deadReckoning = true;
+  enterPhase(s, PHASE_WAITING);
+  s.lastReady = millis() - READY_INTERVAL_MS;
+}
+
+bool simSessionStep(SimSession &s) {
+  unsigned long now = millis();
+  NetBatchScope batch;
+  espnow_poll_rx();
+  reliable_poll(now, myPlayerId);
+  peer_probe_poll(now);
+  clock_sync_poll(now);
+  if (s.phase == PHASE_DONE) {
+    // over, but still answering the peer
+    if (lockstep().active) lockstep_poll(now);
+    else if (!s.timedOut) updateBombs();
+    return false;
+  }
+
+  if (s.phase == PHASE_WAITING || s.phase == PHASE_COUNTDOWN) {
+    if (now - s.lastReady >= READY_INTERVAL_MS) { send_ready(myPlayerId); s.lastReady = now; }
+    if (s.phase == PHASE_WAITING && peerReady) {
+      // player 0 is authoritative for the map seed
+      if (s.player == 0 && pending_map_seed == 0) {
+        pending_map_seed = s.seed;
+        uint8_t payload[5];
+        payload[0] = 0x02;  // MAP_SYNC
+        memcpy(&payload[1], &s.seed, 4);
+        send_state_snapshot(payload, sizeof(payload), myPlayerId);
+      }
+      enterPhase(s, PHASE_COUNTDOWN);
+    } else if (s.phase == PHASE_WAITING && now - s.phaseAt >= SIM_HANDSHAKE_TIMEOUT_MS) {
+      s.timedOut = true;
+      s.phase = PHASE_DONE;
+      return false;
+    } else if (s.phase == PHASE_COUNTDOWN && now - s.phaseAt >= SIM_COUNTDOWN_MS) {
+      // without MAP_SYNC this is the sketch's fallback: a map of our own
+      simResetRound(pending_map_seed);
+      state_sync_reset(now);
+      snapshot_round_start(now);
+      simNet.inRound = true;
+      remote_player_reset();
+      if (s.lockstep) lockstep_begin(now, myPlayerId, false, s.rollback);
+      send_join(myPlayerId);
+      send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
+      enterPhase(s, PHASE_GAME);
+    }
+    return true;
+  }
+
+  if (s.phase == PHASE_GAME) {
+    static const uint8_t dirFlag[4] = {0x08, 0x04, 0x02, 0x01};
+    unsigned long t = now - s.phaseAt;
+    if (s.lockstep) {
+      // the walk and the bombs as button presses, released after 30 ms
+      if (t % 60 == 0) s.inputFlags = (uint8_t)((s.inputFlags & 0x10) | dirFlag[nextRandom(s.rng) % 4]);
+      else if (t % 60 == 30) s.inputFlags &= 0x10;
+      if (t % SIM_BOMB_INTERVAL_MS == SIM_BOMB_INTERVAL_MS / 2) s.inputFlags |= 0x10;
+      else if (t % SIM_BOMB_INTERVAL_MS == SIM_BOMB_INTERVAL_MS / 2 + 30) s.inputFlags &= 0x0F;
+      if (t >= s.gameMs) s.inputFlags = 0;
+      lockstep_set_input(s.inputFlags);
+    } else {
+      // the sketch's movement: a step on a button change and every
+      // SIM_MOVE_REPEAT_MS while a direction is held
+      if (t % 150 == 0 && nextRandom(s.rng) % 3 == 0) {
+        uint32_t r = nextRandom(s.rng) % 5;
+        s.inputFlags = (r < 4) ? dirFlag[r] : 0;
+      }
+      if (t >= s.gameMs) s.inputFlags = 0;
+      bool stepped = false;
+      if (s.inputFlags != s.lastFlags || ((s.inputFlags & 0x0F) && now - s.lastMoveAt >= SIM_MOVE_REPEAT_MS)) {
+        int nx = playerX + input_vx(s.inputFlags), ny = playerY + input_vy(s.inputFlags);
+        if (mapIsWalkable(nx, ny)) { playerX = nx; playerY = ny; }
+        s.lastFlags = s.inputFlags;
+        s.lastMoveAt = now;
+        stepped = true;
+      }
+      if (s.deadReckoning) remote_pos_poll(myPlayerId, playerX, playerY, s.inputFlags, stepped, now);
+      else if (stepped) {
+        remote_player().stats.posSent++;
+        send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
+      }
+    }
+    if (!s.lockstep && t % SIM_BOMB_INTERVAL_MS == SIM_BOMB_INTERVAL_MS / 2) {
+      int i = placeBombAtPlayer();
+      if (i >= 0) send_bomb_place(myPlayerId, bombs[i].netId, bombs[i].x, bombs[i].y, 0, bombs[i].fuseMs, clock_game_stamp());
+    }
+    if (t >= s.gameMs) enterPhase(s, PHASE_DRAIN);
+  }
+  if (simNet.stateSync && otherPlayerVisible && !lockstep().active) state_sync_poll(now, myPlayerId);
+  snapshot_poll(now, myPlayerId);
+  if (lockstep().active) {
+    lockstep_poll(now);
+  } else {
+    updateBombs();
+    remote_player_update(now);
+  }
+  if (s.phase == PHASE_DRAIN && now - s.phaseAt >= s.drainMs) s.phase = PHASE_DONE;
+  return s.phase != PHASE_DONE;
+}
+
+void simSessionRejoin(SimSession &s, unsigned long seed) {
+  // what a rebooted device has: a map of its own and nothing else
+  unsigned long now = millis();
+  simResetRound(seed);
+  otherPlayerVisible = false;
+  remote_player_reset();
+  state_sync_reset(now);
+  snapshot_round_start(now);
+  send_join(myPlayerId);
+  send_pos(myPlayerId, (uint8_t)playerX, (uint8_t)playerY);
+  s.rejoinedAt = now;
+}
+
+uint32_t simMapHash() {
+  uint32_t h = 2166136261u;
+  for (int r = 0; r < MAP_ROWS; r++)
+    for (int c = 0; c < MAP_COLS; c++) h = (h ^ (uint32_t)mapData[r][c]) * 16777619u;
+  return h;
+}
@@ -0,0 +1,66 @@
+// sim_session.h - scripted two-player session for host programs.
+//
+// One player's side of a round, driven one loop() iteration at a time on
+// the current millis(). The phases follow the sketch:
+//   - waiting: MSG_HEARTBEAT every 100 ms; once the peer's arrives (answered
+//     by game_on_heartbeat() in game_handlers.h) a 3 s countdown starts, and
+//     player 0 sends MAP_SYNC with the round seed
+//   - game: the round starts on pending_map_seed (simResetRound(), JOIN,
+//     POS); a random walk then holds a direction (or stands) for 450 ms on
+//     average, stepping on the press and every SIM_MOVE_REPEAT_MS held, places a bomb
+//     every SIM_BOMB_INTERVAL_MS and sends what the sketch sends for it:
+//     MSG_POS when remote_player.h says it is due, or with `deadReckoning`
+//     cleared a plain MSG_POS after every step as the sketch used to
+//   - drain: no new moves or bombs, so fuses run out and acks settle
+// With `lockstep` set (after simSessionBegin()) the round runs in the
+// fixed-tick mode of lockstep.h: the walk and the bombs become button flags
+// (pressed for 30 ms) and both players are stepped from the exchanged inputs;
+// `rollback` as well steps the peer on guessed inputs and rolls back.
+// In game and drain the state digest of state_sync.h goes out every
+// STATE_SYNC_INTERVAL_MS unless simNet.stateSync is cleared, and a peer
+// whose JOIN arrives late into the round is sent a snapshot.
+// Link the executable with sim_net.cpp for the protocol handlers.
+#pragma once
+
+#include "sim_net.h"
+
+enum SimPhase : uint8_t { PHASE_WAITING = 0, PHASE_COUNTDOWN = 1, PHASE_GAME = 2, PHASE_DRAIN = 3, PHASE_DONE = 4 };
+
+struct SimSession {
+  int player;
+  uint32_t seed;
+  unsigned long gameMs, drainMs;
+  SimPhase phase;
+  unsigned long phaseAt, lastReady;
+  bool timedOut;  // no peer within SIM_HANDSHAKE_TIMEOUT_MS
+  unsigned long rejoinedAt;  // last simSessionRejoin() (0 = never)
+  bool lockstep;             // play the round in lockstep.h's fixed-tick mode
+  bool rollback;             // ... with rollback (no input delay)
+  bool deadReckoning;        // MSG_POS as remote_player.h sends it (default)
+  uint8_t inputFlags;        // buttons of the scripted player
+  uint8_t lastFlags;         // ... at the last step
+  unsigned long lastMoveAt;
+  uint32_t rng;
+};
+
+const unsigned long SIM_HANDSHAKE_TIMEOUT_MS = 5000;
+const unsigned long SIM_COUNTDOWN_MS = 3000;
+const unsigned long SIM_MOVE_REPEAT_MS = 150;  // the sketch's MOVE_REPEAT_MS
+// about two bombs per player in flight, so both fit in the shared MAX_BOMBS slots
+const unsigned long SIM_BOMB_INTERVAL_MS = 900;
+
+// Set myPlayerId and reset the sim and protocol state for a new session.
+void simSessionBegin(SimSession &s, int player, uint32_t seed, unsigned long gameMs, unsigned long drainMs);
+
+// One loop() iteration (receive, reliable poll, script, updateBombs) in a
+// NetBatchScope. Returns false once the session is over; further calls keep
+// receiving, acking and running fuses without new moves.
+bool simSessionStep(SimSession &s);
+
+// Drop the round in the middle of the game and join again on a fresh map
+// from `seed`, as a device that rebooted would; the peer catches us up with
+// a snapshot (state_snapshot.h). Not for lockstep rounds.
+void simSessionRejoin(SimSession &s, unsigned long seed);
+
+// FNV-1a over mapData.
+uint32_t simMapHash();
@@ -0,0 +1,117 @@
+// sim_sketch.cpp - definitions of the globals and hooks normally provided by
+// ESPNOW_LCDA.ino, reduced to what the engine needs on the host.
+#include "sim_sketch.h"
+
+#ifndef SIM_MAX_BOMBS
+#define SIM_MAX_BOMBS 6
+#endif
+
+Tile mapData[MAP_ROWS][MAP_COLS];
+MapLayer mapLayer;
+int playerX = 1, playerY = 1, playerHealth = 1;
+int spawnX = 1, spawnY = 1;
+int otherPlayerX = -1, otherPlayerY = -1; bool otherPlayerVisible = false;
+const int MAX_BOMBS = SIM_MAX_BOMBS;
+static_assert(MAX_BOMBS <= MAX_BOMBS_LIMIT, "bombIndex.freeMask, resolveBlast() and snapshots hold MAX_BOMBS_LIMIT bombs");
+static_assert(MAX_BOMBS < REMOTE_BOMB_ENTRIES, "remoteBombs must hold all of the peer's bombs");
+
+Bomb bombs[MAX_BOMBS];
+DirtyTiles dirtyTiles;
+BombIndex bombIndex;
+RemoteBombTable remoteBombs;
+ExplosionGrid explosions;
+TimerQueue timers;
+TimerEvent timerHeap[MAX_BOMBS + 1];
+
+const unsigned long BOMB_FUSE = 2000;
+const unsigned long EXPLOSION_VIS_MS = 300;
+const int EXPLOSION_RADIUS = 2;
+
+int lives = 3;
+long score = 0;
+long score_local = 0;
+long score_remote = 0;
+
+const unsigned long SPAWN_INVUL_MS = 3000; unsigned long spawnInvulEnd = 0;
+const unsigned long PLAYER_INVUL_MS = 800; unsigned long lastPlayerHitAt = 0;
+int explosionEventCounter = 0; int lastDamageEvent = 0;
+
+const unsigned long MAP_SEED = 0UL;
+const bool AUTO_RANDOMIZE_ON_START = false;
+unsigned long pending_map_seed = 0;
+
+uint8_t myPlayerId = 0;
+
+SimStats simStats = {0, 0, 0, 0, 0};
+bool simNetworked = false;
+
+void addScore(uint8_t owner, int points) {
+  simStats.scoreEvents++;
+  if (owner == myPlayerId) score_local += points;
+  else score_remote += points;
+  score = score_local;
+}
+
+void resetScores() {
+  score_local = 0;
+  score_remote = 0;
+  score = 0;
+}
+
+// Same rules as the sketch (spawn invulnerability, one hit per explosion
+// event) but a player that runs out of lives simply gets a fresh set so the
+// simulation can keep running. In lockstep both sides must agree on who is
+// out, so there it stays out as in the sketch and nobody is hit afterwards.
+void damagePlayerAt(int x, int y, uint8_t ownerId, bool forceDamage, int eventId) {
+  (void)forceDamage;
+  simStats.damageCalls++;
+  if (lockstep_round_decided(eventId)) return;
+  lockstep_on_blast_cell(x, y, ownerId, eventId);
+  unsigned long now = gameMillis();
+  if (now < spawnInvulEnd) return;
+  if (eventId != 0 && eventId == lastDamageEvent) return;
+  if (playerX != x || playerY != y) return;
+  if (eventId != 0) lastDamageEvent = eventId;
+  simStats.playerHits++;
+  if (lives > 0) lives--;
+  if (lives == 0 && (simNetworked || lockstep().active) && ownerId != (uint8_t)0xFF) {
+    // the sketch's death scoring, from this side's view of both scores
+    long s0 = (myPlayerId == 0) ? score_local : score_remote;
+    long s1 = (myPlayerId == 0) ? score_remote : score_local;
+    if (ownerId == 0) s0 += 20; else s1 += 20;
+    if (myPlayerId == 0) s0 -= 20; else s1 -= 20;
+    score_local = (myPlayerId == 0) ? s0 : s1;
+    score_remote = (myPlayerId == 0) ? s1 : s0;
+    score = score_local;
+    if (!lockstep().active) send_player_death(myPlayerId, ownerId, (int32_t)s0, (int32_t)s1, myPlayerId);
+  }
+  if (lives == 0 && lockstep().active) {
+    lockstep_player_out(myPlayerId, eventId);
+    return;
+  }
+  if (lives == 0) lives = 3;
+  playerHealth = 1;
+  playerX = spawnX; playerY = spawnY;
+  spawnInvulEnd = now + SPAWN_INVUL_MS;
+}
+
+void on_local_blast_resolved(const BlastResult &r) {
+  simStats.blastChains++;
+  simStats.chainedBombs += (unsigned long)(r.sourceCount - 1);
+  const BlastSource &root = r.sources[0];
+  // as in the sketch, only chains rooted at our own bomb are announced,
+  // and none in lockstep
+  if (simNetworked && !lockstep().active && bombs[root.slot].owner == myPlayerId) {
+    send_bomb_explode(myPlayerId, bombs[root.slot].netId, root.x, root.y, clock_game_stamp());
+  }
+}
+
+void simResetRound(unsigned long seed) {
+  pending_map_seed = seed ? seed : 1;
+  initializeGame();
+  if (myPlayerId == 0) { spawnX = 1; spawnY = 1; }
+  else { spawnX = MAP_COLS - 2; spawnY = MAP_ROWS - 2; }
+  playerX = spawnX; playerY = spawnY;
+  spawnInvulEnd = 0;
+  lastDamageEvent = 0;
+}
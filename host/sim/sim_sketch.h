@@ -0,0 +1,60 @@
+// sim_sketch.h - host stand-in for the sketch side of game_engine.h.
+//
+// The engine expects the sketch to define map dimensions, the Tile enum and
+// the storage/parameter globals before it is included. This header mirrors
+// the layout of ESPNOW_LCDA.ino so the unmodified engine headers compile on
+// Linux; sim_sketch.cpp provides the definitions and the sketch hooks.
+#pragma once
+
+#include <Arduino.h>
+#include "espnow_net.h"
+#include "espnow_game.h"
+
+// Map dimensions can be overridden per build target to test larger arenas.
+#ifndef SIM_MAP_COLS
+#define SIM_MAP_COLS 16
+#endif
+#ifndef SIM_MAP_ROWS
+#define SIM_MAP_ROWS 16
+#endif
+
+const uint8_t TILE_SIZE = 8;
+const uint8_t MAP_COLS = SIM_MAP_COLS;
+const uint8_t HUD_HEIGHT = 0;
+const uint8_t MAP_ROWS = SIM_MAP_ROWS;
+
+enum Tile : uint8_t { TILE_EMPTY = 0, TILE_SOLID = 1, TILE_BREAKABLE = 2 };
+
+#include "game_engine.h"
+#include "state_sync.h"
+#include "state_snapshot.h"
+#include "lockstep.h"
+#include "remote_player.h"
+#include "clock_sync.h"
+#include "telemetry_dump.h"
+
+// Per-player scores (the sketch keeps these next to the legacy `score`).
+extern long score_local;
+extern long score_remote;
+
+// Counters collected by the host implementations of the sketch hooks.
+struct SimStats {
+  unsigned long damageCalls;
+  unsigned long playerHits;
+  unsigned long scoreEvents;
+  unsigned long blastChains;   // on_local_blast_resolved() calls
+  unsigned long chainedBombs;  // bombs detonated by another blast
+};
+extern SimStats simStats;
+
+// When set, the hooks also do what the sketch does for the peer: one
+// MSG_BOMB_EXPLODE per chain started by a fuse here, and on the last life
+// the death scoring (killer +20, victim -20) sent as MSG_PLAYER_DEATH
+// (the lives are then refilled instead of ending the game, except in
+// lockstep, where the player stays out as in the sketch). Programs that
+// script their own traffic (bench_net) leave it off.
+extern bool simNetworked;
+
+// Reset the sketch-side globals that the real sketch resets in enterGame();
+// the spawn corner follows myPlayerId like in the sketch.
+void simResetRound(unsigned long seed);
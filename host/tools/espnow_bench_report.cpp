@@ -0,0 +1,119 @@
+// espnow_bench_report.cpp - tables from the CSV rows of ESPNOW_A.ino's bench.
+//
+// Reads the files named (or stdin), e.g. a capture of the board's Serial
+// port, and keeps the lines that start with "BENCH," (the first of them,
+// with "run" in the second column, names the columns; other text is
+// skipped). Prints every step, then per payload size the step with the
+// most goodput whose loss stayed within the limit (default 1%), which is
+// what a snapshot fragment or a batch of that size can count on.
+//
+// usage: espnow_bench_report [loss=PCT] [file ...]
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace {
+
+typedef std::map<std::string, double> Row;
+
+std::vector<std::string> split(const std::string &line) {
+  std::vector<std::string> out;
+  size_t i = 0;
+  while (true) {
+    size_t j = line.find(',', i);
+    out.push_back(line.substr(i, j == std::string::npos ? std::string::npos : j - i));
+    if (j == std::string::npos) break;
+    i = j + 1;
+  }
+  return out;
+}
+
+void readRows(FILE *f, std::vector<std::string> &columns, std::vector<Row> &rows, unsigned long *skipped) {
+  char buf[1024];
+  while (fgets(buf, sizeof(buf), f)) {
+    std::string line(buf);
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    if (line.compare(0, 6, "BENCH,") != 0) { (*skipped)++; continue; }
+    std::vector<std::string> v = split(line.substr(6));
+    if (!v.empty() && v[0] == "run") { columns = v; continue; }
+    if (columns.empty() || v.size() != columns.size()) { (*skipped)++; continue; }
+    Row r;
+    for (size_t i = 0; i < v.size(); i++) r[columns[i]] = atof(v[i].c_str());
+    rows.push_back(r);
+  }
+}
+
+double get(const Row &r, const char *k) {
+  auto it = r.find(k);
+  return it == r.end() ? 0.0 : it->second;
+}
+
+std::string rateStr(const Row &r) {
+  char b[32];
+  if (get(r, "rate") == 0) snprintf(b, sizeof(b), "max");
+  else snprintf(b, sizeof(b), "%.0f/s x%.0f", get(r, "rate"), get(r, "burst"));
+  return b;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  double lossLimit = 1.0;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (!strncmp(argv[i], "loss=", 5)) lossLimit = atof(argv[i] + 5);
+    else files.push_back(argv[i]);
+  }
+  std::vector<std::string> columns;
+  std::vector<Row> rows;
+  unsigned long skipped = 0;
+  if (files.empty()) readRows(stdin, columns, rows, &skipped);
+  for (const char *name : files) {
+    FILE *f = fopen(name, "r");
+    if (!f) { perror(name); return 1; }
+    readRows(f, columns, rows, &skipped);
+    fclose(f);
+  }
+  if (rows.empty()) {
+    fprintf(stderr, "no BENCH rows (%lu other lines)\n", skipped);
+    return 1;
+  }
+
+  printf("%6s %-12s %6s %9s %9s %6s %6s | %23s | %23s\n", "size", "rate", "sent", "pps", "kbit/s", "loss%", "mac%",
+         "callback us p50/p99/p999", "echo rtt us p50/p99/p999");
+  for (const Row &r : rows) {
+    char cb[48], rtt[48];
+    snprintf(cb, sizeof(cb), "%.0f/%.0f/%.0f", get(r, "cb_p50_us"), get(r, "cb_p99_us"), get(r, "cb_p999_us"));
+    snprintf(rtt, sizeof(rtt), "%.0f/%.0f/%.0f", get(r, "rtt_p50_us"), get(r, "rtt_p99_us"), get(r, "rtt_p999_us"));
+    printf("%6.0f %-12s %6.0f %9.1f %9.1f %6.2f %6.2f | %23s | %23s%s\n", get(r, "size"), rateStr(r).c_str(),
+           get(r, "sent"), get(r, "achieved_pps"), get(r, "goodput_kbps"), get(r, "loss_pct"), get(r, "mac_loss_pct"),
+           cb, rtt, get(r, "refused") > 0 ? "  (refused some)" : "");
+  }
+
+  // per size: the most goodput within the loss limit
+  std::map<int, const Row *> best;
+  for (const Row &r : rows) {
+    if (get(r, "loss_pct") > lossLimit) continue;
+    int size = (int)get(r, "size");
+    if (!best.count(size) || get(r, "goodput_kbps") > get(*best[size], "goodput_kbps")) best[size] = &r;
+  }
+  printf("\nbest per payload size with loss <= %.1f%%:\n", lossLimit);
+  printf("%6s %9s %-12s %6s %12s %13s\n", "size", "kbit/s", "at", "loss%", "rtt p99 us", "rtt p999 us");
+  const Row *top = nullptr;
+  for (auto &kv : best) {
+    const Row &r = *kv.second;
+    printf("%6d %9.1f %-12s %6.2f %12.0f %13.0f\n", kv.first, get(r, "goodput_kbps"), rateStr(r).c_str(),
+           get(r, "loss_pct"), get(r, "rtt_p99_us"), get(r, "rtt_p999_us"));
+    if (!top || get(r, "goodput_kbps") > get(*top, "goodput_kbps")) top = &r;
+  }
+  if (top)
+    printf("most goodput: %.0f-byte payloads, %.1f kbit/s (%s)\n", get(*top, "size"), get(*top, "goodput_kbps"),
+           rateStr(*top).c_str());
+  else
+    printf("no step within the loss limit\n");
+  printf("%zu steps, %lu other lines\n", rows.size(), skipped);
+  return 0;
+}
@@ -0,0 +1,146 @@
+// telemetry_decode.cpp - prints the telemetry records in a Serial capture.
+//
+// Reads the files named (or stdin), skips everything that is not a record
+// of telemetry_dump.h (the sketch's text output, a record cut short) and
+// prints each record as tables. With -d, a record after the first of the
+// same player is printed as the difference to the one before, which gives
+// what happened in between.
+//
+// Capture from a board, e.g.:
+//   stty -F /dev/ttyUSB0 115200 raw; cat /dev/ttyUSB0 > capture.bin &
+//   printf T > /dev/ttyUSB0
+//
+// usage: telemetry_decode [-d] [file ...]
+#include "sim_sketch.h"
+
+#include <string>
+#include <vector>
+
+namespace {
+
+struct Decoded {
+  TelemetryRecord r;
+  long offset;
+};
+
+void readStream(FILE *f, std::vector<uint8_t> &out) {
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) out.insert(out.end(), buf, buf + n);
+}
+
+// Every record in the bytes, in order.
+std::vector<Decoded> scan(const std::vector<uint8_t> &b, unsigned long *skipped) {
+  std::vector<Decoded> out;
+  size_t i = 0;
+  while (i < b.size()) {
+    Decoded d;
+    int n = telemetry_record_decode(b.data() + i, b.size() - i, &d.r);
+    if (n <= 0) { i++; (*skipped)++; continue; }
+    d.offset = (long)i;
+    out.push_back(d);
+    i += (size_t)n;
+  }
+  return out;
+}
+
+double pct(uint32_t part, uint32_t whole) { return whole ? 100.0 * part / whole : 0.0; }
+
+// a - b, field by field (the uptime and player are kept from a)
+TelemetryRecord diff(const TelemetryRecord &a, const TelemetryRecord &b) {
+  TelemetryRecord d = a;
+  uint32_t *dv = (uint32_t *)&d;
+  const uint32_t *bv = (const uint32_t *)&b;
+  for (int i = 2; i < TELEM_FIELDS; i++) dv[i] -= bv[i];
+  // gauges, not counters
+  d.rxHighWater = a.rxHighWater;
+  d.relSrttUs = a.relSrttUs; d.relRtoMs = a.relRtoMs;
+  d.pingSrttUs = a.pingSrttUs; d.pingMinUs = a.pingMinUs;
+  return d;
+}
+
+void printHist(const char *name, const uint32_t h[TELEM_RTT_BUCKETS]) {
+  uint32_t total = 0;
+  for (int i = 0; i < TELEM_RTT_BUCKETS; i++) total += h[i];
+  printf("  %-6s", name);
+  for (int i = 0; i < TELEM_RTT_BUCKETS; i++) printf(" %6u", h[i]);
+  printf(" | %u\n", total);
+}
+
+void print(const TelemetryRecord &r, int index, long offset, const TelemetryRecord *since) {
+  printf("record %d at byte %ld: player %u, up %.3f s", index, offset, r.playerId, r.uptimeMs / 1000.0);
+  if (since) printf(", difference to %.3f s (%.3f s)", since->uptimeMs / 1000.0, (r.uptimeMs - since->uptimeMs) / 1000.0);
+  printf("\n");
+
+  printf("  frames   %10s %10s %8s %10s %8s\n", "count", "bytes", "refused", "radio ack", "no ack");
+  printf("  sent     %10u %10u %8u %10u %8u (%.1f%% not acked)\n", r.txFrames, r.txBytes, r.txFail, r.txOk,
+         r.txNoAck, pct(r.txNoAck, r.txOk + r.txNoAck));
+  printf("  received %10u %10u\n", r.rxFrames, r.rxBytes);
+  printf("  rx queue: %u queued, %u dropped full, %u oversize, deepest %u of %u\n", r.rxQueued, r.rxQueueDrops,
+         r.rxOversize, r.rxHighWater, (unsigned)RX_QUEUE_SLOTS);
+
+  printf("  %-16s %10s %10s\n", "message", "sent", "received");
+  for (int i = 0; i < TELEM_TYPES; i++) {
+    if (!r.txMsgs[i] && !r.rxMsgs[i]) continue;
+    printf("  %-16s %10u %10u\n", telemetry_type_name(i), r.txMsgs[i], r.rxMsgs[i]);
+  }
+  uint32_t lost = r.seqGaps > r.seqLate ? r.seqGaps - r.seqLate : 0;
+  printf("  peer seqs: %u skipped, %u late, %u repeated, %u restarts; about %u unreliable messages lost\n", r.seqGaps,
+         r.seqLate, r.seqDups, r.seqRestarts, lost);
+
+  printf("  reliable: %u sent, %u resent (%.1f%%), %u acked, %u gave up, %u sent once | %u received, %u duplicates, "
+         "%u out of order, %u peer restarts | %u ack frames\n",
+         r.relSent, r.relRetransmits, pct(r.relRetransmits, r.relSent), r.relAcked, r.relDropped, r.relUnqueued,
+         r.relReceived, r.relDuplicates, r.relOutOfOrder, r.relPeerRestarts, r.relAckFrames);
+  printf("            rtt smoothed %.1f ms, timeout %u ms\n", r.relSrttUs / 1000.0, r.relRtoMs);
+  printf("  pings: %u sent, %u answered, %u lost (%.1f%%), %u late; rtt smoothed %.1f min %.1f ms\n", r.pings, r.pongs,
+         r.pingsLost, pct(r.pingsLost, r.pongs + r.pingsLost), r.pongsLate, r.pingSrttUs / 1000.0, r.pingMinUs / 1000.0);
+  printf("  batcher: %u messages in %u frames (%.2f per frame), %u batches\n", r.batchMessages, r.batchFrames,
+         r.batchFrames ? (double)r.batchMessages / r.batchFrames : 0.0, r.batchBatched);
+  printf("  state digests: %u received, %u differed; desyncs map %u bombs %u scores %u; %u resyncs applied, %u tiles "
+         "repaired\n",
+         r.hashesReceived, r.hashMismatches, r.mapDesyncs, r.bombDesyncs, r.scoreDesyncs, r.resyncsApplied,
+         r.tilesRepaired);
+
+  printf("  rtt ms    <1");
+  for (int i = 1; i < TELEM_RTT_BUCKETS - 1; i++) printf(" %6s", (std::to_string(1 << (i - 1)) + "-").c_str());
+  printf(" %6s | total\n", (std::to_string(1 << (TELEM_RTT_BUCKETS - 2)) + "+").c_str());
+  printHist("acks", r.ackRtt);
+  printHist("pings", r.pingRtt);
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  bool deltas = false;
+  std::vector<const char *> files;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-d")) deltas = true;
+    else files.push_back(argv[i]);
+  }
+  std::vector<uint8_t> bytes;
+  if (files.empty()) readStream(stdin, bytes);
+  int index = 0;
+  bool ok = true;
+  for (size_t f = 0; f < files.size() || (files.empty() && f == 0); f++) {
+    if (!files.empty()) {
+      FILE *in = fopen(files[f], "rb");
+      if (!in) { perror(files[f]); ok = false; continue; }
+      bytes.clear();
+      readStream(in, bytes);
+      fclose(in);
+      printf("== %s\n", files[f]);
+    }
+    unsigned long skipped = 0;
+    std::vector<Decoded> recs = scan(bytes, &skipped);
+    const TelemetryRecord *last[256] = {};
+    for (const Decoded &d : recs) {
+      const TelemetryRecord *prev = deltas ? last[d.r.playerId & 0xFF] : nullptr;
+      if (prev) print(diff(d.r, *prev), ++index, d.offset, prev);
+      else print(d.r, ++index, d.offset, nullptr);
+      last[d.r.playerId & 0xFF] = &d.r;
+    }
+    printf("%zu records, %lu other bytes\n", recs.size(), skipped);
+  }
+  return ok ? 0 : 1;
+}